@@ -0,0 +1,145 @@
+#!/usr/bin/env python3
+"""Record, convert and replay captures of the STM32 <-> ESP32 link.
+
+Build the STM32 firmware with -D BRIDGE_CAPTURE and USART2 carries records
+of both USART1 directions instead of the plain bridge (see hal/bridge.h):
+
+    0xA5, type, timestamp_us (u32 LE), length (u16 LE), bytes[length]
+
+    type 0: rx   ESP -> STM32
+    type 1: tx   STM32 -> ESP
+    type 2: lost u32 count of bytes the STM32 could not capture
+
+Usage:
+    bridge_capture.py record /dev/ttyACM0 921600 capture.bin
+    bridge_capture.py convert capture.bin capture.trace
+    bridge_capture.py replay capture.trace /dev/ttyUSB0 115200 [--direction rx]
+
+The trace is text, one record per line, with the time relative to the first
+record:
+
+    <seconds> <rx|tx|lost> <hex bytes or lost count>
+
+replay sends the records of one direction with their original spacing, e.g.
+the ESP side (rx) to the STM32 USART1 RX pin through a USB serial adapter.
+"""
+
+import argparse
+import struct
+import sys
+import time
+
+SYNC = 0xA5
+HEADER = struct.Struct("<BBIH")
+TYPES = {0: "rx", 1: "tx", 2: "lost"}
+MAX_LENGTH = 4096   # Longer than any capture ring; anything above is noise
+
+
+def open_serial(port, baud):
+    try:
+        import serial
+    except ImportError:
+        sys.exit("pyserial is required: pip install pyserial")
+    return serial.Serial(port, baud, timeout=0.1)
+
+
+def parse(data):
+    """Yield (timestamp_us, type, payload); bytes between records are skipped."""
+    pos = 0
+    while pos + HEADER.size <= len(data):
+        sync, kind, stamp, length = HEADER.unpack_from(data, pos)
+        if sync != SYNC or kind not in TYPES or length > MAX_LENGTH:
+            pos += 1
+            continue
+        end = pos + HEADER.size + length
+        if end > len(data):
+            break
+        yield stamp, TYPES[kind], data[pos + HEADER.size:end]
+        pos = end
+
+
+def record(args):
+    link = open_serial(args.port, args.baud)
+    total = 0
+    with open(args.output, "wb") as out:
+        try:
+            while True:
+                chunk = link.read(4096)
+                if chunk:
+                    out.write(chunk)
+                    total += len(chunk)
+        except KeyboardInterrupt:
+            pass
+    print("%d bytes captured" % total, file=sys.stderr)
+
+
+def convert(args):
+    with open(args.input, "rb") as f:
+        data = f.read()
+
+    first = None
+    last = 0
+    wraps = 0
+    count = 0
+    with open(args.output, "w") as out:
+        for stamp, kind, payload in parse(data):
+            # The microsecond counter wraps after about 71 minutes
+            if stamp < last and last - stamp > 0x80000000:
+                wraps += 1
+            last = stamp
+            stamp += wraps << 32
+            if first is None:
+                first = stamp
+
+            if kind == "lost":
+                value = str(struct.unpack("<I", payload)[0])
+            else:
+                value = payload.hex()
+            out.write("%.6f %s %s\n" % ((stamp - first) / 1e6, kind, value))
+            count += 1
+    print("%d records" % count, file=sys.stderr)
+
+
+def replay(args):
+    link = open_serial(args.port, args.baud)
+    start = time.monotonic()
+    with open(args.trace) as f:
+        for line in f:
+            fields = line.split()
+            if len(fields) != 3 or fields[1] != args.direction:
+                continue
+            delay = start + float(fields[0]) - time.monotonic()
+            if delay > 0:
+                time.sleep(delay)
+            link.write(bytes.fromhex(fields[2]))
+    link.flush()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    sub = parser.add_subparsers(dest="command", required=True)
+
+    p = sub.add_parser("record", help="save the raw capture stream from the STM32")
+    p.add_argument("port")
+    p.add_argument("baud", type=int)
+    p.add_argument("output")
+    p.set_defaults(func=record)
+
+    p = sub.add_parser("convert", help="turn a raw capture into a trace")
+    p.add_argument("input")
+    p.add_argument("output")
+    p.set_defaults(func=convert)
+
+    p = sub.add_parser("replay", help="send one direction of a trace with its timing")
+    p.add_argument("trace")
+    p.add_argument("port")
+    p.add_argument("baud", type=int)
+    p.add_argument("--direction", choices=("rx", "tx"), default="rx")
+    p.set_defaults(func=replay)
+
+    args = parser.parse_args()
+    args.func(args)
+
+
+if __name__ == "__main__":
+    main()
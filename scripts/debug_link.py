@@ -0,0 +1,156 @@
+#!/usr/bin/env python3
+"""Split the framed STM32 debug link (USART2) into its channels.
+
+Build the STM32 firmware with -D DEBUG_LINK_FRAMED. Every frame is then
+
+    COBS(channel, payload[, CRC-32]) 0x00
+
+with bit 7 of the channel byte set when a CRC-32/MPEG-2 of channel byte and
+payload follows, little endian (see hal/debug_link.h).
+
+Usage:
+    debug_link.py /dev/ttyACM0 921600 [--out-dir capture/]
+    debug_link.py --file link.bin [--out-dir capture/]
+
+Text channels (bridge, log) are printed as they arrive. With --out-dir every
+channel's payloads are also appended to <out-dir>/<channel>.bin; capture.bin
+is the input of "bridge_capture.py convert". trace_decode.py reads the trace
+channel from the same port or file.
+"""
+
+import argparse
+import os
+import sys
+
+CHANNELS = ["bridge", "capture", "metrics", "log", "trace"]
+TEXT_CHANNELS = {"bridge", "log"}
+CRC_FLAG = 0x80
+
+
+def crc32_mpeg2(data):
+    crc = 0xFFFFFFFF
+    for byte in data:
+        crc ^= byte << 24
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x04C11DB7) if crc & 0x80000000 else crc << 1
+            crc &= 0xFFFFFFFF
+    return crc
+
+
+def cobs_decode(frame):
+    out = bytearray()
+    pos = 0
+    while pos < len(frame):
+        code = frame[pos]
+        if code == 0 or pos + code > len(frame):
+            return None
+        out += frame[pos + 1:pos + code]
+        pos += code
+        if code < 0xFF and pos < len(frame):
+            out.append(0)
+    return bytes(out)
+
+
+class Demux:
+    """handlers maps a channel name to a function taking each payload; such a
+    channel is no longer printed."""
+
+    def __init__(self, out_dir, handlers=None):
+        self.pending = bytearray()
+        self.files = {}
+        self.out_dir = out_dir
+        self.handlers = handlers or {}
+        self.counts = {name: 0 for name in CHANNELS}
+        self.errors = 0
+
+    def feed(self, data):
+        self.pending += data
+        while True:
+            end = self.pending.find(0)
+            if end < 0:
+                return
+            frame = bytes(self.pending[:end])
+            del self.pending[:end + 1]
+            if frame:
+                self.frame(frame)
+
+    def frame(self, frame):
+        decoded = cobs_decode(frame)
+        if not decoded:
+            self.errors += 1
+            return
+
+        channel = decoded[0] & ~CRC_FLAG
+        payload = decoded[1:]
+        if decoded[0] & CRC_FLAG:
+            if len(payload) < 4:
+                self.errors += 1
+                return
+            payload, crc = payload[:-4], int.from_bytes(payload[-4:], "little")
+            if crc32_mpeg2(decoded[:-4]) != crc:
+                self.errors += 1
+                return
+        if channel >= len(CHANNELS):
+            self.errors += 1
+            return
+
+        name = CHANNELS[channel]
+        self.counts[name] += 1
+        if name in self.handlers:
+            self.handlers[name](payload)
+        elif name in TEXT_CHANNELS:
+            sys.stdout.write(payload.decode("ascii", "replace"))
+            sys.stdout.flush()
+        if self.out_dir:
+            if name not in self.files:
+                self.files[name] = open(os.path.join(self.out_dir, name + ".bin"), "ab")
+            self.files[name].write(payload)
+
+    def close(self):
+        for f in self.files.values():
+            f.close()
+        summary = " ".join("%s %d" % (name, n) for name, n in self.counts.items())
+        print("\nframes: %s, bad %d" % (summary, self.errors), file=sys.stderr)
+
+
+def add_source_arguments(parser):
+    parser.add_argument("port", nargs="?")
+    parser.add_argument("baud", nargs="?", type=int, default=921600)
+    parser.add_argument("--file", help="read a saved stream instead of a serial port")
+
+
+def run(parser, args, demux):
+    """Feed the serial port or file named by add_source_arguments() to demux"""
+    if not args.port and not args.file:
+        parser.error("give a serial port or --file")
+    try:
+        if args.file:
+            with open(args.file, "rb") as f:
+                demux.feed(f.read())
+        else:
+            try:
+                import serial
+            except ImportError:
+                sys.exit("pyserial is required: pip install pyserial")
+            link = serial.Serial(args.port, args.baud, timeout=0.1)
+            while True:
+                demux.feed(link.read(4096))
+    except KeyboardInterrupt:
+        pass
+    finally:
+        demux.close()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    add_source_arguments(parser)
+    parser.add_argument("--out-dir", help="append each channel to <out-dir>/<channel>.bin")
+    args = parser.parse_args()
+
+    if args.out_dir:
+        os.makedirs(args.out_dir, exist_ok=True)
+    run(parser, args, Demux(args.out_dir))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,39 @@
+"""PlatformIO extra script: run stack_check.py after the link.
+
+Fails the build when the worst-case stack exceeds the budget. Wired into
+the opt-in nucleo_f030r8_stackcheck environment only: it has not been run in
+a PlatformIO build yet, so the SCons variables it relies on ($OBJCOPY,
+$LDSCRIPT_PATH, $BUILD_DIR) may need adjusting. In platformio.ini:
+
+    build_flags = -fstack-usage
+    extra_scripts = post:../scripts/pio_stack_check.py
+    custom_stack_budget = 0x400          ; else _Min_Stack_Size of the ldscript
+    custom_stack_check = --priority USART1_IRQHandler=1 ...
+"""
+
+import os
+import shlex
+import subprocess
+
+Import("env")  # noqa: F821 - provided by SCons
+
+SCRIPT = os.path.join(env.subst("$PROJECT_DIR"), os.pardir, "scripts", "stack_check.py")  # noqa: F821
+
+
+def stack_check(target, source, env):
+    objdump = env.subst("$OBJCOPY").replace("objcopy", "objdump")
+    budget = env.GetProjectOption("custom_stack_budget", "")
+    if budget:
+        limit = ["--budget", budget]
+    else:
+        limit = ["--ldscript", env.subst("$LDSCRIPT_PATH")]
+    command = [env.subst("$PYTHONEXE"), SCRIPT, "--elf", target[0].get_abspath(), "--objdump", objdump,
+               "--su-dir", env.subst("$BUILD_DIR")] + limit
+    extra = env.GetProjectOption("custom_stack_check", "")
+    if isinstance(extra, list):
+        extra = " ".join(extra)
+    command += shlex.split(extra)
+    return subprocess.call(command)
+
+
+env.AddPostAction("$BUILD_DIR/${PROGNAME}.elf", stack_check)  # noqa: F821
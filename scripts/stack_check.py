@@ -0,0 +1,254 @@
+#!/usr/bin/env python3
+"""Worst-case stack depth of the STM32 firmware, checked against a budget.
+
+Combines the per-function frames GCC writes with -fstack-usage (*.su) with
+the call graph read from the disassembly, either an objdump listing or the
+ELF itself:
+
+    stack_check.py --list Debug/fw.list --su-dir Debug --ldscript fw.ld
+    stack_check.py --elf firmware.elf --su-dir .pio/build/nucleo_f030r8 \\
+        --budget 0x400 --priority USART1_IRQHandler=1 --priority DMA1_Channel2_3_IRQHandler=0
+
+Entry points are Reset_Handler (or main) and every *_Handler/*_IRQHandler
+that nothing calls.
+The worst case is the deepest thread path plus, for every preemption
+priority level, the deepest handler at that level and its exception frame:
+a handler only preempts handlers of a lower priority (higher number).
+Handlers without --priority are taken to nest with every other one.
+
+Calls through function pointers (blx rN) are assumed to reach any function
+whose address appears in a literal pool; --indirect narrows that down.
+Functions without .su data (libc, assembly) count as 0 bytes unless given
+with --assume, and are listed.
+
+Exits with 1 when the worst case exceeds the budget, or cannot be bounded
+(recursion, dynamic stack allocation).
+"""
+
+import argparse
+import os
+import re
+import subprocess
+import sys
+
+EXCEPTION_FRAME = 32 + 4        # Eight registers, plus the 8-byte alignment pad
+FIXED_PRIORITIES = {"NMI_Handler": -2, "HardFault_Handler": -1}
+
+FUNCTION = re.compile(r"^([0-9a-f]{8}) <([^>]+)>:$")
+INSTRUCTION = re.compile(r"^\s*([0-9a-f]+):\s+((?:[0-9a-f]{4} ?){1,2}|[0-9a-f]{8})\s+(\S+)\s*(.*)$")
+TARGET = re.compile(r"<([^+>]+)(\+0x[0-9a-f]+)?>")
+HANDLER = re.compile(r".*_(IRQ)?Handler$")
+
+
+def read_su(su_dir):
+    """{function: (bytes, bounded)}; the largest frame wins for same-named statics"""
+    frames = {}
+    for root, _dirs, files in os.walk(su_dir):
+        for name in files:
+            if not name.endswith(".su"):
+                continue
+            with open(os.path.join(root, name)) as f:
+                for line in f:
+                    fields = line.rstrip("\n").split("\t")
+                    if len(fields) < 3:
+                        continue
+                    function = fields[0].rsplit(":", 1)[-1]
+                    size = int(fields[1])
+                    bounded = "dynamic" not in fields[2] or "bounded" in fields[2]
+                    old = frames.get(function)
+                    if old is None or size > old[0]:
+                        frames[function] = (size, bounded and (old is None or old[1]))
+    return frames
+
+
+def read_disassembly(lines):
+    """Functions with their start address, direct callees and indirect call count,
+    plus the addresses found in literal pools"""
+    functions = {}
+    literals = set()
+    current = None
+    for line in lines:
+        line = line.rstrip()
+        match = FUNCTION.match(line)
+        if match:
+            current = match.group(2)
+            functions[current] = {"addr": int(match.group(1), 16), "calls": set(), "indirect": 0}
+            continue
+        match = INSTRUCTION.match(line)
+        if not match or current is None:
+            continue
+        mnemonic, operands = match.group(3), match.group(4)
+        if mnemonic == ".word":
+            value = re.match(r"0x([0-9a-f]+)", operands)
+            if value:
+                literals.add(int(value.group(1), 16))
+            continue
+        if mnemonic in ("blx", "bx") and re.match(r"(r\d+|ip)\b", operands):
+            functions[current]["indirect"] += 1
+            continue
+        if not (mnemonic == "bl" or re.match(r"b(\w\w)?(\.[nw])?$", mnemonic)):
+            continue
+        target = TARGET.search(operands)
+        if not target:
+            continue
+        callee = target.group(1)
+        # bl is always a call, a branch to the start of another function a tail call
+        if mnemonic == "bl" or (callee != current and target.group(2) is None):
+            functions[current]["calls"].add(callee)
+    return functions, literals
+
+
+def disassemble_elf(elf, objdump):
+    try:
+        output = subprocess.run([objdump, "-d", elf], check=True, capture_output=True, text=True).stdout
+    except (OSError, subprocess.CalledProcessError) as error:
+        sys.exit("%s -d %s failed: %s" % (objdump, elf, error))
+    return output.splitlines()
+
+
+def budget_from_ldscript(path):
+    with open(path) as f:
+        match = re.search(r"_Min_Stack_Size\s*=\s*(0x[0-9a-fA-F]+|\d+)", f.read())
+    if not match:
+        sys.exit("no _Min_Stack_Size in %s" % path)
+    return int(match.group(1), 0)
+
+
+def assignments(values, what):
+    result = {}
+    for value in values or []:
+        name, sep, rest = value.partition("=")
+        if not sep:
+            sys.exit("--%s wants NAME=VALUE, got %s" % (what, value))
+        result[name] = rest
+    return result
+
+
+class Analysis:
+    def __init__(self, functions, literals, frames, indirect, assume):
+        self.functions = functions
+        self.frames = frames
+        self.assume = assume
+        self.indirect = indirect
+        self.missing = set()
+        self.unbounded = []
+        self.memo = {}
+        # Function pointers: Thumb addresses (bit 0 set) of known functions
+        self.address_taken = sorted(name for name, info in functions.items()
+                                    if (info["addr"] | 1) in literals and not HANDLER.match(name))
+
+    def frame(self, name):
+        if name in self.assume:
+            return self.assume[name]
+        if name not in self.frames:
+            self.missing.add(name)
+            return 0
+        size, bounded = self.frames[name]
+        if not bounded:
+            self.unbounded.append("%s allocates a dynamic stack frame" % name)
+        return size
+
+    def callees(self, name):
+        info = self.functions.get(name, {"calls": set(), "indirect": 0})
+        calls = set(info["calls"])
+        if info["indirect"]:
+            calls |= set(self.indirect.get(name, self.address_taken))
+        return sorted(calls)
+
+    def worst(self, name, path=()):
+        """(bytes, call path) of the deepest chain from name"""
+        if name in self.memo:
+            return self.memo[name]
+        if name in path:
+            self.unbounded.append("recursion: %s" % " > ".join(path[path.index(name):] + (name,)))
+            return 0, [name]
+
+        best = (0, [])
+        for callee in self.callees(name):
+            depth, chain = self.worst(callee, path + (name,))
+            if depth > best[0] or not best[1]:
+                best = (depth, chain)
+        result = (self.frame(name) + best[0], [name] + best[1])
+        self.memo[name] = result
+        return result
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    source = parser.add_mutually_exclusive_group(required=True)
+    source.add_argument("--list", help="objdump -d or -S listing of the firmware")
+    source.add_argument("--elf", help="firmware ELF, disassembled with --objdump")
+    parser.add_argument("--objdump", default="arm-none-eabi-objdump")
+    parser.add_argument("--su-dir", required=True, help="searched recursively for *.su")
+    limit = parser.add_mutually_exclusive_group(required=True)
+    limit.add_argument("--budget", type=lambda v: int(v, 0), help="stack bytes available")
+    limit.add_argument("--ldscript", help="take the budget from _Min_Stack_Size")
+    parser.add_argument("--priority", action="append", metavar="HANDLER=N",
+                        help="NVIC preemption priority of a handler")
+    parser.add_argument("--indirect", action="append", metavar="FUNCTION=T1,T2",
+                        help="what the function pointer calls in FUNCTION can reach")
+    parser.add_argument("--assume", action="append", metavar="FUNCTION=BYTES",
+                        help="stack of a function without .su data")
+    args = parser.parse_args()
+
+    if args.list:
+        with open(args.list) as f:
+            functions, literals = read_disassembly(f)
+    else:
+        functions, literals = read_disassembly(disassemble_elf(args.elf, args.objdump))
+    frames = read_su(args.su_dir)
+    if not frames:
+        sys.exit("no .su files under %s; build with -fstack-usage" % args.su_dir)
+    budget = args.budget if args.budget is not None else budget_from_ldscript(args.ldscript)
+
+    priorities = dict(FIXED_PRIORITIES)
+    priorities.update({k: int(v, 0) for k, v in assignments(args.priority, "priority").items()})
+    indirect = {k: [t for t in v.split(",") if t] for k, v in assignments(args.indirect, "indirect").items()}
+    assume = {k: int(v, 0) for k, v in assignments(args.assume, "assume").items()}
+
+    analysis = Analysis(functions, literals, frames, indirect, assume)
+    thread = "Reset_Handler" if "Reset_Handler" in functions else "main"
+    # Vectors by name; HAL_*_IRQHandler() and Error_Handler() are called, handlers are not
+    called = set().union(*(info["calls"] for info in functions.values()))
+    handlers = sorted(name for name in functions
+                      if HANDLER.match(name) and name not in called and name != "Reset_Handler")
+
+    thread_depth, thread_chain = analysis.worst(thread)
+    print("%-28s %5s  %s" % ("entry", "bytes", "deepest path"))
+    print("%-28s %5d  %s" % (thread, thread_depth, " > ".join(thread_chain)))
+
+    # Deepest handler per priority level; unknown priorities get a level each
+    levels = {}
+    for name in handlers:
+        depth, chain = analysis.worst(name)
+        level = priorities.get(name, ("own", name))
+        label = "%s (%s)" % (name, priorities[name] if name in priorities else "?")
+        print("%-28s %5d  %s" % (label, depth, " > ".join(chain)))
+        if level not in levels or depth > levels[level][0]:
+            levels[level] = (depth, name)
+
+    interrupts = sum(depth + EXCEPTION_FRAME for depth, _name in levels.values())
+    total = thread_depth + interrupts
+    nesting = " + ".join("%s %d" % (name, depth + EXCEPTION_FRAME)
+                         for depth, name in sorted(levels.values(), reverse=True))
+    print()
+    print("worst case: %s %d + %s = %d of %d bytes" % (thread, thread_depth, nesting or "no handlers", total, budget))
+
+    reachable_missing = sorted(analysis.missing)
+    if reachable_missing:
+        print("taken as 0 bytes (no .su, see --assume): %s" % ", ".join(reachable_missing))
+    if analysis.address_taken and any(info["indirect"] for info in functions.values()):
+        print("function pointer targets: %s" % ", ".join(analysis.address_taken))
+
+    failed = False
+    for problem in sorted(set(analysis.unbounded)):
+        print("unbounded: %s" % problem, file=sys.stderr)
+        failed = True
+    if total > budget:
+        print("stack budget exceeded by %d bytes" % (total - budget), file=sys.stderr)
+        failed = True
+    sys.exit(1 if failed else 0)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,55 @@
+"""Host tests of the capture record parser: python3 -m unittest discover scripts"""
+
+import argparse
+import os
+import struct
+import tempfile
+import unittest
+
+import bridge_capture
+
+
+def record(kind, stamp, payload):
+    return bridge_capture.HEADER.pack(bridge_capture.SYNC, kind, stamp, len(payload)) + payload
+
+
+class ParseTest(unittest.TestCase):
+    def test_records_in_order(self):
+        data = record(1, 100, b"AT\r\n") + record(0, 250, b"OK\r\n") + record(2, 300, struct.pack("<I", 7))
+        self.assertEqual(list(bridge_capture.parse(data)),
+                         [(100, "tx", b"AT\r\n"), (250, "rx", b"OK\r\n"), (300, "lost", b"\x07\x00\x00\x00")])
+
+    def test_empty_payload(self):
+        self.assertEqual(list(bridge_capture.parse(record(0, 5, b""))), [(5, "rx", b"")])
+
+    def test_noise_between_records_is_skipped(self):
+        data = b"\x00\xa5\xff" + record(0, 1, b"ready") + b"boot\r\n" + record(1, 2, b"\xa5\xa5")
+        self.assertEqual(list(bridge_capture.parse(data)), [(1, "rx", b"ready"), (2, "tx", b"\xa5\xa5")])
+
+    def test_bad_type_and_length_resync(self):
+        bad_type = bridge_capture.HEADER.pack(bridge_capture.SYNC, 3, 0, 0)
+        too_long = bridge_capture.HEADER.pack(bridge_capture.SYNC, 0, 0, bridge_capture.MAX_LENGTH + 1)
+        data = bad_type + too_long + record(0, 9, b"x")
+        self.assertEqual(list(bridge_capture.parse(data)), [(9, "rx", b"x")])
+
+    def test_truncated_record_ends_the_capture(self):
+        data = record(0, 1, b"whole") + record(0, 2, b"cut short")[:-3]
+        self.assertEqual(list(bridge_capture.parse(data)), [(1, "rx", b"whole")])
+
+
+class ConvertTest(unittest.TestCase):
+    def test_trace_crosses_the_clock_wrap(self):
+        data = record(1, 0xFFFFFF00, b"AT\r\n") + record(0, 0x100, b"OK\r\n") + record(2, 0x200, struct.pack("<I", 3))
+        with tempfile.TemporaryDirectory() as tmp:
+            capture = os.path.join(tmp, "capture.bin")
+            trace = os.path.join(tmp, "capture.trace")
+            with open(capture, "wb") as f:
+                f.write(data)
+            bridge_capture.convert(argparse.Namespace(input=capture, output=trace))
+            with open(trace) as f:
+                lines = f.read().splitlines()
+        self.assertEqual(lines, ["0.000000 tx 41540d0a", "0.000512 rx 4f4b0d0a", "0.000768 lost 3"])
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,72 @@
+"""Host tests of the debug link demultiplexer: python3 -m unittest discover scripts"""
+
+import unittest
+
+import debug_link
+
+
+def cobs_encode(data):
+    """Reference COBS encoder, as hal/debug_link.c writes it"""
+    out = bytearray([0])
+    code_at, code = 0, 1
+    for byte in data:
+        if byte:
+            out.append(byte)
+            code += 1
+        if not byte or code == 0xFF:
+            out[code_at] = code
+            code_at, code = len(out), 1
+            out.append(0)
+    out[code_at] = code
+    return bytes(out) + b"\x00"
+
+
+def frame(channel, payload, crc=False):
+    body = bytes([channel | (debug_link.CRC_FLAG if crc else 0)]) + payload
+    if crc:
+        body += debug_link.crc32_mpeg2(body).to_bytes(4, "little")
+    return cobs_encode(body)
+
+
+class CrcTest(unittest.TestCase):
+    def test_check_value(self):
+        self.assertEqual(debug_link.crc32_mpeg2(b"123456789"), 0x0376E6E7)
+
+
+class CobsTest(unittest.TestCase):
+    def test_round_trip(self):
+        payloads = [b"\x00", b"\x00\x00", b"a\x00b", b"\x00abc\x00", bytes(range(1, 256)),
+                    bytes(range(1, 255)), bytes(range(1, 254)), bytes(600)]
+        for payload in payloads:
+            encoded = cobs_encode(payload)
+            self.assertNotIn(0, encoded[:-1])
+            self.assertEqual(debug_link.cobs_decode(encoded[:-1]), payload)
+
+    def test_overrun_code_is_rejected(self):
+        self.assertIsNone(debug_link.cobs_decode(b"\x05ab"))
+
+
+class DemuxTest(unittest.TestCase):
+    def setUp(self):
+        self.received = []
+        handlers = {"metrics": self.received.append, "capture": self.received.append}
+        self.demux = debug_link.Demux(None, handlers)
+
+    def test_frames_split_across_reads(self):
+        stream = frame(2, b"lat AT n 3\r\n") + frame(1, b"\x00\x01\x00", crc=True)
+        for i in range(0, len(stream), 5):
+            self.demux.feed(stream[i:i + 5])
+        self.assertEqual(self.received, [b"lat AT n 3\r\n", b"\x00\x01\x00"])
+        self.assertEqual(self.demux.counts["metrics"], 1)
+        self.assertEqual(self.demux.errors, 0)
+
+    def test_bad_frames_are_counted_and_skipped(self):
+        corrupt = bytearray(frame(2, b"abc", crc=True))
+        corrupt[2] ^= 0x01
+        self.demux.feed(bytes(corrupt) + frame(7, b"x") + frame(2, b"ok"))
+        self.assertEqual(self.received, [b"ok"])
+        self.assertEqual(self.demux.errors, 2)
+
+
+if __name__ == "__main__":
+    unittest.main()
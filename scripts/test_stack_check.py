@@ -0,0 +1,161 @@
+"""Host tests of the stack checker on a synthetic listing: python3 -m unittest discover scripts"""
+
+import os
+import subprocess
+import sys
+import tempfile
+import unittest
+
+import stack_check
+
+SCRIPT = os.path.join(os.path.dirname(os.path.abspath(__file__)), "stack_check.py")
+
+LISTING = """
+08000100 <Reset_Handler>:
+ 8000100:\tf000 f87e \tbl\t8000200 <main>
+
+08000200 <main>:
+ 8000200:\tf000 f87e \tbl\t8000300 <work>
+ 8000204:\t4798      \tblx\tr3
+ 8000206:\te7fe      \tb.n\t8000206 <main+0x6>
+ 8000208:\t08000401 \t.word\t0x08000401
+
+08000300 <work>:
+ 8000300:\tf000 b8fe \tb.w\t8000500 <leaf>
+
+08000400 <callback>:
+ 8000400:\t4770      \tbx\tlr
+
+08000500 <leaf>:
+ 8000500:\t4770      \tbx\tlr
+
+08000600 <USART1_IRQHandler>:
+ 8000600:\tf000 f87e \tbl\t8000700 <HAL_UART_IRQHandler>
+
+08000700 <HAL_UART_IRQHandler>:
+ 8000700:\tf7ff fefe \tbl\t8000500 <leaf>
+
+08000800 <DMA1_Channel2_3_IRQHandler>:
+ 8000800:\tf7ff fe7e \tbl\t8000500 <leaf>
+ 8000804:\te5fd      \tb.n\t8000402 <callback+0x2>
+
+08000900 <SysTick_Handler>:
+ 8000900:\t4770      \tbx\tlr
+"""
+
+SU = {
+    "Reset_Handler": 8, "main": 16, "work": 24, "callback": 48, "leaf": 40,
+    "USART1_IRQHandler": 8, "HAL_UART_IRQHandler": 32, "DMA1_Channel2_3_IRQHandler": 16,
+    "SysTick_Handler": 4,
+}
+
+
+def frames(**override):
+    sizes = dict(SU, **override)
+    return {name: (size, True) for name, size in sizes.items()}
+
+
+class DisassemblyTest(unittest.TestCase):
+    def setUp(self):
+        self.functions, self.literals = stack_check.read_disassembly(LISTING.splitlines())
+
+    def test_calls_and_tail_calls(self):
+        self.assertEqual(self.functions["main"]["calls"], {"work"})
+        self.assertEqual(self.functions["work"]["calls"], {"leaf"})
+        self.assertEqual(self.functions["callback"]["calls"], set())
+
+    def test_branch_inside_a_function_is_not_a_call(self):
+        self.assertNotIn("main", self.functions["main"]["calls"])
+        self.assertEqual(self.functions["DMA1_Channel2_3_IRQHandler"]["calls"], {"leaf"})
+
+    def test_function_pointers_reach_address_taken_functions(self):
+        self.assertEqual(self.functions["main"]["indirect"], 1)
+        self.assertIn(0x08000401, self.literals)
+        analysis = stack_check.Analysis(self.functions, self.literals, frames(), {}, {})
+        self.assertEqual(analysis.address_taken, ["callback"])
+        self.assertEqual(analysis.callees("main"), ["callback", "work"])
+
+    def test_deepest_path(self):
+        analysis = stack_check.Analysis(self.functions, self.literals, frames(), {}, {})
+        self.assertEqual(analysis.worst("Reset_Handler"), (8 + 16 + 24 + 40, ["Reset_Handler", "main", "work", "leaf"]))
+
+        analysis = stack_check.Analysis(self.functions, self.literals, frames(callback=80), {}, {})
+        self.assertEqual(analysis.worst("Reset_Handler"), (8 + 16 + 80, ["Reset_Handler", "main", "callback"]))
+        self.assertEqual(analysis.unbounded, [])
+
+    def test_indirect_narrows_the_targets(self):
+        analysis = stack_check.Analysis(self.functions, self.literals, frames(callback=80), {"main": []}, {})
+        self.assertEqual(analysis.worst("main")[1], ["main", "work", "leaf"])
+
+    def test_missing_frames_count_as_zero_unless_assumed(self):
+        sizes = frames()
+        del sizes["leaf"]
+        analysis = stack_check.Analysis(self.functions, self.literals, sizes, {}, {})
+        self.assertEqual(analysis.worst("work")[0], 24)
+        self.assertEqual(analysis.missing, {"leaf"})
+
+        analysis = stack_check.Analysis(self.functions, self.literals, sizes, {}, {"leaf": 100})
+        self.assertEqual(analysis.worst("work")[0], 124)
+
+    def test_recursion_is_unbounded(self):
+        listing = LISTING + """
+08000a00 <PendSV_Handler>:
+ 8000a00:\tf000 f87e \tbl\t8000b00 <parse>
+
+08000b00 <parse>:
+ 8000b00:\tf7ff fffe \tbl\t8000b00 <parse>
+"""
+        functions, literals = stack_check.read_disassembly(listing.splitlines())
+        analysis = stack_check.Analysis(functions, literals, frames(PendSV_Handler=8, parse=16), {}, {})
+        analysis.worst("PendSV_Handler")
+        self.assertEqual(analysis.unbounded, ["recursion: parse > parse"])
+
+    def test_dynamic_frames(self):
+        with tempfile.TemporaryDirectory() as tmp:
+            with open(os.path.join(tmp, "main.su"), "w") as f:
+                f.write("main.c:10:5:main\t16\tstatic\n")
+                f.write("main.c:20:13:pad\t24\tdynamic,bounded\n")
+                f.write("main.c:30:13:alloc\t32\tdynamic\n")
+            su = stack_check.read_su(tmp)
+        self.assertEqual(su, {"main": (16, True), "pad": (24, True), "alloc": (32, False)})
+
+        analysis = stack_check.Analysis({}, set(), su, {}, {})
+        analysis.worst("alloc")
+        self.assertEqual(analysis.unbounded, ["alloc allocates a dynamic stack frame"])
+
+
+class CommandLineTest(unittest.TestCase):
+    """Thread 88 bytes; USART1 80 and DMA 56 bytes, plus an exception frame each"""
+
+    def run_check(self, *args):
+        with tempfile.TemporaryDirectory() as tmp:
+            listing = os.path.join(tmp, "fw.list")
+            with open(listing, "w") as f:
+                f.write(LISTING)
+            with open(os.path.join(tmp, "fw.su"), "w") as f:
+                for name, size in SU.items():
+                    f.write("fw.c:1:1:%s\t%d\tstatic\n" % (name, size))
+            result = subprocess.run([sys.executable, SCRIPT, "--list", listing, "--su-dir", tmp] + list(args),
+                                    capture_output=True, text=True)
+        return result.returncode, result.stdout
+
+    def test_handlers_at_one_priority_do_not_nest(self):
+        frame = stack_check.EXCEPTION_FRAME
+        status, out = self.run_check("--budget", "1024", "--priority", "USART1_IRQHandler=1",
+                                     "--priority", "DMA1_Channel2_3_IRQHandler=1", "--priority", "SysTick_Handler=0")
+        self.assertEqual(status, 0)
+        self.assertIn("= %d of 1024 bytes" % (88 + (80 + frame) + (4 + frame)), out)
+
+    def test_handlers_without_priority_nest(self):
+        frame = stack_check.EXCEPTION_FRAME
+        status, out = self.run_check("--budget", "1024")
+        self.assertEqual(status, 0)
+        self.assertIn("= %d of 1024 bytes" % (88 + (80 + frame) + (56 + frame) + (4 + frame)), out)
+
+    def test_over_budget_fails(self):
+        status, _out = self.run_check("--budget", "200")
+        self.assertEqual(status, 1)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,142 @@
+#!/usr/bin/env python3
+"""Turn the STM32 trace channel back into text.
+
+TRACE() records carry a format id, a microsecond time and up to four integer
+arguments (see hal/trace.h). The format strings only exist in the .trace_fmt
+section of the firmware ELF, so the ELF of the running build is needed:
+
+    trace_decode.py .pio/build/nucleo_f030r8/firmware.elf /dev/ttyACM0 921600
+    trace_decode.py firmware.elf --file link.bin
+
+The firmware must be built with -D DEBUG_LINK_FRAMED. Bridge and log text is
+printed as it arrives, each trace record as
+
+    <ms since reset>  <text>
+"""
+
+import argparse
+import re
+import struct
+import sys
+
+from debug_link import Demux, add_source_arguments, run
+
+ID_MASK = 0x00FFFFFF
+ARGS_SHIFT = 24
+FRAME_HEADER = struct.Struct("<II")    # now_us, dropped
+
+CONVERSION = re.compile(r"%([-+ #0]*)(\d*)(?:\.(\d+))?(?:hh|h|ll|l|z|j|t)?([diuxXoc%p])")
+
+
+def read_section(path, wanted):
+    """(address, bytes) of an ELF section, 32 or 64 bit"""
+    with open(path, "rb") as f:
+        elf = f.read()
+    if elf[:4] != b"\x7fELF":
+        sys.exit("%s is not an ELF file" % path)
+    wide = elf[4] == 2
+    order = "<" if elf[5] == 1 else ">"
+
+    if wide:
+        shoff, = struct.unpack_from(order + "Q", elf, 0x28)
+        shentsize, shnum, shstrndx = struct.unpack_from(order + "HHH", elf, 0x3A)
+        entry = struct.Struct(order + "IIQQQQ")
+    else:
+        shoff, = struct.unpack_from(order + "I", elf, 0x20)
+        shentsize, shnum, shstrndx = struct.unpack_from(order + "HHH", elf, 0x2E)
+        entry = struct.Struct(order + "IIIIII")
+
+    sections = [entry.unpack_from(elf, shoff + i * shentsize) for i in range(shnum)]
+    names = sections[shstrndx]
+    for name, _type, _flags, addr, offset, size in sections:
+        start = names[4] + name
+        if elf[start:elf.index(b"\0", start)].decode() == wanted:
+            return addr, elf[offset:offset + size]
+    sys.exit("%s has no %s section; is it built with TRACE()?" % (path, wanted))
+
+
+def format_record(fmt, args):
+    """printf() for integer conversions"""
+    args = list(args)
+
+    def convert(match):
+        flags, width, precision, kind = match.groups()
+        if kind == "%":
+            return "%"
+        value = args.pop(0) if args else 0
+        if kind in "di":
+            value = value - (1 << 32) if value & 0x80000000 else value
+            kind = "d"
+        elif kind == "c":
+            return chr(value & 0xFF)
+        elif kind == "p":
+            return "0x%08x" % value
+        elif kind == "u":
+            kind = "d"
+        spec = "%" + flags + width + ("." + precision if precision else "") + kind
+        return spec % value
+
+    return CONVERSION.sub(convert, fmt)
+
+
+class TraceDecoder:
+    def __init__(self, elf):
+        self.base, self.formats = read_section(elf, ".trace_fmt")
+        self.dropped = 0
+        self.now_us = 0
+        self.epoch = 0          # Microseconds of the 32-bit clock's past wraps
+
+    def format_of(self, ident):
+        offset = ident - self.base
+        if not 0 <= offset < len(self.formats):
+            return None
+        end = self.formats.find(b"\0", offset)
+        return self.formats[offset:end].decode("ascii", "replace")
+
+    def frame(self, payload):
+        if len(payload) < FRAME_HEADER.size or (len(payload) - FRAME_HEADER.size) % 4:
+            print("trace: bad frame of %d bytes" % len(payload), file=sys.stderr)
+            return
+        now_us, dropped = FRAME_HEADER.unpack_from(payload)
+        if now_us < self.now_us:
+            self.epoch += 1 << 32
+        self.now_us = now_us
+
+        words = struct.unpack_from("<%dI" % ((len(payload) - FRAME_HEADER.size) // 4),
+                                   payload, FRAME_HEADER.size)
+        pos = 0
+        while pos + 2 <= len(words):
+            head, time = words[pos], words[pos + 1]
+            argc = head >> ARGS_SHIFT
+            args = words[pos + 2:pos + 2 + argc]
+            pos += 2 + argc
+
+            # Records are older than the frame; later ones belong to the last wrap
+            us = self.epoch + time - ((1 << 32) if time > now_us else 0)
+
+            fmt = self.format_of(head & ID_MASK)
+            if fmt is None:
+                text = "<unknown format 0x%06x> %s" % (head & ID_MASK, " ".join("%d" % a for a in args))
+            else:
+                text = format_record(fmt, args)
+            print("%12.3f  %s" % (us / 1000, text.rstrip("\r\n")))
+
+        # Lost after the records above, which were in the ring first
+        if dropped != self.dropped:
+            print("-- %d records dropped" % ((dropped - self.dropped) & 0xFFFFFFFF))
+            self.dropped = dropped
+        sys.stdout.flush()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("elf", help="firmware ELF of the running build")
+    add_source_arguments(parser)
+    args = parser.parse_args()
+
+    decoder = TraceDecoder(args.elf)
+    run(parser, args, Demux(None, {"trace": decoder.frame}))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,20 @@
+/* sysmem.h */
+
+#ifndef SYSMEM_H
+#define SYSMEM_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Heap bytes handed out by _sbrk(), counted from the _end linker symbol:
+// the current size for peak 0, else the largest size so far
+size_t _sbrk_usage(int peak);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SYSMEM_H
@@ -31,6 +31,8 @@
 
 /* Private define ------------------------------------------------------------*/
 /* USER CODE BEGIN PD */
+#define ESP_READY_TIMEOUT_MS 3000  // Give up waiting for the ESP after this long
+#define ESP_PROBE_PERIOD_MS  100   // Send "AT" this often until the ESP answers
 /* USER CODE END PD */
 
 /* Private macro -------------------------------------------------------------*/
@@ -46,6 +48,10 @@ DMA_HandleTypeDef hdma_usart1_rx;
 uint8_t rxBuffer[RX_BUFFER_SIZE];
 char receivedData[RX_BUFFER_SIZE];  // Variable to store response
 volatile uint16_t receivedLength = 0; // Length of received data
+
+/* Boot timeline in ms since reset, indexed by BootPhase */
+typedef enum { BOOT_CLOCK, BOOT_UART, BOOT_ESP_READY, BOOT_CONFIGURED, BOOT_PHASES } BootPhase;
+uint32_t bootTimeline[BOOT_PHASES];
 /* USER CODE END PV */
 
 /* Private function prototypes -----------------------------------------------*/
@@ -54,7 +60,7 @@ static void MX_GPIO_Init(void);
 static void MX_DMA_Init(void);
 static void MX_USART1_UART_Init(void);
 /* USER CODE BEGIN PFP */
-
+static uint8_t WaitForEspReady(uint32_t timeout_ms);
 /* USER CODE END PFP */
 
 /* Private user code ---------------------------------------------------------*/
@@ -85,7 +91,7 @@ int main(void)
   SystemClock_Config();
 
   /* USER CODE BEGIN SysInit */
-
+  bootTimeline[BOOT_CLOCK] = HAL_GetTick();
   /* USER CODE END SysInit */
 
   /* Initialize all configured peripherals */
@@ -93,16 +99,29 @@ int main(void)
   MX_DMA_Init();
   MX_USART1_UART_Init();
   /* USER CODE BEGIN 2 */
-  HAL_Delay(5000); // Wait for ESP32 to stabilize
   // Enable UART1 IDLE Interrupt
   __HAL_UART_ENABLE_IT(&huart1, UART_IT_IDLE);
 
   // Start DMA reception
   HAL_UART_Receive_DMA(&huart1, rxBuffer, RX_BUFFER_SIZE);
+  bootTimeline[BOOT_UART] = HAL_GetTick();
+
+  // Wait for the ESP32 to announce itself instead of a fixed delay
+  if (WaitForEspReady(ESP_READY_TIMEOUT_MS))
+  {
+    bootTimeline[BOOT_ESP_READY] = HAL_GetTick();
+  }
 
-  // Send AT command
+  // Send AT command; the last probe may still own the UART for a moment
   const char *atCommand = "AT+UART_CUR?\r\n";
-  HAL_UART_Transmit_IT(&huart1, (uint8_t *)atCommand, strlen(atCommand));
+  uint32_t sendStart = HAL_GetTick();
+  while (HAL_UART_Transmit_IT(&huart1, (uint8_t *)atCommand, strlen(atCommand)) != HAL_OK)
+  {
+    if (HAL_GetTick() - sendStart >= ESP_PROBE_PERIOD_MS)
+    {
+      Error_Handler();
+    }
+  }
 
   /* USER CODE END 2 */
 
@@ -115,6 +134,13 @@ int main(void)
     /* USER CODE BEGIN 3 */
 	HAL_GPIO_TogglePin(GPIOA, GPIO_PIN_5); // Heartbeat LED
 
+	// The answer to AT+UART_CUR? completes the startup configuration. A bare
+	// "OK" may still be a late answer to one of the probes.
+	if (bootTimeline[BOOT_CONFIGURED] == 0 && receivedLength > 0 && strstr(receivedData, "+UART_CUR:") != NULL)
+	{
+	  bootTimeline[BOOT_CONFIGURED] = HAL_GetTick();
+	}
+
   }
   /* USER CODE END 3 */
 }
@@ -260,7 +286,39 @@ static void MX_GPIO_Init(void)
 }
 
 /* USER CODE BEGIN 4 */
+/**
+  * @brief  Wait until the ESP32 prints "ready" or answers an "AT" probe.
+  *         Probing also covers an ESP that was already up when the MCU reset.
+  * @param  timeout_ms: how long to wait before giving up
+  * @retval 1 if the ESP32 is ready, 0 on timeout
+  */
+static uint8_t WaitForEspReady(uint32_t timeout_ms)
+{
+  static const char probe[] = "AT\r\n";
+  uint32_t start = HAL_GetTick();
+  uint32_t lastProbe = start - ESP_PROBE_PERIOD_MS;
 
+  while (HAL_GetTick() - start < timeout_ms)
+  {
+    // The IDLE-line interrupt fills receivedData with each burst
+    if (receivedLength > 0)
+    {
+      uint8_t ready = (strstr(receivedData, "ready") != NULL || strstr(receivedData, "OK") != NULL);
+      receivedLength = 0;
+      if (ready)
+      {
+        return 1;
+      }
+    }
+
+    if (HAL_GetTick() - lastProbe >= ESP_PROBE_PERIOD_MS && huart1.gState == HAL_UART_STATE_READY)
+    {
+      lastProbe = HAL_GetTick();
+      HAL_UART_Transmit_IT(&huart1, (uint8_t *)probe, sizeof(probe) - 1);
+    }
+  }
+  return 0;
+}
 /* USER CODE END 4 */
 
 /**
@@ -22,13 +22,20 @@
 
 /* Includes */
 #include <errno.h>
+#include <stddef.h>
 #include <stdint.h>
+#include "sysmem.h"
 
 /**
  * Pointer to the current high watermark of the heap usage
  */
 static uint8_t *__sbrk_heap_end = NULL;
 
+/**
+ * Highest heap end reached, kept when a negative increment lowers the end
+ */
+static uint8_t *__sbrk_heap_peak = NULL;
+
 /**
  * @brief _sbrk() allocates memory to the newlib heap and is used by malloc
  *        and others from the C library
@@ -74,6 +81,23 @@ void *_sbrk(ptrdiff_t incr)
 
   prev_heap_end = __sbrk_heap_end;
   __sbrk_heap_end += incr;
+  if (__sbrk_heap_end > __sbrk_heap_peak)
+  {
+    __sbrk_heap_peak = __sbrk_heap_end;
+  }
 
   return (void *)prev_heap_end;
 }
+
+/**
+ * @brief Heap bytes handed out by _sbrk(), counted from the '_end' linker symbol
+ * @param peak 0 for the current size, else the largest size so far
+ * @return Size in bytes
+ */
+size_t _sbrk_usage(int peak)
+{
+  extern uint8_t _end; /* Symbol defined in the linker script */
+  uint8_t *heap_end = peak ? __sbrk_heap_peak : __sbrk_heap_end;
+
+  return (NULL == heap_end) ? 0 : (size_t)(heap_end - &_end);
+}
@@ -0,0 +1,66 @@
+/* stm32_project/include/at/boot.h */
+
+#ifndef AT_BOOT_H
+#define AT_BOOT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "at/core.h"
+#include "stm32f0xx_hal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Give up on the ESP after this long without "ready" or an answer to AT
+#ifndef BOOT_READY_TIMEOUT_MS
+#define BOOT_READY_TIMEOUT_MS 3000
+#endif
+
+typedef enum {
+    BOOT_PHASE_CLOCK,           // System clock configured
+    BOOT_PHASE_UART,            // UARTs initialized
+    BOOT_PHASE_ESP_READY,       // "ready" received or AT answered
+    BOOT_PHASE_CONFIGURED,      // Startup commands acknowledged
+    BOOT_PHASE_WIFI_UP,         // Station has an address
+    BOOT_PHASE_COUNT,
+} BOOT_Phase;
+
+// Milliseconds since reset at which each phase was reached
+typedef struct {
+    uint32_t ms[BOOT_PHASE_COUNT];
+    uint8_t reached;            // Bit per BOOT_Phase
+    uint8_t probes;             // AT probes sent before the ESP answered
+    bool ready_urc;             // ESP announced itself rather than answering a probe
+} BOOT_Timeline;
+
+typedef struct {
+    GPIO_TypeDef *reset_port;   // ESP EN/RST line (active low), or NULL to leave the ESP alone
+    uint16_t reset_pin;
+} BOOT_Config;
+
+typedef void (*BOOT_ReadyCallback)(AT_Result result, void *ctx);
+
+// Register the "ready" URC; call after AT_Init()
+void BOOT_Init(void);
+
+// Wait for the ESP without a fixed delay: optionally pulse its reset line,
+// then take whichever comes first of the "ready" URC or an OK to a periodic
+// AT probe. The callback gets AT_RESULT_TIMEOUT after BOOT_READY_TIMEOUT_MS.
+bool BOOT_Start(const BOOT_Config *config, BOOT_ReadyCallback callback, void *ctx);
+
+// Drive the reset pulse, probes and timeout; call from the main loop
+void BOOT_Poll(void);
+
+bool BOOT_IsReady(void);
+
+// Record that a phase was reached now (the first time only)
+void BOOT_Mark(BOOT_Phase phase);
+
+const BOOT_Timeline *BOOT_GetTimeline(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AT_BOOT_H
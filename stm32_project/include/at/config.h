@@ -0,0 +1,48 @@
+/* stm32_project/include/at/config.h */
+
+#ifndef AT_CONFIG_H
+#define AT_CONFIG_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "at/core.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// One ESP setting: how to read it back and how to set it. The query answer
+// is the line starting with prefix while the query runs; the setting is in
+// sync when the rest of that line equals expected. With expected NULL the
+// setting is in sync when no such line appears.
+typedef struct {
+    const char *query;          // e.g. "AT+CWMODE?\r\n", or NULL to always send set
+    const char *prefix;         // e.g. "+CWMODE:"
+    const char *expected;       // e.g. "1"
+    const char *set;            // e.g. "AT+CWMODE=1\r\n"
+} CONFIG_Entry;
+
+typedef struct {
+    uint8_t checked;
+    uint8_t applied;            // Set commands sent because the ESP differed
+    uint8_t failed;
+    uint32_t elapsed_ms;
+} CONFIG_Stats;
+
+// Reset the state; call after AT_Init()
+void CONFIG_Init(void);
+
+// Query every entry in order and send only the set commands whose value
+// differs. Entries are handled one at a time, so an AT+SYSSTORE=1 entry
+// first makes the later changes persist on the ESP and the next boot has
+// nothing to send. The table must stay valid until the callback runs; it
+// gets AT_RESULT_ERROR if any set command failed.
+bool CONFIG_Apply(const CONFIG_Entry *table, uint8_t count, AT_CommandCallback callback, void *ctx);
+
+const CONFIG_Stats *CONFIG_GetStats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AT_CONFIG_H
@@ -10,6 +10,28 @@
 extern "C" {
 #endif
 
+#ifndef AT_CLIENT_LINE_SIZE
+#define AT_CLIENT_LINE_SIZE 128
+#endif
+#ifndef AT_CLIENT_TIMEOUT_MS
+#define AT_CLIENT_TIMEOUT_MS 20000  // Long enough for AT+CWJAP
+#endif
+
+// Longest command timeout: it is timed in microseconds on a 32-bit clock
+// (about 71 minutes). Commands asking for more are refused.
+#define AT_MAX_TIMEOUT_MS (UINT32_MAX / 1000u)
+#if AT_CLIENT_TIMEOUT_MS > AT_MAX_TIMEOUT_MS
+#error "AT_CLIENT_TIMEOUT_MS is above AT_MAX_TIMEOUT_MS"
+#endif
+
+// Final result of a queued command
+typedef enum {
+    AT_RESULT_OK,
+    AT_RESULT_ERROR,
+    AT_RESULT_SEND_FAIL,
+    AT_RESULT_TIMEOUT,
+} AT_Result;
+
 // Initialize the AT command core
 void AT_Init(void);
 
@@ -20,6 +42,107 @@ void AT_RegisterCallback(AT_ResponseCallback callback);
 // Process a received byte from UART
 void AT_ProcessReceivedByte(uint8_t received_byte);
 
+// Process a block of received bytes (payload spans are passed through without copying)
+void AT_ProcessReceivedData(const uint8_t *data, uint16_t len);
+
+// Queue a command line (including the trailing "\r\n"). The string must stay
+// valid until the callback runs. The timeout counts from the last received
+// byte, so streaming responses do not expire. Returns false if the queue is full
+// or timeout_ms is above AT_MAX_TIMEOUT_MS.
+typedef void (*AT_CommandCallback)(AT_Result result, void *ctx);
+bool AT_SendCommand(const char *command, uint32_t timeout_ms, AT_CommandCallback callback, void *ctx);
+
+// Supplies the next payload span once the ESP prompts with '>'. Sets *data,
+// returns the span length (at most max, 0 if nothing is ready yet). The span
+// is sent by DMA without copying and must stay valid until the next call.
+// Sources are pulled from AT_Poll(), never from interrupt context.
+typedef uint16_t (*AT_PayloadSource)(const uint8_t **data, uint16_t max, void *ctx);
+
+// Queue a command that is followed by exactly payload_len bytes after the '>'
+// prompt (AT+CIPSEND, AT+HTTPCPOST, ...). Completes on SEND OK/SEND FAIL.
+bool AT_SendCommandWithPayload(const char *command, uint32_t payload_len,
+                               AT_PayloadSource source, void *source_ctx,
+                               uint32_t timeout_ms, AT_CommandCallback callback, void *ctx);
+
+// Finish the command on the wire from a URC handler, for commands whose final
+// result is reported by a URC rather than OK/SEND OK (e.g. +MQTTPUB:OK)
+void AT_CompleteCommand(AT_Result result);
+
+// The command line on the wire, NULL while none is
+const char *AT_GetCurrentCommand(void);
+
+// Turn command echo off with ATE0, and send ATE0 again whenever an echo is
+// seen later (e.g. after the ESP reset). Until then echoed command lines are
+// recognised against the command in flight and skipped without buffering.
+void AT_NegotiateEcho(void);
+
+// True once an echo has been seen and not yet turned off
+bool AT_IsEchoOn(void);
+
+// A remote client (e.g. a PC tool on the bridge) sharing the link with the
+// firmware. Its command lines are queued between firmware commands; it gets
+// the lines answering them, their final result, and the lines no URC handler
+// on board wants while no firmware command is running. Lines answering the
+// firmware and handled URCs stay on board. Commands that prompt for data
+// ('>') are not supported from the client.
+typedef void (*AT_ClientOutput)(const uint8_t *data, uint16_t len, void *ctx);
+void AT_AttachClient(AT_ClientOutput output, void *ctx);
+
+// Bytes typed by the client. Each line is queued as a command; while one is
+// running further lines get "busy p...".
+void AT_ClientInput(const uint8_t *data, uint16_t len);
+
+// Client lines starting with '#' are for the STM32, e.g. "#latency". The
+// client gets OK when the handler returns true, ERROR otherwise.
+typedef bool (*AT_LocalCommand)(const char *line, void *ctx);
+void AT_SetLocalCommandHandler(AT_LocalCommand handler, void *ctx);
+
+// Called as each command goes on the wire (finished false) and once it
+// completes with its result, e.g. to time commands
+typedef void (*AT_CommandObserver)(const char *command, bool finished, AT_Result result, void *ctx);
+void AT_SetCommandObserver(AT_CommandObserver observer, void *ctx);
+
+// Drive transmission retries and timeouts; call from the main loop
+void AT_Poll(void);
+
+// Register a handler for lines starting with prefix ('#' matches any digit).
+// With delimiter '\0' the handler runs at end of line, alongside any other
+// handler matching the line; with ',' or ':' only the first match runs, each
+// time the delimiter is received, until it switches the parser to raw data
+// with AT_BeginRawData().
+typedef void (*AT_UrcHandler)(const char *line, void *ctx);
+bool AT_RegisterUrcHandler(const char *prefix, char delimiter, AT_UrcHandler handler, void *ctx);
+
+// True if a handler is registered for exactly this prefix
+bool AT_HasUrcHandler(const char *prefix);
+
+// Queue a query whose answer lines start with prefix (e.g. "+CWMODE:"). While
+// it is on the wire those lines go to on_line, not to URC handlers or the
+// client; once it has completed the same prefix is a URC again.
+bool AT_SendQuery(const char *command, const char *prefix, uint32_t timeout_ms,
+                  AT_UrcHandler on_line, AT_CommandCallback callback, void *ctx);
+
+// Deliver the next len received bytes to handler instead of the line parser
+typedef void (*AT_RawDataHandler)(const uint8_t *data, uint16_t len, void *ctx);
+void AT_BeginRawData(uint32_t len, AT_RawDataHandler handler, void *ctx);
+
+// Byte accounting for the ESP link
+typedef struct {
+    uint32_t rx_bytes;
+    uint32_t commands;
+    uint32_t command_bytes;     // Command lines sent, payloads excluded
+    uint32_t raw_blocks;        // Payloads announced by a URC header (+IPD, ...)
+    uint32_t unclaimed_lines;   // Lines that were neither a result nor handled
+    uint32_t unclaimed_bytes;
+    uint32_t echo_lines;        // Echoed commands skipped by the parser
+    uint32_t echo_bytes;
+    uint32_t echo_renegotiations;
+    uint32_t client_commands;
+    uint32_t client_bytes;      // Routed to the remote client
+} AT_Stats;
+
+const AT_Stats *AT_GetStats(void);
+
 #ifdef __cplusplus
 }
 #endif
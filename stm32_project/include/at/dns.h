@@ -0,0 +1,59 @@
+/* stm32_project/include/at/dns.h */
+
+#ifndef AT_DNS_H
+#define AT_DNS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "at/core.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef DNS_CACHE_SIZE
+#define DNS_CACHE_SIZE 2
+#endif
+
+// AT+CIPDOMAIN does not report the record TTL, so entries expire after a fixed time
+#ifndef DNS_TTL_MS
+#define DNS_TTL_MS 300000
+#endif
+
+#define DNS_HOST_SIZE    40
+#define DNS_ADDRESS_SIZE 16     // "255.255.255.255"
+
+typedef struct {
+    uint32_t hits;
+    uint32_t misses;            // AT+CIPDOMAIN lookups issued
+    uint32_t failures;
+    uint32_t flushes;           // Cache cleared on WIFI DISCONNECT
+} DNS_Stats;
+
+// Receives the IPv4 literal for the host, or NULL on failure
+typedef void (*DNS_Callback)(const char *address, AT_Result result, void *ctx);
+
+// Register the +CIPDOMAIN and WIFI DISCONNECT URCs; call after AT_Init()
+void DNS_Init(void);
+
+// True if host is already a dotted IPv4 literal
+bool DNS_IsAddress(const char *host);
+
+// Resolve host through the cache, asking the ESP with AT+CIPDOMAIN on a miss.
+// On a hit the callback runs before DNS_Resolve() returns. Callers asking for
+// a host that is already being looked up share the one query.
+// Returns false if the host is too long or no entry or waiter is free.
+bool DNS_Resolve(const char *host, DNS_Callback callback, void *ctx);
+
+// Drop the entry that resolved to address (e.g. after a failed connect)
+void DNS_Invalidate(const char *address);
+
+void DNS_Flush(void);
+
+const DNS_Stats *DNS_GetStats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AT_DNS_H
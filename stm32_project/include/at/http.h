@@ -0,0 +1,66 @@
+/* stm32_project/include/at/http.h */
+
+#ifndef AT_HTTP_H
+#define AT_HTTP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "at/core.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Request methods, numbered as the <opt> argument of AT+HTTPCLIENT
+typedef enum {
+    HTTP_METHOD_HEAD   = 1,
+    HTTP_METHOD_GET    = 2,
+    HTTP_METHOD_POST   = 3,
+    HTTP_METHOD_PUT    = 4,
+    HTTP_METHOD_DELETE = 5,
+} HTTP_Method;
+
+// Transfer callbacks. The body is streamed in the chunks the ESP sends, so a
+// download of any size needs no buffer on our side.
+typedef struct {
+    // Response headers are in. status is 0 on the AT+HTTPCLIENT/AT+HTTPCGET
+    // path, where the ESP only reports success, not the numeric code.
+    // content_length is -1 when the size is not known up front.
+    void (*on_start)(uint16_t status, int32_t content_length, void *ctx);
+    void (*on_body)(const uint8_t *data, uint16_t len, void *ctx);
+    void (*on_complete)(AT_Result result, uint32_t body_length, void *ctx);
+    void *ctx;
+} HTTP_Handlers;
+
+// Register the HTTP URC handlers; call after AT_Init()
+void HTTP_Init(void);
+
+// The url must stay valid until on_complete() runs.
+
+// GET via AT+HTTPCGET. With query_size the Content-Length is fetched first
+// with AT+HTTPGETSIZE and passed to on_start() before any body bytes.
+bool HTTP_Get(const char *url, bool query_size, const HTTP_Handlers *handlers);
+
+// Body-less request via AT+HTTPCLIENT (HEAD, GET, DELETE)
+bool HTTP_Request(HTTP_Method method, const char *url, const HTTP_Handlers *handlers);
+
+// Upload content_length bytes with AT+HTTPCPOST (or AT+HTTPCPUT for PUT).
+// The body is pulled from source span by span after the '>' prompt and goes
+// out through the DMA transmit queue, so it never has to fit in RAM.
+// content_type may be NULL. Any response body is streamed to on_body().
+bool HTTP_Upload(HTTP_Method method, const char *url, const char *content_type,
+                 uint32_t content_length, AT_PayloadSource source, void *source_ctx,
+                 const HTTP_Handlers *handlers);
+
+// Only one transfer can be active on the ESP at a time
+bool HTTP_IsBusy(void);
+
+// Milliseconds from submitting the last transfer to its final result,
+// including the TCP/TLS setup the ESP performs for every request
+uint32_t HTTP_GetLastLatency(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AT_HTTP_H
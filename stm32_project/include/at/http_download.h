@@ -0,0 +1,101 @@
+/* stm32_project/include/at/http_download.h */
+
+#ifndef AT_HTTP_DOWNLOAD_H
+#define AT_HTTP_DOWNLOAD_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "at/http_session.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Links fetching ranges at once (at most TCP_MAX_LINKS). Each one costs an
+// HTTP_Session worth of RAM.
+#ifndef HTTP_DOWNLOAD_MAX_LINKS
+#define HTTP_DOWNLOAD_MAX_LINKS 3
+#endif
+
+// Requests per range before the download is abandoned
+#define HTTP_DOWNLOAD_MAX_ATTEMPTS 3
+
+// In-order sink for the downloaded resource (e.g. flash writes)
+typedef void (*HTTP_DownloadSink)(const uint8_t *data, uint16_t len, void *ctx);
+typedef void (*HTTP_DownloadDone)(AT_Result result, uint32_t length, void *ctx);
+
+typedef struct {
+    TCP_Protocol proto;
+    const char *host;
+    uint16_t port;
+    const char *path;
+    uint32_t length;            // Resource size, or 0 to ask the server with HEAD first
+    uint32_t range_size;        // Bytes per Range request
+    uint8_t first_link;         // Link ids first_link .. first_link + links - 1 are used
+    uint8_t links;
+    uint8_t *reorder_buffer;    // Holds ranges that arrive ahead of the one being
+    uint32_t reorder_size;      // delivered: one range_size slot per extra link
+    HTTP_DownloadSink sink;
+    HTTP_DownloadDone done;
+    void *ctx;
+} HTTP_DownloadConfig;
+
+typedef struct {
+    uint32_t elapsed_ms;        // Start to last byte delivered
+    uint32_t ranges;
+    uint32_t retries;           // Ranges resumed after a failed or dropped request
+    uint32_t buffered_bytes;    // Bytes that went through the reorder buffer
+} HTTP_DownloadStats;
+
+struct HTTP_Download;
+
+typedef struct {
+    HTTP_Session session;
+    struct HTTP_Download *download;
+    char range_header[40];
+    uint32_t range;             // Range index being fetched
+    uint32_t resume_offset;     // Bytes of the range already received before this request
+    uint32_t skip;              // Bytes of a resent response the sink already has
+    uint8_t attempts;
+    bool accepted;              // Server answered with the requested range
+    bool busy;
+} HTTP_DownloadWorker;
+
+typedef struct {
+    uint32_t range;
+    uint32_t received;
+    bool used;
+} HTTP_DownloadSlot;
+
+typedef struct HTTP_Download {
+    HTTP_DownloadConfig config;
+    HTTP_DownloadWorker workers[HTTP_DOWNLOAD_MAX_LINKS];
+    HTTP_DownloadSlot slots[HTTP_DOWNLOAD_MAX_LINKS];
+    uint8_t slot_count;
+    uint32_t range_count;
+    uint32_t next_range;        // Next range to request
+    uint32_t deliver_range;     // Range currently streamed to the sink
+    uint32_t deliver_received;
+    bool probing;               // HEAD request for the length is in flight
+    bool running;
+    AT_Result result;
+    uint32_t start_tick;
+    HTTP_DownloadStats stats;
+} HTTP_Download;
+
+// Split the resource into Range requests over several links and deliver it
+// to the sink strictly in order. Bytes of the range being delivered go to the
+// sink straight from the UART; later ranges wait in the reorder buffer, which
+// also bounds how many ranges are requested ahead.
+bool HTTP_DownloadStart(HTTP_Download *download, const HTTP_DownloadConfig *config);
+
+// Retry stalled connects and writes; call from the main loop
+void HTTP_DownloadPoll(HTTP_Download *download);
+
+bool HTTP_DownloadIsRunning(const HTTP_Download *download);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AT_HTTP_DOWNLOAD_H
@@ -0,0 +1,108 @@
+/* stm32_project/include/at/http_session.h */
+
+#ifndef AT_HTTP_SESSION_H
+#define AT_HTTP_SESSION_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "at/http.h"
+#include "at/tcp.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Requests that can be queued (and pipelined) on one session
+#ifndef HTTP_SESSION_QUEUE_SIZE
+#define HTTP_SESSION_QUEUE_SIZE 3
+#endif
+
+// Room for the request line, Host and Content-Length headers
+#ifndef HTTP_SESSION_HEADER_SIZE
+#define HTTP_SESSION_HEADER_SIZE 128
+#endif
+
+// Response lines are parsed from this much; longer header lines are truncated
+#define HTTP_SESSION_LINE_SIZE 64
+
+typedef struct {
+    HTTP_Method method;
+    const char *path;           // Must stay valid until on_complete()
+    const char *headers;        // Extra "Name: value\r\n" lines, or NULL
+    uint32_t body_length;
+    AT_PayloadSource body_source;
+    void *body_ctx;
+    HTTP_Handlers handlers;
+    uint32_t submit_tick;
+    uint8_t attempts;
+} HTTP_SessionRequest;
+
+typedef struct {
+    uint32_t requests;          // Completed requests
+    uint32_t connects;          // TCP/TLS handshakes performed
+    uint32_t reused;            // Requests written on an already open connection
+    uint32_t pipelined;         // Requests written while another was awaiting its response
+    uint32_t last_latency_ms;   // Submit to final byte of the response
+    uint32_t max_latency_ms;
+    uint32_t total_latency_ms;
+} HTTP_SessionStats;
+
+// HTTP/1.1 client on one ESP link. The connection is kept open and reused;
+// idempotent requests are pipelined once the server has answered with a
+// persistent HTTP/1.1 response. Allocate one per link.
+typedef struct {
+    uint8_t link;
+    TCP_Protocol proto;
+    const char *host;
+    uint16_t port;
+    bool pipelining;
+
+    HTTP_SessionRequest queue[HTTP_SESSION_QUEUE_SIZE];
+    uint8_t head;
+    uint8_t count;
+    uint8_t written;            // Requests from head already on the wire
+    bool writing;
+    bool persistent;            // Server confirmed keep-alive on this connection
+    bool fresh_connection;
+    bool close_requested;
+
+    char header[HTTP_SESSION_HEADER_SIZE];
+    uint16_t header_length;
+    uint16_t header_offset;
+    const HTTP_SessionRequest *writing_request;
+
+    uint8_t parse_state;
+    char line[HTTP_SESSION_LINE_SIZE];
+    uint8_t line_length;
+    uint16_t status;
+    int32_t content_length;
+    uint32_t remaining;
+    uint32_t body_received;
+    bool chunked;
+    bool server_close;
+
+    HTTP_SessionStats stats;
+} HTTP_Session;
+
+// Bind a session to a link and endpoint. host must stay valid for the
+// lifetime of the session. No connection is made until the first request.
+void HTTP_SessionInit(HTTP_Session *session, uint8_t link, TCP_Protocol proto,
+                      const char *host, uint16_t port, bool pipelining);
+
+// Queue a request; the connection is opened (or reopened) on demand.
+// Returns false if the session queue is full.
+bool HTTP_SessionSubmit(HTTP_Session *session, const HTTP_SessionRequest *request);
+
+// Retry connects/writes the AT queue could not take; call from the main loop
+void HTTP_SessionPoll(HTTP_Session *session);
+
+// Close the connection once queued requests have completed
+void HTTP_SessionClose(HTTP_Session *session);
+
+bool HTTP_SessionIsIdle(const HTTP_Session *session);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AT_HTTP_SESSION_H
@@ -0,0 +1,51 @@
+/* stm32_project/include/at/latency.h */
+
+#ifndef AT_LATENCY_H
+#define AT_LATENCY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "at/core.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef LATENCY_CLASSES
+#define LATENCY_CLASSES 6       // The last one collects every other command
+#endif
+#define LATENCY_CLASS_SIZE 16   // "AT+CIPSENDEX" and the like
+#define LATENCY_BUCKETS    32   // Half-octave buckets from 128 us to 4 s and above
+
+typedef struct {
+    char name[LATENCY_CLASS_SIZE];  // Command up to '=' or '?', "other" for the last class
+    uint16_t buckets[LATENCY_BUCKETS];
+    uint32_t count;
+    uint32_t errors;            // ERROR and SEND FAIL, timed like OK
+    uint32_t timeouts;          // Not timed
+    uint32_t max_us;
+} LATENCY_Class;
+
+// Time every command from the moment it is handed to the UART until its
+// final result; call after AT_Init()
+void LATENCY_Init(void);
+
+void LATENCY_Reset(void);
+
+// NULL past the last class in use
+const LATENCY_Class *LATENCY_GetClass(uint8_t index);
+
+// Upper edge of the bucket holding the percentile, at most max_us; 0 without samples
+uint32_t LATENCY_Percentile(const LATENCY_Class *latency, uint8_t percent);
+
+// One line per class, e.g. for joins of 1.2, 1.3 and 1.87 s
+// "lat AT+CWJAP n 3 p50 1572864 p90 1873012 p99 1873012 max 1873012 err 0 tmo 0\r\n"
+// Formats the line at *cursor (0 to start) and moves the cursor on; false
+// once the report is done
+bool LATENCY_ReportLine(uint8_t *cursor, char *line, uint16_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AT_LATENCY_H
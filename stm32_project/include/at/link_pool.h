@@ -0,0 +1,63 @@
+/* stm32_project/include/at/link_pool.h */
+
+#ifndef AT_LINK_POOL_H
+#define AT_LINK_POOL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "at/tcp.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Longest host name a pooled link remembers
+#define POOL_HOST_SIZE 40
+
+typedef struct {
+    uint8_t ssl_auth_mode;      // AT+CIPSSLCCONF auth_mode: 0 none, 1 client cert, 2 server CA, 3 both
+    uint8_t ssl_pki_number;
+    uint8_t ssl_ca_number;
+    uint16_t keep_alive_s;      // TCP keep-alive for pooled links, 0 = off
+} POOL_Config;
+
+typedef struct {
+    uint32_t handshakes;        // AT+CIPSTART performed for SSL links
+    uint32_t handshake_ms;      // Total time spent in those handshakes
+    uint32_t reuses;            // Acquires served by an already open link
+    uint32_t time_saved_ms;     // reuses x average handshake time
+    uint32_t connects;          // AT+CIPSTART issued, any protocol
+    uint32_t reconnects;        // Lazy reconnects of a link the server had closed
+    uint32_t evictions;         // Idle links closed to make room (least recently used first)
+} POOL_Stats;
+
+// Called once the acquired link is connected (link >= 0) or failed (-1).
+// For a warm link this runs before POOL_Acquire() returns.
+typedef void (*POOL_ReadyCallback)(int8_t link, AT_Result result, void *ctx);
+
+// Set up the pool; call after TCP_Init()
+void POOL_Init(const POOL_Config *config);
+
+// Get a connected link to (proto, host, port). In order of preference:
+//  - an idle open link to the same endpoint is handed over as is,
+//  - a link the server closed (<id>,CLOSED) is reconnected to its endpoint,
+//  - a closed link is configured (once, with AT+CIPSSLCCONF for SSL) and connected,
+//  - the least recently used idle link is closed and reused.
+// Data and close events of the link go to handlers until it is released.
+// Returns false if every link is in use.
+bool POOL_Acquire(TCP_Protocol proto, const char *host, uint16_t port,
+                  const TCP_Handlers *handlers, POOL_ReadyCallback ready, void *ctx);
+
+// Give a link back, keeping the connection open for the next request
+void POOL_Release(uint8_t link);
+
+// Give a link back and close it (e.g. after a protocol error)
+void POOL_Discard(uint8_t link);
+
+const POOL_Stats *POOL_GetStats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AT_LINK_POOL_H
@@ -0,0 +1,106 @@
+/* stm32_project/include/at/mqtt.h */
+
+#ifndef AT_MQTT_H
+#define AT_MQTT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "at/core.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Topic filters that can be dispatched at once
+#define MQTT_MAX_SUBSCRIPTIONS 6
+
+// Longest topic kept for a received message
+#define MQTT_TOPIC_SIZE 64
+
+// Bytes reserved for publishes held while the broker is unreachable
+#ifndef MQTT_QUEUE_ARENA_SIZE
+#define MQTT_QUEUE_ARENA_SIZE 1024
+#endif
+
+// Queued publishes handed to the ESP at once; the rest of the AT queue stays
+// free for interactive commands during a replay burst
+#define MQTT_QUEUE_WINDOW 2
+
+typedef struct {
+    const char *host;
+    uint16_t port;
+    const char *client_id;
+    const char *username;       // NULL for none
+    const char *password;       // NULL for none
+    uint8_t scheme;             // AT+MQTTUSERCFG scheme, 1 = MQTT over TCP
+    bool reconnect;             // Let the ESP reconnect on its own
+} MQTT_Config;
+
+// Called with a received message once its payload is in the subscription's
+// buffer. len is what was stored; bytes beyond the buffer are dropped.
+typedef void (*MQTT_MessageHandler)(const char *topic, const uint8_t *payload, uint32_t len, void *ctx);
+
+typedef void (*MQTT_ConnectionCallback)(bool connected, void *ctx);
+
+typedef struct {
+    uint32_t received;          // Messages dispatched to a handler
+    uint32_t unmatched;         // Messages no filter matched
+    uint32_t dropped_bytes;     // Payload bytes that did not fit a handler buffer
+    uint32_t published;
+    uint32_t publish_failed;
+    uint32_t queued;            // Records accepted by MQTT_QueuePublish()
+    uint32_t queue_dropped;     // Unconfirmed records evicted to make room
+    uint32_t replayed;          // Records sent again after a failure or reconnect
+} MQTT_Stats;
+
+// Register the MQTT URC handlers; call after AT_Init()
+void MQTT_Init(void);
+
+// Configure the client (AT+MQTTUSERCFG) and connect (AT+MQTTCONN).
+// The strings in config must stay valid until the connection callback runs.
+bool MQTT_Connect(const MQTT_Config *config);
+
+void MQTT_SetConnectionCallback(MQTT_ConnectionCallback callback, void *ctx);
+bool MQTT_IsConnected(void);
+
+// Add a topic filter ('+' and '#' wildcards allowed) to the dispatch table
+// and subscribe with AT+MQTTSUB. Payloads are written directly into buffer.
+// Filters are re-subscribed after every reconnect.
+bool MQTT_Subscribe(const char *filter, uint8_t qos, MQTT_MessageHandler handler,
+                    uint8_t *buffer, uint16_t buffer_size, void *ctx);
+
+// Publish with AT+MQTTPUB; payload is escaped into the command, so this is
+// meant for short sensor readings. done may be NULL.
+bool MQTT_Publish(const char *topic, const uint8_t *payload, uint16_t len, uint8_t qos,
+                  bool retain, AT_CommandCallback done, void *ctx);
+
+// Publish with AT+MQTTPUBRAW. The len payload bytes are pulled from source
+// after the '>' prompt and sent by DMA without copying or escaping. done runs
+// when +MQTTPUB:OK/+MQTTPUB:FAIL arrives.
+bool MQTT_PublishRaw(const char *topic, uint32_t len, uint8_t qos, bool retain,
+                     AT_PayloadSource source, void *source_ctx, AT_CommandCallback done, void *ctx);
+
+// MQTT_PublishRaw() from a caller buffer, which must stay valid until done runs
+bool MQTT_PublishBuffer(const char *topic, const uint8_t *payload, uint32_t len, uint8_t qos,
+                        bool retain, AT_CommandCallback done, void *ctx);
+
+// Store a publish in the offline queue and send it when connected. Records
+// stay in the arena until the ESP confirms them; QoS1 records that fail or
+// are cut off by a disconnect are replayed in order after +MQTTCONNECTED.
+// When the arena is full the oldest records are evicted to make room; if the
+// oldest is in flight nothing can be, and this returns false.
+bool MQTT_QueuePublish(const char *topic, const uint8_t *payload, uint16_t len, uint8_t qos, bool retain);
+
+// Records waiting in the offline queue, including those in flight
+uint16_t MQTT_QueueDepth(void);
+
+// MQTT topic filter match with '+' and '#' wildcards
+bool MQTT_TopicMatches(const char *filter, const char *topic);
+
+const MQTT_Stats *MQTT_GetStats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AT_MQTT_H
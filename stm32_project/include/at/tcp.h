@@ -0,0 +1,75 @@
+/* stm32_project/include/at/tcp.h */
+
+#ifndef AT_TCP_H
+#define AT_TCP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "at/core.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Link ids 0..4 (CONFIG_AT_SOCKET_MAX_CONN_NUM in the ESP firmware)
+#define TCP_MAX_LINKS 5
+
+// CONFIG_Entry initializer for AT+CIPMUX=1
+#define TCP_CONFIG_MUX { "AT+CIPMUX?\r\n", "+CIPMUX:", "1", "AT+CIPMUX=1\r\n" }
+
+typedef enum {
+    TCP_PROTO_TCP,
+    TCP_PROTO_UDP,
+    TCP_PROTO_SSL,
+} TCP_Protocol;
+
+typedef enum {
+    TCP_LINK_CLOSED,
+    TCP_LINK_CONNECTING,
+    TCP_LINK_CONNECTED,
+    TCP_LINK_CLOSING,
+} TCP_LinkState;
+
+// Per-link event callbacks. Received data is passed straight from the +IPD
+// payload, in as many spans as the UART delivers it.
+typedef struct {
+    void (*on_connect)(uint8_t link, AT_Result result, void *ctx);
+    void (*on_data)(uint8_t link, const uint8_t *data, uint16_t len, void *ctx);
+    void (*on_closed)(uint8_t link, void *ctx);
+    void *ctx;
+} TCP_Handlers;
+
+// Register the socket URCs and set up the DNS cache; call after AT_Init().
+// Links need multiple connections enabled: add TCP_CONFIG_MUX to the boot
+// configuration table (see at/config.h).
+void TCP_Init(void);
+
+// Open a link with AT+CIPSTART. TCP and UDP host names are resolved through
+// the DNS cache first, so the ESP is handed an address. host must stay valid
+// until on_connect() runs.
+bool TCP_Open(uint8_t link, TCP_Protocol proto, const char *host, uint16_t port,
+              const TCP_Handlers *handlers);
+
+// TCP keep-alive probe interval (1-7200 s, 0 = off) used by the ESP for the
+// next TCP_Open() on this link. Probes cost nothing on the UART.
+void TCP_SetKeepAlive(uint8_t link, uint16_t seconds);
+
+// Send len bytes pulled from source, split into AT+CIPSEND blocks as needed.
+// callback runs once every block has been acknowledged (or one failed).
+bool TCP_Send(uint8_t link, uint32_t len, AT_PayloadSource source, void *source_ctx,
+              AT_CommandCallback callback, void *ctx);
+
+// Close a link with AT+CIPCLOSE; deferred until a pending send finishes, or
+// until TCP_Poll() finds room in a full AT queue
+bool TCP_Close(uint8_t link);
+
+// Retry closes the AT queue could not take; call from the main loop
+void TCP_Poll(void);
+
+TCP_LinkState TCP_GetState(uint8_t link);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AT_TCP_H
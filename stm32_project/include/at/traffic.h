@@ -0,0 +1,50 @@
+/* stm32_project/include/at/traffic.h */
+
+#ifndef AT_TRAFFIC_H
+#define AT_TRAFFIC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "at/config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Remote info AT+CIPDINFO=1 adds to each +IPD: ,"<ip>",<port> (typical length)
+#define TRAFFIC_IPD_INFO_BYTES 20
+
+// Entries TRAFFIC_BuildProfile() may add
+#define TRAFFIC_PROFILE_ENTRIES 3
+
+typedef struct {
+    uint32_t echo_bytes_saved;      // Command lines the ESP no longer echoes
+    uint32_t ipd_bytes_saved;       // Payload headers x TRAFFIC_IPD_INFO_BYTES (estimate;
+                                    // +MQTTSUBRECV and +HTTPCLIENT headers count too)
+    uint32_t unclaimed_bytes;       // Received lines no handler wanted, still on the wire
+    uint32_t unclaimed_lines;
+} TRAFFIC_Report;
+
+// Append configuration entries that turn off what no registered URC handler
+// uses: +IPD remote info (AT+CIPDINFO=0), optional system messages
+// (AT+SYSMSG) and unused AT+CWLAP fields (AT+CWLAPOPT). Command echo is
+// turned off by AT_NegotiateEcho().
+// Call once every module has registered its handlers. Returns the number
+// of entries written to table.
+uint8_t TRAFFIC_BuildProfile(CONFIG_Entry *table, uint8_t max);
+
+// Start counting savings; call once the profile has been applied
+void TRAFFIC_Start(void);
+
+const TRAFFIC_Report *TRAFFIC_GetReport(void);
+
+// The report as one line, e.g.
+// "traffic echo_saved 1834 ipd_saved 460 unclaimed 96 bytes 4 lines\r\n"
+// Formats it while *cursor is 0 and moves the cursor on; false once done
+bool TRAFFIC_ReportLine(uint8_t *cursor, char *line, uint16_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AT_TRAFFIC_H
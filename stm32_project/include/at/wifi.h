@@ -0,0 +1,87 @@
+/* stm32_project/include/at/wifi.h */
+
+#ifndef AT_WIFI_H
+#define AT_WIFI_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "at/core.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define WIFI_BSSID_SIZE   18    // "aa:bb:cc:dd:ee:ff"
+#define WIFI_ADDRESS_SIZE 16
+
+typedef enum {
+    WIFI_STATE_DISCONNECTED,
+    WIFI_STATE_CONNECTING,
+    WIFI_STATE_CONNECTED,       // Associated, waiting for an address
+    WIFI_STATE_GOT_IP,
+} WIFI_State;
+
+typedef struct {
+    const char *ssid;
+    const char *password;
+    bool static_ip;             // Reuse the last leased address instead of DHCP
+    uint16_t reconnect_interval_s;  // AT+CWRECONNCFG background reconnects, 0 = off
+    uint16_t reconnect_attempts;    // 0 = keep trying
+} WIFI_Config;
+
+// What the last successful join learned. Can be saved by the application
+// and handed back with WIFI_SetProfile() after a reset.
+typedef struct {
+    bool valid;
+    char bssid[WIFI_BSSID_SIZE];
+    uint8_t channel;
+    char ip[WIFI_ADDRESS_SIZE];
+    char gateway[WIFI_ADDRESS_SIZE];
+    char netmask[WIFI_ADDRESS_SIZE];
+} WIFI_Profile;
+
+// Phases of the last connect, from AT+CWJAP (or a background reconnect
+// starting at WIFI DISCONNECT) to each event
+typedef struct {
+    uint32_t associate_ms;      // Scan, authentication, association: WIFI CONNECTED
+    uint32_t got_ip_ms;         // Address assigned: WIFI GOT IP
+    uint32_t total_ms;          // AT+CWJAP answered OK
+    bool targeted;              // Joined with the cached BSSID
+    bool static_ip;
+} WIFI_Timing;
+
+typedef struct {
+    uint32_t connects;
+    uint32_t targeted_joins;    // Joins that skipped the full scan
+    uint32_t full_scans;        // Fallbacks to a join without BSSID
+    uint32_t failures;
+    uint32_t disconnects;
+    uint8_t last_error;         // +CWJAP:<code> of the last failed join
+} WIFI_Stats;
+
+typedef void (*WIFI_EventCallback)(WIFI_State state, void *ctx);
+
+// Register the Wi-Fi URCs; call after AT_Init()
+void WIFI_Init(void);
+
+// Join the access point. With a valid profile this first tries AT+CWJAP with
+// the cached BSSID (and the cached address via AT+CIPSTA when static_ip is
+// set), falling back to a full scan with DHCP. The profile is refreshed and
+// AT+CWRECONNCFG applied once joined. Returns false if a connect is running.
+bool WIFI_Connect(const WIFI_Config *config, AT_CommandCallback callback, void *ctx);
+
+void WIFI_SetEventCallback(WIFI_EventCallback callback, void *ctx);
+
+WIFI_State WIFI_GetState(void);
+
+const WIFI_Profile *WIFI_GetProfile(void);
+void WIFI_SetProfile(const WIFI_Profile *profile);
+
+const WIFI_Timing *WIFI_GetTiming(void);
+const WIFI_Stats *WIFI_GetStats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AT_WIFI_H
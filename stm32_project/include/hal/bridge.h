@@ -0,0 +1,106 @@
+/* bridge.h */
+
+#ifndef BRIDGE_H
+#define BRIDGE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "hal/uart.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Receive buffer per direction. Holds the bytes the other side has not sent
+// yet: 256 bytes cover about 20 ms of backlog at 115200 baud, 512 bytes
+// about 5 ms at 921600. With the PC as an AT client (neither
+// BRIDGE_TRANSPARENT nor BRIDGE_CAPTURE) the PC side only sends command lines.
+#ifndef BRIDGE_ESP_BUFFER_SIZE
+#if UART1_BAUDRATE > 115200
+#define BRIDGE_ESP_BUFFER_SIZE 512
+#else
+#define BRIDGE_ESP_BUFFER_SIZE 256
+#endif
+#endif
+#ifndef BRIDGE_PC_BUFFER_SIZE
+#if !defined(BRIDGE_TRANSPARENT) && !defined(BRIDGE_CAPTURE)
+#define BRIDGE_PC_BUFFER_SIZE 128
+#elif UART2_BAUDRATE > 115200
+#define BRIDGE_PC_BUFFER_SIZE 512
+#else
+#define BRIDGE_PC_BUFFER_SIZE 256
+#endif
+#endif
+
+typedef enum {
+    BRIDGE_ESP_TO_PC,           // USART1 RX -> USART2 TX
+    BRIDGE_PC_TO_ESP,           // USART2 RX -> USART1 TX
+    BRIDGE_DIRECTIONS,
+} bridge_direction_t;
+
+typedef struct {
+    uint32_t rx_bytes;
+    uint32_t tx_bytes;
+    uint32_t spans;             // DMA transfers to the other side
+    uint32_t stalls;            // Times the transmit queue was full
+    uint32_t overrun_bytes;     // Overwritten before they were forwarded, or
+                                // (estimated) before their span had read them
+    uint32_t tap_lost_bytes;    // Overwritten before the tap saw them
+    uint16_t peak_backlog;      // Most bytes waiting for the other side
+} bridge_stats_t;
+
+typedef enum {
+    BRIDGE_MODE_TRANSPARENT,    // ESP bytes go to the PC as they are
+    BRIDGE_MODE_CAPTURE,        // The PC gets records of both USART1 directions
+    BRIDGE_MODE_ARBITRATED,     // Nothing is forwarded; both sides go through the taps
+} bridge_mode_t;
+
+// Capture record on the debug link capture channel, little endian:
+//   0xA5, type, timestamp_us (4 bytes), length (2 bytes), bytes[length]
+// The timestamp of an RX record is when the span was seen, that of a TX
+// record when its DMA transfer started. A LOST record carries the number
+// of captured bytes (4 bytes) that did not fit into the channel queue.
+#define BRIDGE_RECORD_SYNC   0xA5
+#define BRIDGE_RECORD_HEADER 8
+
+typedef enum {
+    BRIDGE_RECORD_RX,           // ESP -> STM32
+    BRIDGE_RECORD_TX,           // STM32 -> ESP, from the PC or the AT core
+    BRIDGE_RECORD_LOST,
+} bridge_record_t;
+
+typedef struct {
+    uint32_t records;
+    uint32_t bytes;             // Captured bytes, headers excluded
+    uint32_t lost_bytes;
+} bridge_capture_stats_t;
+
+// Receives a copy of the bytes of one direction from bridge_poll()
+typedef void (*bridge_tap_t)(const uint8_t *data, uint16_t len, void *ctx);
+void bridge_set_tap(bridge_direction_t direction, bridge_tap_t tap, void *ctx);
+
+// Forward everything received on each UART to the other one, in DMA spans
+// short enough that a faster sender cannot overwrite one while it goes out.
+// Call after uart_init() for both instances.
+HAL_StatusTypeDef bridge_init(void);
+
+// Switch USART2 between the plain bridge, capture records and arbitrated
+// access. Capturing copies each USART1 span to the debug link; the ESP link
+// itself is not delayed. Bytes from the PC are still forwarded to the ESP
+// unless arbitrated, where a tap hands them to whoever owns the link.
+void bridge_set_mode(bridge_mode_t mode);
+
+// Send bytes to the PC on the debug link bridge channel; false if they do not fit
+bool bridge_write(const uint8_t *data, uint16_t len);
+
+// Deliver received bytes to the taps and retry stalled spans; call from the main loop
+void bridge_poll(void);
+
+const bridge_stats_t *bridge_get_stats(bridge_direction_t direction);
+const bridge_capture_stats_t *bridge_get_capture_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BRIDGE_H
@@ -0,0 +1,111 @@
+/* debug_link.h */
+
+#ifndef DEBUG_LINK_H
+#define DEBUG_LINK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Queue sizes per channel, powers of two; a frame that does not fit is
+// dropped. Channels the build mode (main.c) has no use for get 0 bytes and
+// drop everything. With the other modules the defaults keep the firmware
+// under 6400 bytes of .data and .bss in every mode at the default line
+// rates: the 6.5 KB the linker script leaves beside stack and heap, less
+// the HAL and newlib.
+#ifndef DEBUG_LINK_BRIDGE_SIZE
+#if defined(BRIDGE_TRANSPARENT) && defined(DEBUG_LINK_FRAMED)
+#define DEBUG_LINK_BRIDGE_SIZE  512     // Framed copies of whole ESP spans
+#elif defined(BRIDGE_TRANSPARENT) || defined(BRIDGE_CAPTURE)
+#define DEBUG_LINK_BRIDGE_SIZE  128     // The boot report
+#else
+#define DEBUG_LINK_BRIDGE_SIZE  256     // AT client output, a whole response line
+#endif
+#endif
+#ifndef DEBUG_LINK_CAPTURE_SIZE
+#ifdef BRIDGE_CAPTURE
+#define DEBUG_LINK_CAPTURE_SIZE 512     // A record of a whole ESP span and a few short ones
+#else
+#define DEBUG_LINK_CAPTURE_SIZE 0
+#endif
+#endif
+#ifndef DEBUG_LINK_METRICS_SIZE
+#if defined(BRIDGE_TRANSPARENT) || defined(BRIDGE_CAPTURE)
+#define DEBUG_LINK_METRICS_SIZE 0       // Reports are asked for by the AT client
+#else
+#define DEBUG_LINK_METRICS_SIZE 256     // A report line and the one behind it
+#endif
+#endif
+#ifndef DEBUG_LINK_LOG_SIZE
+#define DEBUG_LINK_LOG_SIZE     0
+#endif
+#ifndef DEBUG_LINK_TRACE_SIZE
+#if defined(TRACE_ENABLED) && TRACE_ENABLED
+#define DEBUG_LINK_TRACE_SIZE   256
+#else
+#define DEBUG_LINK_TRACE_SIZE   0
+#endif
+#endif
+
+// Framed, a frame on USART2 is COBS(channel, payload[, CRC-32]) followed by
+// 0x00. Bit 7 of the channel byte says a CRC follows: CRC-32/MPEG-2 (the
+// CRC unit's defaults) over channel byte and payload, little endian.
+#define DEBUG_LINK_CRC_FLAG 0x80
+
+typedef enum {
+    DEBUG_LINK_RAW,             // Payloads as they are, for a terminal
+    DEBUG_LINK_COBS,
+    DEBUG_LINK_COBS_CRC,
+} debug_link_format_t;
+
+typedef enum {
+    DEBUG_LINK_BRIDGE,          // AT client output and bridged ESP bytes
+    DEBUG_LINK_CAPTURE,         // Bridge capture records
+    DEBUG_LINK_METRICS,
+    DEBUG_LINK_LOG,
+    DEBUG_LINK_TRACE,
+    DEBUG_LINK_CHANNELS,
+} debug_link_channel_t;
+
+typedef struct {
+    uint32_t frames;
+    uint32_t bytes;             // Payload bytes queued
+    uint32_t dropped;           // Frames that did not fit
+    uint16_t peak_used;         // Most queue bytes in use
+} debug_link_stats_t;
+
+// Take over USART2 transmission. Call after uart_init().
+void debug_link_init(debug_link_format_t format);
+
+debug_link_format_t debug_link_get_format(void);
+
+// Whole frames are sent in priority order, 0 first; the default is the
+// order of debug_link_channel_t
+void debug_link_set_priority(debug_link_channel_t channel, uint8_t priority);
+
+// Queue one frame (copied). Safe from interrupt context; interrupts stay on
+// while the frame is encoded, and the frames queued behind it on its channel
+// wait until it is done. Returns false when the channel queue is full.
+bool debug_link_send(debug_link_channel_t channel, const uint8_t *data, uint16_t len);
+
+// Same, with the payload in two parts, e.g. a record header and its bytes
+bool debug_link_send_with_header(debug_link_channel_t channel, const uint8_t *header, uint16_t header_len,
+                                 const uint8_t *data, uint16_t len);
+
+// Whether a frame of len payload bytes fits in the channel queue now, to
+// wait for room without counting a drop
+bool debug_link_fits(debug_link_channel_t channel, uint16_t len);
+
+// Retry a frame the UART queue had no room for; call from the main loop
+void debug_link_poll(void);
+
+const debug_link_stats_t *debug_link_get_stats(debug_link_channel_t channel);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // DEBUG_LINK_H
@@ -0,0 +1,72 @@
+/* irq_profile.h */
+
+#ifndef IRQ_PROFILE_H
+#define IRQ_PROFILE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    IRQ_PROFILE_USART1,
+    IRQ_PROFILE_USART2,
+    IRQ_PROFILE_DMA1_CH2_3,     // USART1 TX and RX DMA
+    IRQ_PROFILE_DMA1_CH4_5,     // USART2 TX and RX DMA
+    IRQ_PROFILE_SYSTICK,
+    IRQ_PROFILE_VECTORS,
+} irq_profile_vector_t;
+
+// Time in a handler, in timestamp_us(), without the handlers that
+// preempted it
+typedef struct {
+    uint32_t count;
+    uint32_t total_us;
+    uint32_t min_us;
+    uint32_t max_us;            // Jitter is max_us - min_us
+} irq_profile_stats_t;
+
+typedef struct {
+    uint32_t irq_latency_cycles;    // Latest SysTick entry after its reload: masked
+                                    // stretches plus the handlers ahead of it
+    uint32_t loop_max_us;           // Longest pass of the main loop
+    uint32_t irq_per_loop_max_us;   // Most handler time within one pass
+} irq_profile_loop_t;
+
+typedef struct {
+    uint32_t start_us;
+    uint32_t nested_us;
+} irq_profile_entry_t;
+
+// First and last thing in a handler:
+//   irq_profile_entry_t entry = irq_profile_enter();
+//   ...
+//   irq_profile_exit(IRQ_PROFILE_USART1, entry);
+irq_profile_entry_t irq_profile_enter(void);
+void irq_profile_exit(irq_profile_vector_t vector, irq_profile_entry_t entry);
+
+// First thing in SysTick_Handler: samples how late the tick is served
+void irq_profile_systick(void);
+
+// Once per main loop pass
+void irq_profile_poll(void);
+
+void irq_profile_reset(void);
+
+const irq_profile_stats_t *irq_profile_get_stats(irq_profile_vector_t vector);
+const irq_profile_loop_t *irq_profile_get_loop(void);
+
+// One line per vector that ran, then the main loop figures, e.g.
+// "irq usart1 n 5120 total 20480 max 9 jitter 6\r\n"
+// "irq latency 412 cycles, loop max 2210 us, irq per loop max 96 us\r\n"
+// Formats the line at *cursor (0 to start) and moves the cursor on; false
+// once the report is done
+bool irq_profile_report_line(uint8_t *cursor, char *line, uint16_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // IRQ_PROFILE_H
@@ -0,0 +1,44 @@
+/* ram_watermark.h */
+
+#ifndef RAM_WATERMARK_H
+#define RAM_WATERMARK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Fill of the free RAM between heap and stack; a word that no longer holds
+// it has been used
+#define RAM_WATERMARK_PATTERN 0xDEADBEEFu
+
+// Bytes, from the linker symbols of the STM32Cube linker script
+typedef struct {
+    uint32_t data;              // .data
+    uint32_t bss;               // .bss
+    uint32_t heap_used;         // Handed out by _sbrk() (sysmem.c)
+    uint32_t heap_peak;
+    uint32_t heap_reserved;     // _Min_Heap_Size
+    uint32_t stack_peak;        // Deepest the stack reached below _estack
+    uint32_t stack_reserved;    // _Min_Stack_Size
+    uint32_t untouched;         // Never used by heap or stack since the paint
+} ram_watermark_snapshot_t;
+
+// Paint the RAM below the stack pointer; first thing in main()
+void ram_watermark_paint(void);
+
+// Scans the painted RAM, so takes a few hundred microseconds
+void ram_watermark_snapshot(ram_watermark_snapshot_t *snapshot);
+
+// "ram data 12 bss 3020 heap 0/512 peak 0 stack 388/1024 untouched 4120\r\n"
+// as the only line of the report: formats it when *cursor is 0 and moves
+// the cursor on; false once the report is done
+bool ram_watermark_report_line(uint8_t *cursor, char *line, uint16_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RAM_WATERMARK_H
@@ -0,0 +1,33 @@
+/* timestamp.h */
+
+#ifndef TIMESTAMP_H
+#define TIMESTAMP_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The common microsecond clock of trace records, bridge captures, command
+// latencies and AT timeouts.
+//
+// By default TIM3 counts microseconds and its update event clocks TIM15,
+// which holds the upper 16 bits: a 32-bit counter that needs no interrupt
+// and reads the same with interrupts masked.
+//
+// -D TIMESTAMP_SYSTICK leaves both timers free and derives the time from
+// HAL_GetTick() and the SysTick count instead. That costs a division per
+// read and is only right while SysTick runs at 1 kHz.
+
+// Start the clock; call after SystemClock_Config(). Reads 0 until then.
+void timestamp_init(void);
+
+// Free running, wraps after about 71.6 minutes; compare by subtraction
+uint32_t timestamp_us(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TIMESTAMP_H
@@ -0,0 +1,98 @@
+/* trace.h */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Records only leave the board on the framed debug link: -D TRACE_ENABLED=1
+// with -D DEBUG_LINK_FRAMED. The ring and the trace channel queue take about
+// 768 bytes, more than the default builds have spare, so make room first
+// (see debug_link.h). Off, TRACE() compiles to nothing and no ring is linked.
+#ifndef TRACE_ENABLED
+#define TRACE_ENABLED 0
+#endif
+
+#if TRACE_ENABLED && !defined(DEBUG_LINK_FRAMED)
+#error "TRACE_ENABLED needs -D DEBUG_LINK_FRAMED"
+#endif
+
+// Ring of 32-bit words holding records not yet sent; power of two
+#ifndef TRACE_RING_WORDS
+#define TRACE_RING_WORDS 128
+#endif
+
+#define TRACE_MAX_ARGS 4
+
+// A record in the ring and on the trace channel, little endian words:
+//   word 0: format id (bits 0-23), argument count (bits 24-26)
+//   word 1: timestamp_us()
+//   words 2..: the arguments
+#define TRACE_ID_MASK   0x00FFFFFFu
+#define TRACE_ARGS_SHIFT 24
+
+// Each trace channel frame starts with this header, then whole records.
+// scripts/trace_decode.py turns them back into text.
+typedef struct {
+    uint32_t now_us;            // timestamp_us() when sent; counts the clock's wraps
+    uint32_t dropped;           // Records lost to a full ring since trace_init()
+} trace_frame_header_t;
+
+// The format string never reaches the target: it goes to .trace_fmt, which
+// holds no "a" flag (the '@' turns the flags GCC appends into an assembler
+// comment). The linker leaves that section at address 0 outside the image,
+// so a string's address is its offset in the ELF section and serves as id.
+#define TRACE_SECTION ".trace_fmt,\"\",%progbits @"
+
+typedef struct {
+    uint32_t records;
+    uint32_t dropped;
+    uint16_t peak_words;        // Most ring words in use
+} trace_stats_t;
+
+#if TRACE_ENABLED
+
+// TRACE("tx %u bytes on %u", len, instance): up to four integer arguments
+// for %d %i %u %x %X %o %c %p conversions. Safe from interrupt context; does
+// nothing before trace_init().
+#define TRACE(fmt, ...) \
+    do { \
+        static const char trace_fmt_[] __attribute__((section(TRACE_SECTION), used)) = fmt; \
+        trace_write((uint32_t)(uintptr_t)trace_fmt_, TRACE_NARGS_(_, ##__VA_ARGS__, 4, 3, 2, 1, 0), \
+                    TRACE_PAD_(_, ##__VA_ARGS__, 0, 0, 0, 0)); \
+    } while (0)
+
+// Argument count and the arguments padded with zeros to four
+#define TRACE_NARGS_(_0, _1, _2, _3, _4, n, ...) n
+#define TRACE_PAD_(_0, a, b, c, d, ...) (uint32_t)(a), (uint32_t)(b), (uint32_t)(c), (uint32_t)(d)
+
+// Start recording. Call after debug_link_init(); records only leave the
+// board on a framed debug link.
+void trace_init(void);
+
+void trace_write(uint32_t id, uint32_t argc, uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3);
+
+// Move whole records to the debug link trace channel; call from the main loop
+void trace_poll(void);
+
+const trace_stats_t *trace_get_stats(void);
+
+#else
+
+#define TRACE(fmt, ...) do { } while (0)
+
+static inline void trace_init(void) {}
+static inline void trace_poll(void) {}
+
+#endif // TRACE_ENABLED
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TRACE_H
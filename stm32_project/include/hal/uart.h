@@ -11,6 +11,15 @@
 extern "C" {
 #endif
 
+// Line rates, e.g. -D UART2_BAUDRATE=921600. Rates above 115200 need the
+// 48 MHz system clock. The ESP must already run at UART1_BAUDRATE.
+#ifndef UART1_BAUDRATE
+#define UART1_BAUDRATE 115200
+#endif
+#ifndef UART2_BAUDRATE
+#define UART2_BAUDRATE 115200
+#endif
+
 // UART identifiers
 typedef enum {
     UART1_INSTANCE,
@@ -21,8 +30,23 @@ typedef enum {
 HAL_StatusTypeDef uart_init(uart_instance_t instance);
 
 // Send data over the specified UART using DMA (Non-blocking)
+// The buffer is queued, not copied: it must stay valid until it has been sent.
 HAL_StatusTypeDef uart_send_dma(uart_instance_t instance, const uint8_t *data, uint16_t len);
 
+// Queue a buffer for DMA transmission and get a callback (from the DMA
+// interrupt) once it has been sent. Returns HAL_BUSY when the queue is full.
+typedef void (*uart_tx_done_callback_t)(void *ctx);
+HAL_StatusTypeDef uart_send_queued(uart_instance_t instance, const uint8_t *data, uint16_t len,
+                                   uart_tx_done_callback_t done, void *ctx);
+
+// Number of free entries in the transmit queue
+uint8_t uart_tx_free_slots(uart_instance_t instance);
+
+// See every transfer as its DMA starts, from interrupt context or with
+// interrupts off. The span is only valid during the call.
+typedef void (*uart_tx_observer_t)(const uint8_t *data, uint16_t len, void *ctx);
+void uart_set_tx_observer(uart_instance_t instance, uart_tx_observer_t observer, void *ctx);
+
 // Set a callback function for received data on the specified UART
 typedef void (*uart_rx_callback_t)(uint8_t);
 void uart_set_rx_callback(uart_instance_t instance, uart_rx_callback_t callback);
@@ -33,6 +57,20 @@ bool uart_receive(uart_instance_t instance, uint8_t *data);
 // Optional: Function to start UART reception with DMA
 HAL_StatusTypeDef uart_start_receive_dma(uart_instance_t instance, uint8_t *buffer, uint16_t len);
 
+// Receive continuously into buffer by circular DMA. The callback runs from
+// interrupt context at half and full buffer and whenever the line goes idle.
+typedef void (*uart_rx_stream_callback_t)(void *ctx);
+HAL_StatusTypeDef uart_start_rx_stream(uart_instance_t instance, uint8_t *buffer, uint16_t size,
+                                      uart_rx_stream_callback_t callback, void *ctx);
+
+// Bytes received since uart_start_rx_stream()
+uint32_t uart_rx_stream_count(uart_instance_t instance);
+
+// Contiguous span of the stream starting at byte *cursor. Sets *data and
+// returns the length, 0 when caught up; the caller advances *cursor by what it
+// consumed. Bytes already overwritten are skipped and added to *lost.
+uint16_t uart_rx_stream_peek(uart_instance_t instance, uint32_t *cursor, const uint8_t **data, uint32_t *lost);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,23 @@
+/* stm32_project/include/sysmem.h */
+
+/* Interface of src/sysmem.c; the CubeIDE project declares the same function
+   in its own Core/Inc/sysmem.h */
+
+#ifndef SYSMEM_H
+#define SYSMEM_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Heap bytes handed out by _sbrk(), counted from the _end linker symbol:
+// the current size for peak 0, else the largest size so far
+size_t _sbrk_usage(int peak);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SYSMEM_H
@@ -0,0 +1,131 @@
+/* stm32_project/src/at/boot.c */
+
+#include "at/boot.h"
+#include <string.h>
+
+#define BOOT_RESET_PULSE_MS   20     // EN low time; the ESP32-C3 needs far less
+#define BOOT_PROBE_PERIOD_MS  100
+#define BOOT_PROBE_TIMEOUT_MS 80
+
+typedef enum {
+    BOOT_IDLE,
+    BOOT_RESETTING,
+    BOOT_WAITING,
+    BOOT_READY,
+    BOOT_FAILED,
+} boot_state_t;
+
+static boot_state_t state = BOOT_IDLE;
+static BOOT_Config config;
+static BOOT_ReadyCallback ready_callback = NULL;
+static void *ready_ctx = NULL;
+static uint32_t start_tick = 0;
+static uint32_t reset_tick = 0;
+static uint32_t probe_tick = 0;
+static bool probe_busy = false;
+static BOOT_Timeline timeline;
+
+static void finish(AT_Result result) {
+    state = (result == AT_RESULT_OK) ? BOOT_READY : BOOT_FAILED;
+    if (result == AT_RESULT_OK) {
+        BOOT_Mark(BOOT_PHASE_ESP_READY);
+    }
+    if (ready_callback) {
+        ready_callback(result, ready_ctx);
+    }
+}
+
+static void ready_urc(const char *line, void *ctx) {
+    (void)line;
+    (void)ctx;
+    if (state == BOOT_WAITING) {
+        timeline.ready_urc = true;
+        finish(AT_RESULT_OK);
+    }
+}
+
+static void probe_done(AT_Result result, void *ctx) {
+    (void)ctx;
+    probe_busy = false;
+    if (state == BOOT_WAITING && result == AT_RESULT_OK) {
+        finish(AT_RESULT_OK);
+    }
+}
+
+void BOOT_Init(void) {
+    state = BOOT_IDLE;
+    probe_busy = false;
+    AT_RegisterUrcHandler("ready", '\0', ready_urc, NULL);
+}
+
+bool BOOT_Start(const BOOT_Config *boot_config, BOOT_ReadyCallback callback, void *ctx) {
+    if (state == BOOT_RESETTING || state == BOOT_WAITING) {
+        return false;
+    }
+
+    if (boot_config) {
+        config = *boot_config;
+    } else {
+        memset(&config, 0, sizeof(config));
+    }
+    ready_callback = callback;
+    ready_ctx = ctx;
+    start_tick = HAL_GetTick();
+    timeline.probes = 0;
+    timeline.ready_urc = false;
+
+    if (config.reset_port) {
+        HAL_GPIO_WritePin(config.reset_port, config.reset_pin, GPIO_PIN_RESET);
+        reset_tick = start_tick;
+        state = BOOT_RESETTING;
+    } else {
+        // The ESP may have been up all along; the first probe finds out
+        probe_tick = start_tick - BOOT_PROBE_PERIOD_MS;
+        state = BOOT_WAITING;
+    }
+    return true;
+}
+
+void BOOT_Poll(void) {
+    uint32_t now = HAL_GetTick();
+
+    switch (state) {
+    case BOOT_RESETTING:
+        if (now - reset_tick >= BOOT_RESET_PULSE_MS) {
+            HAL_GPIO_WritePin(config.reset_port, config.reset_pin, GPIO_PIN_SET);
+            probe_tick = now;
+            state = BOOT_WAITING;
+        }
+        break;
+
+    case BOOT_WAITING:
+        if (now - start_tick >= BOOT_READY_TIMEOUT_MS) {
+            finish(AT_RESULT_TIMEOUT);
+        } else if (!probe_busy && now - probe_tick >= BOOT_PROBE_PERIOD_MS) {
+            if (AT_SendCommand("AT\r\n", BOOT_PROBE_TIMEOUT_MS, probe_done, NULL)) {
+                probe_busy = true;
+                probe_tick = now;
+                timeline.probes++;
+            }
+        }
+        break;
+
+    default:
+        break;
+    }
+}
+
+bool BOOT_IsReady(void) {
+    return state == BOOT_READY;
+}
+
+void BOOT_Mark(BOOT_Phase phase) {
+    if (phase < BOOT_PHASE_COUNT && !(timeline.reached & (1u << phase))) {
+        timeline.ms[phase] = HAL_GetTick();
+        timeline.reached |= (uint8_t)(1u << phase);
+    }
+}
+
+const BOOT_Timeline *BOOT_GetTimeline(void) {
+    return &timeline;
+}
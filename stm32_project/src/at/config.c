@@ -0,0 +1,122 @@
+/* stm32_project/src/at/config.c */
+
+#include "at/config.h"
+#include "stm32f0xx_hal.h"
+#include <string.h>
+
+#define CONFIG_TIMEOUT_MS 2000
+
+static const CONFIG_Entry *entries = NULL;
+static uint8_t entry_count = 0;
+static uint8_t entry_index = 0;
+static bool seen = false;           // Query answer line received
+static bool in_sync = false;
+static AT_CommandCallback done_callback = NULL;
+static void *done_ctx = NULL;
+static uint32_t start_tick = 0;
+static CONFIG_Stats stats;
+
+static void next_entry(void);
+static void query_line(const char *line, void *ctx);
+
+static void finish(void) {
+    AT_CommandCallback callback = done_callback;
+
+    entries = NULL;
+    stats.elapsed_ms = HAL_GetTick() - start_tick;
+    if (callback) {
+        callback(stats.failed ? AT_RESULT_ERROR : AT_RESULT_OK, done_ctx);
+    }
+}
+
+static void set_done(AT_Result result, void *ctx) {
+    (void)ctx;
+    if (result != AT_RESULT_OK) {
+        stats.failed++;
+    }
+    entry_index++;
+    next_entry();
+}
+
+static void send_set(const CONFIG_Entry *entry) {
+    if (AT_SendCommand(entry->set, CONFIG_TIMEOUT_MS, set_done, NULL)) {
+        stats.applied++;
+    } else {
+        set_done(AT_RESULT_ERROR, NULL);
+    }
+}
+
+static void query_done(AT_Result result, void *ctx) {
+    (void)ctx;
+    const CONFIG_Entry *entry = &entries[entry_index];
+
+    stats.checked++;
+    if (entry->expected == NULL) {
+        in_sync = !seen;
+    }
+    // A query the firmware rejects says nothing; set the value to be sure
+    if (result == AT_RESULT_OK && in_sync) {
+        entry_index++;
+        next_entry();
+        return;
+    }
+
+    send_set(entry);
+}
+
+static void next_entry(void) {
+    while (entry_index < entry_count) {
+        const CONFIG_Entry *entry = &entries[entry_index];
+
+        // Settings without a query command are always sent
+        if (entry->query == NULL) {
+            send_set(entry);
+            return;
+        }
+
+        seen = false;
+        in_sync = false;
+        if (AT_SendQuery(entry->query, entry->prefix, CONFIG_TIMEOUT_MS, query_line, query_done, NULL)) {
+            return;
+        }
+        stats.failed++;
+        entry_index++;
+    }
+    finish();
+}
+
+// Lines starting with the entry's prefix while its query is on the wire
+static void query_line(const char *line, void *ctx) {
+    (void)ctx;
+    const CONFIG_Entry *entry = &entries[entry_index];
+
+    seen = true;
+    if (entry->expected) {
+        in_sync = (strcmp(line + strlen(entry->prefix), entry->expected) == 0);
+    }
+}
+
+void CONFIG_Init(void) {
+    entries = NULL;
+}
+
+bool CONFIG_Apply(const CONFIG_Entry *table, uint8_t count, AT_CommandCallback callback, void *ctx) {
+    if (entries != NULL || table == NULL) {
+        return false;
+    }
+
+    entries = table;
+    entry_count = count;
+    entry_index = 0;
+    done_callback = callback;
+    done_ctx = ctx;
+    start_tick = HAL_GetTick();
+    memset(&stats, 0, sizeof(stats));
+
+    next_entry();
+    return true;
+}
+
+const CONFIG_Stats *CONFIG_GetStats(void) {
+    return &stats;
+}
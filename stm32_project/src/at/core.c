@@ -2,17 +2,430 @@
 
 #include "at/core.h"
 #include "hal/uart.h"
+#include "hal/timestamp.h"
 #include <string.h>
 
 #define RESPONSE_BUFFER_SIZE 256
+#define COMMAND_QUEUE_SIZE   4
+#define MAX_URC_HANDLERS     20
+#define PAYLOAD_SPAN_MAX     0xFFFF  // One DMA transfer
+#define CLIENT_PREFIX_SIZE   24
+
+typedef struct {
+    const char *command;
+    uint32_t timeout_ms;
+    AT_CommandCallback callback;
+    void *ctx;
+    uint32_t payload_len;
+    AT_PayloadSource source;
+    void *source_ctx;
+    bool client;                     // Typed by the remote client
+    const char *response_prefix;     // Answer lines for response_handler, or NULL
+    AT_UrcHandler response_handler;
+} at_command_t;
+
+typedef struct {
+    const char *prefix;
+    uint8_t prefix_length;
+    char delimiter;
+    AT_UrcHandler handler;
+    void *ctx;
+} at_urc_entry_t;
 
 static AT_ResponseCallback response_callback = NULL;
 static char response_buffer[RESPONSE_BUFFER_SIZE];
 static uint16_t response_length = 0;
+static uint16_t line_bytes = 0;      // Received bytes of the current line, truncated or not
+static bool line_claimed = false;    // A payload header handler took the line
+static AT_Stats stats;
+
+// Commands are queued by reference; the head entry is the one on the wire
+static at_command_t command_queue[COMMAND_QUEUE_SIZE];
+static uint8_t queue_head = 0;
+static uint8_t queue_count = 0;
+static bool command_sent = false;
+static uint32_t command_activity_us = 0;
+
+// Payload streaming after the '>' prompt; one span is on the wire at a time
+static bool payload_active = false;
+static uint32_t payload_remaining = 0;
+static volatile bool payload_span_busy = false;
+
+static at_urc_entry_t urc_table[MAX_URC_HANDLERS];
+static uint8_t urc_count = 0;
+
+// Echo of the in-flight command, matched at line start without buffering it
+static uint16_t echo_length = 0;     // Command length without its line ending, 0 once seen
+static uint16_t echo_match = 0;
+static bool echo_tail = false;       // Dropping the "\r\r\n" that ends an echo
+static bool echo_on = false;
+static bool echo_auto_off = false;   // Send ATE0 again whenever an echo shows up
+static bool echo_off_pending = false;
+
+// Raw payload following a URC header (e.g. "+HTTPCLIENT:<len>,")
+static uint32_t raw_remaining = 0;
+static AT_RawDataHandler raw_handler = NULL;
+static void *raw_ctx = NULL;
+
+// Remote client sharing the link; one of its commands is queued at a time
+static AT_ClientOutput client_output = NULL;
+static void *client_ctx = NULL;
+static char client_line[AT_CLIENT_LINE_SIZE];
+static uint16_t client_line_length = 0;
+static char client_command[AT_CLIENT_LINE_SIZE + 2];
+static char client_prefix[CLIENT_PREFIX_SIZE];   // "+CWJAP" for "AT+CWJAP?"
+static uint8_t client_prefix_length = 0;
+static bool client_pending = false;
+static AT_LocalCommand local_command = NULL;
+static void *local_ctx = NULL;
+
+static AT_CommandObserver command_observer = NULL;
+static void *observer_ctx = NULL;
+
+static bool enqueue_command(const at_command_t *command);
+
+static void reset_line(void) {
+    response_length = 0;
+    response_buffer[0] = '\0';
+    line_bytes = 0;
+    line_claimed = false;
+}
+
+static void start_next_command(void) {
+    if (command_sent || queue_count == 0) {
+        return;
+    }
+
+    const char *command = command_queue[queue_head].command;
+    uint16_t length = (uint16_t)strlen(command);
+    if (uart_send_dma(UART1_INSTANCE, (const uint8_t *)command, length) == HAL_OK) {
+        command_sent = true;
+        command_activity_us = timestamp_us();
+        stats.commands++;
+        stats.command_bytes += length;
+        if (command_observer) {
+            command_observer(command, false, AT_RESULT_OK, observer_ctx);
+        }
+
+        echo_length = length;
+        while (echo_length > 0 && (command[echo_length - 1] == '\r' || command[echo_length - 1] == '\n')) {
+            echo_length--;
+        }
+        echo_match = 0;
+    }
+    // On HAL_BUSY the command stays queued and AT_Poll() retries
+}
+
+static void payload_span_done(void *ctx) {
+    (void)ctx;
+    payload_span_busy = false;
+}
+
+static void pump_payload(void) {
+    if (!payload_active || payload_span_busy || payload_remaining == 0) {
+        return;
+    }
+
+    const at_command_t *cmd = &command_queue[queue_head];
+    const uint8_t *span = NULL;
+    uint16_t max = (payload_remaining < PAYLOAD_SPAN_MAX) ? (uint16_t)payload_remaining : PAYLOAD_SPAN_MAX;
+    uint16_t len = cmd->source(&span, max, cmd->source_ctx);
+    if (len == 0 || span == NULL) {
+        return;
+    }
+    if (len > max) {
+        len = max;
+    }
+
+    payload_span_busy = true;
+    if (uart_send_queued(UART1_INSTANCE, span, len, payload_span_done, NULL) != HAL_OK) {
+        payload_span_busy = false;
+        return;
+    }
+    payload_remaining -= len;
+    command_activity_us = timestamp_us();
+}
+
+static void complete_command(AT_Result result) {
+    if (!command_sent) {
+        return;
+    }
+    payload_active = false;
+
+    at_command_t done = command_queue[queue_head];
+    queue_head = (queue_head + 1) % COMMAND_QUEUE_SIZE;
+    queue_count--;
+    command_sent = false;
+    echo_length = 0;
+    echo_match = 0;
+
+    if (command_observer) {
+        command_observer(done.command, true, result, observer_ctx);
+    }
+    if (done.callback) {
+        done.callback(result, done.ctx);
+    }
+    start_next_command();
+}
+
+// '#' in a prefix matches any digit, e.g. "#,CLOSED" for link URCs
+static bool prefix_matches(const at_urc_entry_t *entry) {
+    if (response_length < entry->prefix_length) {
+        return false;
+    }
+    for (uint8_t i = 0; i < entry->prefix_length; i++) {
+        char p = entry->prefix[i];
+        char c = response_buffer[i];
+        if (p == '#' ? (c < '0' || c > '9') : (p != c)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// A complete line goes to every matching handler (e.g. WIFI DISCONNECT);
+// a payload header only to the first, which takes the data that follows
+static bool dispatch_urc(char delimiter) {
+    bool handled = false;
+    for (uint8_t i = 0; i < urc_count; i++) {
+        const at_urc_entry_t *entry = &urc_table[i];
+        if (entry->delimiter == delimiter && prefix_matches(entry)) {
+            entry->handler(response_buffer, entry->ctx);
+            handled = true;
+            if (delimiter != '\0') {
+                break;
+            }
+        }
+    }
+    return handled;
+}
+
+static void echo_off_done(AT_Result result, void *ctx) {
+    (void)ctx;
+    echo_off_pending = false;
+    if (result == AT_RESULT_OK) {
+        echo_on = false;
+    }
+}
+
+static bool request_echo_off(void) {
+    if (echo_off_pending || !AT_SendCommand("ATE0\r\n", 1000, echo_off_done, NULL)) {
+        return false;
+    }
+    echo_off_pending = true;
+    return true;
+}
+
+static void echo_seen(void) {
+    stats.echo_lines++;
+    stats.echo_bytes += echo_length;
+    echo_length = 0;
+    echo_match = 0;
+    echo_tail = true;
+    echo_on = true;
+
+    // E.g. the ESP was reset behind our back and came up with echo on again
+    if (echo_auto_off && request_echo_off()) {
+        stats.echo_renegotiations++;
+    }
+}
+
+// Returns true if c was consumed as part of an echo
+static bool filter_echo(char c) {
+    if (echo_tail) {
+        if (c == '\r') {
+            return true;
+        }
+        echo_tail = false;
+        if (c == '\n') {
+            reset_line();
+            return true;
+        }
+    }
+
+    if (response_length > 0 || echo_length == 0) {
+        return false;
+    }
+    const char *command = command_queue[queue_head].command;
+    if (c == command[echo_match]) {
+        if (++echo_match == echo_length) {
+            echo_seen();
+        }
+        return true;
+    }
+
+    // Not an echo after all: put back what was held, it equals the command so far
+    if (echo_match > 0) {
+        uint16_t n = (echo_match < RESPONSE_BUFFER_SIZE - 1) ? echo_match : RESPONSE_BUFFER_SIZE - 1;
+        memcpy(response_buffer, command, n);
+        response_length = n;
+        response_buffer[n] = '\0';
+        echo_match = 0;
+    }
+    return false;
+}
+
+static bool client_turn(void) {
+    return command_sent && command_queue[queue_head].client;
+}
+
+static void client_write(const char *text, uint16_t len) {
+    if (client_output) {
+        stats.client_bytes += len;
+        client_output((const uint8_t *)text, len, client_ctx);
+    }
+}
+
+static void client_write_line(void) {
+    client_write(response_buffer, response_length);
+    client_write("\r\n", 2);
+}
+
+// "+CWJAP:..." answering the client's AT+CWJAP? belongs to the client only
+static bool is_client_response(void) {
+    return client_prefix_length > 0 && client_turn() &&
+           response_length > client_prefix_length &&
+           response_buffer[client_prefix_length] == ':' &&
+           strncmp(response_buffer, client_prefix, client_prefix_length) == 0;
+}
+
+// "+CWMODE:1" answering a firmware AT_SendQuery() goes to the query's handler
+static bool is_command_response(void) {
+    if (!command_sent) {
+        return false;
+    }
+    const char *prefix = command_queue[queue_head].response_prefix;
+    return prefix != NULL && strncmp(response_buffer, prefix, strlen(prefix)) == 0;
+}
+
+static void client_done(AT_Result result, void *ctx) {
+    (void)ctx;
+    client_pending = false;
+    // Other results reached the client as lines
+    if (result == AT_RESULT_TIMEOUT) {
+        client_write("ERROR\r\n", 7);
+    }
+}
+
+static void client_submit(void) {
+    if (client_line[0] == '#') {
+        // For the STM32 itself, never sent to the ESP
+        client_line[client_line_length] = '\0';
+        if (local_command && local_command(client_line, local_ctx)) {
+            client_write("OK\r\n", 4);
+        } else {
+            client_write("ERROR\r\n", 7);
+        }
+        return;
+    }
+    if (client_pending) {
+        // What the ESP itself answers while it is busy
+        client_write("busy p...\r\n", 11);
+        return;
+    }
+
+    memcpy(client_command, client_line, client_line_length);
+    memcpy(client_command + client_line_length, "\r\n", 3);
+
+    // Response lines carry the command name: "AT+CWJAP?" -> "+CWJAP"
+    client_prefix_length = 0;
+    if (client_line_length > 3 && client_line[2] == '+') {
+        for (uint16_t i = 2; i < client_line_length && client_prefix_length < CLIENT_PREFIX_SIZE - 1; i++) {
+            char c = client_line[i];
+            if (c == '=' || c == '?') {
+                break;
+            }
+            client_prefix[client_prefix_length++] = c;
+        }
+    }
+    client_prefix[client_prefix_length] = '\0';
+
+    at_command_t command = {
+        .command = client_command,
+        .timeout_ms = AT_CLIENT_TIMEOUT_MS,
+        .callback = client_done,
+        .client = true,
+    };
+    if (!enqueue_command(&command)) {
+        client_write("busy p...\r\n", 11);
+        return;
+    }
+    client_pending = true;
+    stats.client_commands++;
+}
+
+static void process_line(void) {
+    if (response_length > 0 && response_buffer[response_length - 1] == '\r') {
+        response_buffer[--response_length] = '\0';
+    }
+    if (response_length == 0) {
+        return;
+    }
+
+    bool is_final = true;
+    AT_Result result = AT_RESULT_OK;
+    if (strcmp(response_buffer, "OK") == 0) {
+        // Payload commands answer OK before the prompt and finish with SEND OK
+        is_final = !(command_sent && command_queue[queue_head].payload_len > 0);
+    } else if (strcmp(response_buffer, "SEND OK") == 0) {
+        result = AT_RESULT_OK;
+    } else if (strcmp(response_buffer, "ERROR") == 0) {
+        result = AT_RESULT_ERROR;
+    } else if (strcmp(response_buffer, "SEND FAIL") == 0) {
+        result = AT_RESULT_SEND_FAIL;
+    } else {
+        is_final = false;
+    }
+
+    if (is_final) {
+        if (client_turn()) {
+            client_write_line();
+        } else if (response_callback) {
+            response_callback(response_buffer);
+        }
+        complete_command(result);
+    } else if (is_client_response()) {
+        client_write_line();
+    } else if (is_command_response()) {
+        const at_command_t *cmd = &command_queue[queue_head];
+        cmd->response_handler(response_buffer, cmd->ctx);
+    } else if (!dispatch_urc('\0') && !line_claimed) {
+        // Nobody wanted this line: the bytes were spent for nothing
+        stats.unclaimed_lines++;
+        stats.unclaimed_bytes += line_bytes;
+
+        // Unsolicited, or part of the client's answer; firmware responses stay here
+        if (!command_sent || client_turn()) {
+            client_write_line();
+        }
+    }
+}
 
 void AT_Init(void) {
     memset(response_buffer, 0, sizeof(response_buffer));
     response_length = 0;
+    queue_head = 0;
+    queue_count = 0;
+    command_sent = false;
+    payload_active = false;
+    payload_span_busy = false;
+    urc_count = 0;
+    raw_remaining = 0;
+    raw_handler = NULL;
+    line_bytes = 0;
+    line_claimed = false;
+    echo_length = 0;
+    echo_match = 0;
+    echo_tail = false;
+    echo_on = false;
+    echo_auto_off = false;
+    echo_off_pending = false;
+    client_output = NULL;
+    client_line_length = 0;
+    client_prefix_length = 0;
+    client_pending = false;
+    command_observer = NULL;
+    memset(&stats, 0, sizeof(stats));
 }
 
 void AT_RegisterCallback(AT_ResponseCallback callback) {
@@ -20,27 +433,213 @@ void AT_RegisterCallback(AT_ResponseCallback callback) {
 }
 
 void AT_ProcessReceivedByte(uint8_t received_byte) {
-    if (response_length < RESPONSE_BUFFER_SIZE - 1) {
-        response_buffer[response_length++] = received_byte;
-        response_buffer[response_length] = '\0'; // Null-terminate
+    AT_ProcessReceivedData(&received_byte, 1);
+}
+
+void AT_ProcessReceivedData(const uint8_t *data, uint16_t len) {
+    stats.rx_bytes += len;
+    // Long transfers stay alive as long as the ESP keeps talking
+    if (command_sent && len > 0) {
+        command_activity_us = timestamp_us();
     }
 
-    // Check if the response contains "OK" or "ERROR"
-    if (strstr(response_buffer, "OK") != NULL) {
-        if (response_callback) {
-            response_callback("OK");
+    while (len > 0) {
+        if (raw_remaining > 0) {
+            uint16_t chunk = (raw_remaining < len) ? (uint16_t)raw_remaining : len;
+            if (raw_handler) {
+                raw_handler(data, chunk, raw_ctx);
+            }
+            raw_remaining -= chunk;
+            data += chunk;
+            len -= chunk;
+            continue;
+        }
+
+        char c = (char)*data++;
+        len--;
+        line_bytes++;
+
+        if ((echo_tail || echo_length > 0) && filter_echo(c)) {
+            continue;
+        }
+
+        if (c == '\n') {
+            process_line();
+            reset_line();
+            continue;
+        }
+
+        // The data prompt is not followed by a line ending
+        if (c == '>' && response_length == 0 && command_sent &&
+            command_queue[queue_head].payload_len > 0 && !payload_active) {
+            payload_active = true;
+            payload_remaining = command_queue[queue_head].payload_len;
+            line_bytes = 0;
+            pump_payload();
+            continue;
+        }
+
+        if (response_length < RESPONSE_BUFFER_SIZE - 1) {
+            response_buffer[response_length++] = c;
+            response_buffer[response_length] = '\0'; // Null-terminate
         }
-        // Reset the buffer
-        memset(response_buffer, 0, sizeof(response_buffer));
-        response_length = 0;
+
+        // Headers announcing a payload are dispatched before the line ends.
+        // The handler sees every delimiter until it switches to raw data.
+        if ((c == ',' || c == ':') && !is_client_response() && !is_command_response()) {
+            if (dispatch_urc(c)) {
+                line_claimed = true;
+                if (raw_remaining > 0) {
+                    reset_line();
+                }
+            }
+        }
+    }
+}
+
+bool AT_SendCommand(const char *command, uint32_t timeout_ms, AT_CommandCallback callback, void *ctx) {
+    return AT_SendCommandWithPayload(command, 0, NULL, NULL, timeout_ms, callback, ctx);
+}
+
+bool AT_SendCommandWithPayload(const char *command, uint32_t payload_len,
+                               AT_PayloadSource source, void *source_ctx,
+                               uint32_t timeout_ms, AT_CommandCallback callback, void *ctx) {
+    if (timeout_ms > AT_MAX_TIMEOUT_MS) {
+        return false;
     }
-    else if (strstr(response_buffer, "ERROR") != NULL) {
-        if (response_callback) {
-            response_callback("ERROR");
+
+    at_command_t cmd = {
+        .command = command,
+        .timeout_ms = timeout_ms,
+        .callback = callback,
+        .ctx = ctx,
+        .payload_len = payload_len,
+        .source = source,
+        .source_ctx = source_ctx,
+    };
+    return enqueue_command(&cmd);
+}
+
+bool AT_SendQuery(const char *command, const char *prefix, uint32_t timeout_ms,
+                  AT_UrcHandler on_line, AT_CommandCallback callback, void *ctx) {
+    if (prefix == NULL || on_line == NULL || timeout_ms > AT_MAX_TIMEOUT_MS) {
+        return false;
+    }
+
+    at_command_t cmd = {
+        .command = command,
+        .timeout_ms = timeout_ms,
+        .callback = callback,
+        .ctx = ctx,
+        .response_prefix = prefix,
+        .response_handler = on_line,
+    };
+    return enqueue_command(&cmd);
+}
+
+static bool enqueue_command(const at_command_t *command) {
+    if (queue_count >= COMMAND_QUEUE_SIZE || (command->payload_len > 0 && command->source == NULL)) {
+        return false;
+    }
+
+    command_queue[(queue_head + queue_count) % COMMAND_QUEUE_SIZE] = *command;
+    queue_count++;
+
+    start_next_command();
+    return true;
+}
+
+void AT_AttachClient(AT_ClientOutput output, void *ctx) {
+    client_output = output;
+    client_ctx = ctx;
+}
+
+void AT_SetLocalCommandHandler(AT_LocalCommand handler, void *ctx) {
+    local_command = handler;
+    local_ctx = ctx;
+}
+
+void AT_SetCommandObserver(AT_CommandObserver observer, void *ctx) {
+    command_observer = observer;
+    observer_ctx = ctx;
+}
+
+void AT_ClientInput(const uint8_t *data, uint16_t len) {
+    for (uint16_t i = 0; i < len; i++) {
+        char c = (char)data[i];
+
+        if (c == '\r' || c == '\n') {
+            if (client_line_length > 0) {
+                client_submit();
+            }
+            client_line_length = 0;
+        } else if (client_line_length < AT_CLIENT_LINE_SIZE - 1) {
+            client_line[client_line_length++] = c;
         }
-        // Reset the buffer
-        memset(response_buffer, 0, sizeof(response_buffer));
-        response_length = 0;
     }
-    // Add more response checks as needed
+}
+
+void AT_NegotiateEcho(void) {
+    echo_auto_off = true;
+    request_echo_off();
+}
+
+bool AT_IsEchoOn(void) {
+    return echo_on;
+}
+
+void AT_CompleteCommand(AT_Result result) {
+    complete_command(result);
+}
+
+const char *AT_GetCurrentCommand(void) {
+    return command_sent ? command_queue[queue_head].command : NULL;
+}
+
+void AT_Poll(void) {
+    pump_payload();
+
+    if (command_sent) {
+        if (timestamp_us() - command_activity_us >= command_queue[queue_head].timeout_ms * 1000) {
+            raw_remaining = 0;
+            reset_line();
+            complete_command(AT_RESULT_TIMEOUT);
+        }
+    } else {
+        start_next_command();
+    }
+}
+
+bool AT_RegisterUrcHandler(const char *prefix, char delimiter, AT_UrcHandler handler, void *ctx) {
+    if (urc_count >= MAX_URC_HANDLERS || handler == NULL) {
+        return false;
+    }
+
+    at_urc_entry_t *entry = &urc_table[urc_count++];
+    entry->prefix = prefix;
+    entry->prefix_length = (uint8_t)strlen(prefix);
+    entry->delimiter = delimiter;
+    entry->handler = handler;
+    entry->ctx = ctx;
+    return true;
+}
+
+bool AT_HasUrcHandler(const char *prefix) {
+    for (uint8_t i = 0; i < urc_count; i++) {
+        if (strcmp(urc_table[i].prefix, prefix) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void AT_BeginRawData(uint32_t len, AT_RawDataHandler handler, void *ctx) {
+    stats.raw_blocks++;
+    raw_remaining = len;
+    raw_handler = handler;
+    raw_ctx = ctx;
+}
+
+const AT_Stats *AT_GetStats(void) {
+    return &stats;
 }
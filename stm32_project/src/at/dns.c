@@ -0,0 +1,232 @@
+/* stm32_project/src/at/dns.c */
+
+#include "at/dns.h"
+#include "stm32f0xx_hal.h"
+#include <stdio.h>
+#include <string.h>
+
+#define DNS_TIMEOUT_MS  10000
+#define DNS_MAX_WAITERS 5       // One per link connecting at once
+
+typedef enum {
+    DNS_ENTRY_FREE,
+    DNS_ENTRY_RESOLVING,
+    DNS_ENTRY_VALID,
+} dns_entry_state_t;
+
+typedef struct {
+    dns_entry_state_t state;
+    char host[DNS_HOST_SIZE];
+    char address[DNS_ADDRESS_SIZE];
+    uint32_t resolved_tick;
+    uint32_t used_tick;
+    char command[DNS_HOST_SIZE + 20];   // Owned by the AT queue while resolving
+} dns_entry_t;
+
+typedef struct {
+    dns_entry_t *entry;
+    DNS_Callback callback;
+    void *ctx;
+} dns_waiter_t;
+
+static dns_entry_t cache[DNS_CACHE_SIZE];
+static dns_waiter_t waiters[DNS_MAX_WAITERS];
+static char last_address[DNS_ADDRESS_SIZE];
+static DNS_Stats stats;
+
+static bool entry_expired(const dns_entry_t *entry) {
+    return HAL_GetTick() - entry->resolved_tick >= DNS_TTL_MS;
+}
+
+static dns_entry_t *find_entry(const char *host) {
+    for (uint8_t i = 0; i < DNS_CACHE_SIZE; i++) {
+        if (cache[i].state != DNS_ENTRY_FREE && strcmp(cache[i].host, host) == 0) {
+            return &cache[i];
+        }
+    }
+    return NULL;
+}
+
+// A free entry, else the least recently used resolved one
+static dns_entry_t *alloc_entry(void) {
+    dns_entry_t *victim = NULL;
+
+    for (uint8_t i = 0; i < DNS_CACHE_SIZE; i++) {
+        dns_entry_t *entry = &cache[i];
+        if (entry->state == DNS_ENTRY_FREE) {
+            return entry;
+        }
+        if (entry->state == DNS_ENTRY_VALID &&
+            (victim == NULL || (int32_t)(entry->used_tick - victim->used_tick) < 0)) {
+            victim = entry;
+        }
+    }
+    return victim;
+}
+
+static bool add_waiter(dns_entry_t *entry, DNS_Callback callback, void *ctx) {
+    for (uint8_t i = 0; i < DNS_MAX_WAITERS; i++) {
+        if (waiters[i].entry == NULL) {
+            waiters[i].entry = entry;
+            waiters[i].callback = callback;
+            waiters[i].ctx = ctx;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void notify_waiters(dns_entry_t *entry, AT_Result result) {
+    const char *address = (result == AT_RESULT_OK) ? entry->address : NULL;
+
+    for (uint8_t i = 0; i < DNS_MAX_WAITERS; i++) {
+        if (waiters[i].entry == entry) {
+            dns_waiter_t waiter = waiters[i];
+            waiters[i].entry = NULL;
+            if (waiter.callback) {
+                waiter.callback(address, result, waiter.ctx);
+            }
+        }
+    }
+}
+
+static void dns_query_done(AT_Result result, void *ctx) {
+    dns_entry_t *entry = (dns_entry_t *)ctx;
+
+    if (result == AT_RESULT_OK && !DNS_IsAddress(last_address)) {
+        result = AT_RESULT_ERROR;
+    }
+    if (result == AT_RESULT_OK) {
+        memcpy(entry->address, last_address, sizeof(entry->address));
+        entry->state = DNS_ENTRY_VALID;
+        entry->resolved_tick = HAL_GetTick();
+        entry->used_tick = entry->resolved_tick;
+    } else {
+        stats.failures++;
+        entry->state = DNS_ENTRY_FREE;
+    }
+    last_address[0] = '\0';
+    notify_waiters(entry, result);
+}
+
+// "+CIPDOMAIN:<IP address>", quoted by some firmware versions
+static void dns_domain_urc(const char *line, void *ctx) {
+    (void)ctx;
+    const char *value = line + strlen("+CIPDOMAIN:");
+    uint8_t n = 0;
+
+    if (*value == '"') {
+        value++;
+    }
+    while (value[n] != '\0' && value[n] != '"' && n < sizeof(last_address) - 1) {
+        last_address[n] = value[n];
+        n++;
+    }
+    last_address[n] = '\0';
+}
+
+static void dns_disconnect_urc(const char *line, void *ctx) {
+    (void)line;
+    (void)ctx;
+    DNS_Flush();
+}
+
+void DNS_Init(void) {
+    memset(cache, 0, sizeof(cache));
+    memset(waiters, 0, sizeof(waiters));
+    memset(&stats, 0, sizeof(stats));
+    last_address[0] = '\0';
+
+    AT_RegisterUrcHandler("+CIPDOMAIN:", '\0', dns_domain_urc, NULL);
+    AT_RegisterUrcHandler("WIFI DISCONNECT", '\0', dns_disconnect_urc, NULL);
+}
+
+bool DNS_IsAddress(const char *host) {
+    uint8_t dots = 0;
+    uint8_t digits = 0;
+
+    for (; *host != '\0'; host++) {
+        if (*host == '.') {
+            if (digits == 0) {
+                return false;
+            }
+            dots++;
+            digits = 0;
+        } else if (*host >= '0' && *host <= '9' && digits < 3) {
+            digits++;
+        } else {
+            return false;
+        }
+    }
+    return dots == 3 && digits > 0;
+}
+
+bool DNS_Resolve(const char *host, DNS_Callback callback, void *ctx) {
+    if (strlen(host) >= DNS_HOST_SIZE) {
+        return false;
+    }
+
+    dns_entry_t *entry = find_entry(host);
+    if (entry && entry->state == DNS_ENTRY_VALID && entry_expired(entry)) {
+        entry->state = DNS_ENTRY_FREE;
+        entry = NULL;
+    }
+
+    if (entry && entry->state == DNS_ENTRY_VALID) {
+        stats.hits++;
+        entry->used_tick = HAL_GetTick();
+        if (callback) {
+            callback(entry->address, AT_RESULT_OK, ctx);
+        }
+        return true;
+    }
+
+    if (entry) {
+        // Already being looked up for another caller
+        return add_waiter(entry, callback, ctx);
+    }
+
+    entry = alloc_entry();
+    if (entry == NULL) {
+        return false;
+    }
+    snprintf(entry->command, sizeof(entry->command), "AT+CIPDOMAIN=\"%s\"\r\n", host);
+    if (!add_waiter(entry, callback, ctx)) {
+        return false;
+    }
+    if (!AT_SendCommand(entry->command, DNS_TIMEOUT_MS, dns_query_done, entry)) {
+        for (uint8_t i = 0; i < DNS_MAX_WAITERS; i++) {
+            if (waiters[i].entry == entry) {
+                waiters[i].entry = NULL;
+            }
+        }
+        return false;
+    }
+
+    memcpy(entry->host, host, strlen(host) + 1);
+    entry->state = DNS_ENTRY_RESOLVING;
+    stats.misses++;
+    return true;
+}
+
+void DNS_Invalidate(const char *address) {
+    for (uint8_t i = 0; i < DNS_CACHE_SIZE; i++) {
+        if (cache[i].state == DNS_ENTRY_VALID && strcmp(cache[i].address, address) == 0) {
+            cache[i].state = DNS_ENTRY_FREE;
+        }
+    }
+}
+
+// Lookups in flight are left to complete
+void DNS_Flush(void) {
+    for (uint8_t i = 0; i < DNS_CACHE_SIZE; i++) {
+        if (cache[i].state == DNS_ENTRY_VALID) {
+            cache[i].state = DNS_ENTRY_FREE;
+        }
+    }
+    stats.flushes++;
+}
+
+const DNS_Stats *DNS_GetStats(void) {
+    return &stats;
+}
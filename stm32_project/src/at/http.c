@@ -0,0 +1,177 @@
+/* stm32_project/src/at/http.c */
+
+#include "at/http.h"
+#include "stm32f0xx_hal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define HTTP_COMMAND_SIZE 192
+#define HTTP_TIMEOUT_MS   10000
+
+static char http_command[HTTP_COMMAND_SIZE];
+static const char *http_url = NULL;
+static HTTP_Handlers http_handlers;
+static bool http_busy = false;
+static bool http_started = false;
+static int32_t http_content_length = -1;
+static uint32_t http_received = 0;
+static uint32_t http_start_tick = 0;
+static uint32_t http_last_latency_ms = 0;
+
+static void http_start(void) {
+    if (!http_started) {
+        http_started = true;
+        if (http_handlers.on_start) {
+            http_handlers.on_start(0, http_content_length, http_handlers.ctx);
+        }
+    }
+}
+
+static void http_body_sink(const uint8_t *data, uint16_t len, void *ctx) {
+    (void)ctx;
+    http_received += len;
+    if (http_handlers.on_body) {
+        http_handlers.on_body(data, len, http_handlers.ctx);
+    }
+}
+
+// "+HTTPCLIENT:<len>," and "+HTTPCGET:<len>," precede each body chunk
+static void http_chunk_header(const char *line, void *ctx) {
+    (void)ctx;
+    if (!http_busy) {
+        return;
+    }
+
+    const char *colon = strchr(line, ':');
+    uint32_t len = strtoul(colon + 1, NULL, 10);
+    http_start();
+    AT_BeginRawData(len, http_body_sink, NULL);
+}
+
+static void http_size_urc(const char *line, void *ctx) {
+    (void)ctx;
+    if (http_busy) {
+        http_content_length = (int32_t)strtol(line + strlen("+HTTPGETSIZE:"), NULL, 10);
+    }
+}
+
+static void http_finish(AT_Result result, void *ctx) {
+    (void)ctx;
+    http_busy = false;
+    http_last_latency_ms = HAL_GetTick() - http_start_tick;
+    if (http_handlers.on_complete) {
+        http_handlers.on_complete(result, http_received, http_handlers.ctx);
+    }
+}
+
+static void http_size_done(AT_Result result, void *ctx) {
+    if (result != AT_RESULT_OK) {
+        http_finish(result, ctx);
+        return;
+    }
+
+    // The size is known before the first body byte arrives
+    http_start();
+    snprintf(http_command, sizeof(http_command), "AT+HTTPCGET=\"%s\"\r\n", http_url);
+    if (!AT_SendCommand(http_command, HTTP_TIMEOUT_MS, http_finish, NULL)) {
+        http_finish(AT_RESULT_ERROR, NULL);
+    }
+}
+
+static bool http_begin(const char *url, const HTTP_Handlers *handlers) {
+    if (http_busy || url == NULL || handlers == NULL) {
+        return false;
+    }
+
+    http_handlers = *handlers;
+    http_url = url;
+    http_started = false;
+    http_content_length = -1;
+    http_received = 0;
+    http_start_tick = HAL_GetTick();
+    return true;
+}
+
+void HTTP_Init(void) {
+    http_busy = false;
+    AT_RegisterUrcHandler("+HTTPCLIENT:", ',', http_chunk_header, NULL);
+    AT_RegisterUrcHandler("+HTTPCGET:", ',', http_chunk_header, NULL);
+    AT_RegisterUrcHandler("+HTTPCPOST:", ',', http_chunk_header, NULL);
+    AT_RegisterUrcHandler("+HTTPCPUT:", ',', http_chunk_header, NULL);
+    AT_RegisterUrcHandler("+HTTPGETSIZE:", '\0', http_size_urc, NULL);
+}
+
+bool HTTP_Get(const char *url, bool query_size, const HTTP_Handlers *handlers) {
+    if (!http_begin(url, handlers)) {
+        return false;
+    }
+
+    int n;
+    AT_CommandCallback done;
+    if (query_size) {
+        n = snprintf(http_command, sizeof(http_command), "AT+HTTPGETSIZE=\"%s\"\r\n", url);
+        done = http_size_done;
+    } else {
+        n = snprintf(http_command, sizeof(http_command), "AT+HTTPCGET=\"%s\"\r\n", url);
+        done = http_finish;
+    }
+    if (n < 0 || n >= (int)sizeof(http_command)) {
+        return false;
+    }
+
+    http_busy = AT_SendCommand(http_command, HTTP_TIMEOUT_MS, done, NULL);
+    return http_busy;
+}
+
+bool HTTP_Request(HTTP_Method method, const char *url, const HTTP_Handlers *handlers) {
+    if (method == HTTP_METHOD_POST || method == HTTP_METHOD_PUT || !http_begin(url, handlers)) {
+        return false;
+    }
+
+    // transport_type 2 selects TLS
+    int transport = (strncmp(url, "https://", 8) == 0) ? 2 : 1;
+    int n = snprintf(http_command, sizeof(http_command),
+                     "AT+HTTPCLIENT=%d,0,\"%s\",,,%d\r\n", (int)method, url, transport);
+    if (n < 0 || n >= (int)sizeof(http_command)) {
+        return false;
+    }
+
+    http_busy = AT_SendCommand(http_command, HTTP_TIMEOUT_MS, http_finish, NULL);
+    return http_busy;
+}
+
+bool HTTP_Upload(HTTP_Method method, const char *url, const char *content_type,
+                 uint32_t content_length, AT_PayloadSource source, void *source_ctx,
+                 const HTTP_Handlers *handlers) {
+    if ((method != HTTP_METHOD_POST && method != HTTP_METHOD_PUT) ||
+        content_length == 0 || source == NULL || !http_begin(url, handlers)) {
+        return false;
+    }
+
+    const char *verb = (method == HTTP_METHOD_POST) ? "POST" : "PUT";
+    int n;
+    if (content_type) {
+        n = snprintf(http_command, sizeof(http_command),
+                     "AT+HTTPC%s=\"%s\",%lu,1,\"Content-Type: %s\"\r\n",
+                     verb, url, (unsigned long)content_length, content_type);
+    } else {
+        n = snprintf(http_command, sizeof(http_command), "AT+HTTPC%s=\"%s\",%lu\r\n",
+                     verb, url, (unsigned long)content_length);
+    }
+    if (n < 0 || n >= (int)sizeof(http_command)) {
+        return false;
+    }
+
+    http_busy = AT_SendCommandWithPayload(http_command, content_length, source, source_ctx,
+                                          HTTP_TIMEOUT_MS, http_finish, NULL);
+    return http_busy;
+}
+
+bool HTTP_IsBusy(void) {
+    return http_busy;
+}
+
+uint32_t HTTP_GetLastLatency(void) {
+    return http_last_latency_ms;
+}
@@ -0,0 +1,326 @@
+/* stm32_project/src/at/http_download.c */
+
+#include "at/http_download.h"
+#include "stm32f0xx_hal.h"
+#include <stdio.h>
+#include <string.h>
+
+static void download_kick(HTTP_Download *download);
+static void worker_on_complete(AT_Result result, uint32_t body_length, void *ctx);
+
+static uint32_t range_start(const HTTP_Download *download, uint32_t range) {
+    return range * download->config.range_size;
+}
+
+static uint32_t range_length(const HTTP_Download *download, uint32_t range) {
+    uint32_t start = range_start(download, range);
+    uint32_t left = download->config.length - start;
+    return (left < download->config.range_size) ? left : download->config.range_size;
+}
+
+static HTTP_DownloadSlot *find_slot(HTTP_Download *download, uint32_t range) {
+    for (uint8_t i = 0; i < download->slot_count; i++) {
+        if (download->slots[i].used && download->slots[i].range == range) {
+            return &download->slots[i];
+        }
+    }
+    return NULL;
+}
+
+static HTTP_DownloadSlot *alloc_slot(HTTP_Download *download, uint32_t range) {
+    for (uint8_t i = 0; i < download->slot_count; i++) {
+        HTTP_DownloadSlot *slot = &download->slots[i];
+        if (!slot->used) {
+            slot->used = true;
+            slot->range = range;
+            slot->received = 0;
+            return slot;
+        }
+    }
+    return NULL;
+}
+
+static uint8_t *slot_data(HTTP_Download *download, const HTTP_DownloadSlot *slot) {
+    return download->config.reorder_buffer + (uint32_t)(slot - download->slots) * download->config.range_size;
+}
+
+static void finish(HTTP_Download *download, AT_Result result) {
+    if (!download->running) {
+        return;
+    }
+    download->running = false;
+    download->result = result;
+    download->stats.elapsed_ms = HAL_GetTick() - download->start_tick;
+
+    for (uint8_t i = 0; i < download->config.links; i++) {
+        HTTP_SessionClose(&download->workers[i].session);
+    }
+    if (download->config.done) {
+        uint32_t delivered = (result == AT_RESULT_OK) ? download->config.length :
+                             range_start(download, download->deliver_range) + download->deliver_received;
+        download->config.done(result, delivered, download->config.ctx);
+    }
+}
+
+static void deliver(HTTP_Download *download, const uint8_t *data, uint32_t len) {
+    // The sink takes at most a UART block at a time
+    while (len > 0) {
+        uint16_t n = (len > 0xFFFF) ? 0xFFFF : (uint16_t)len;
+        download->config.sink(data, n, download->config.ctx);
+        download->deliver_received += n;
+        data += n;
+        len -= n;
+    }
+}
+
+// The range being delivered is complete: promote the next one and flush
+// whatever it already buffered
+static void advance(HTTP_Download *download) {
+    while (download->deliver_received >= range_length(download, download->deliver_range)) {
+        download->deliver_range++;
+        download->deliver_received = 0;
+        if (download->deliver_range >= download->range_count) {
+            finish(download, AT_RESULT_OK);
+            return;
+        }
+
+        HTTP_DownloadSlot *slot = find_slot(download, download->deliver_range);
+        if (slot == NULL) {
+            return;
+        }
+        deliver(download, slot_data(download, slot), slot->received);
+        slot->used = false;
+    }
+}
+
+// Bytes of the worker's range received so far, across all its requests
+static uint32_t range_received(HTTP_Download *download, const HTTP_DownloadWorker *worker) {
+    if (worker->range == download->deliver_range) {
+        return download->deliver_received;
+    }
+    const HTTP_DownloadSlot *slot = find_slot(download, worker->range);
+    return slot ? slot->received : 0;
+}
+
+static void worker_on_start(uint16_t status, int32_t content_length, void *ctx) {
+    HTTP_DownloadWorker *worker = (HTTP_DownloadWorker *)ctx;
+    HTTP_Download *download = worker->download;
+
+    if (!download->running) {
+        return;
+    }
+    // 200 would be the whole resource; only acceptable when that is what was asked
+    uint32_t expected = range_length(download, worker->range) - worker->resume_offset;
+    worker->accepted = (status == 206 ||
+                        (status == 200 && download->range_count == 1 && worker->resume_offset == 0)) &&
+                       (content_length < 0 || (uint32_t)content_length == expected);
+
+    // The session resends a request whose connection dropped mid-response;
+    // skip what the earlier attempt already delivered
+    worker->skip = range_received(download, worker) - worker->resume_offset;
+    if (worker->skip > 0) {
+        download->stats.retries++;
+    }
+}
+
+static void worker_on_body(const uint8_t *data, uint16_t len, void *ctx) {
+    HTTP_DownloadWorker *worker = (HTTP_DownloadWorker *)ctx;
+    HTTP_Download *download = worker->download;
+
+    if (!download->running || !worker->accepted) {
+        return;
+    }
+    if (worker->skip > 0) {
+        uint16_t n = (len < worker->skip) ? len : (uint16_t)worker->skip;
+        worker->skip -= n;
+        data += n;
+        len -= n;
+    }
+
+    if (worker->range == download->deliver_range) {
+        uint32_t room = range_length(download, worker->range) - download->deliver_received;
+        deliver(download, data, (len < room) ? len : room);
+        return;
+    }
+
+    HTTP_DownloadSlot *slot = find_slot(download, worker->range);
+    if (slot == NULL) {
+        return;
+    }
+    uint32_t room = range_length(download, worker->range) - slot->received;
+    uint16_t n = (len < room) ? len : (uint16_t)room;
+    memcpy(slot_data(download, slot) + slot->received, data, n);
+    slot->received += n;
+    download->stats.buffered_bytes += n;
+}
+
+static bool submit_range(HTTP_DownloadWorker *worker) {
+    HTTP_Download *download = worker->download;
+    uint32_t first = range_start(download, worker->range) + worker->resume_offset;
+    uint32_t last = range_start(download, worker->range) + range_length(download, worker->range) - 1;
+
+    snprintf(worker->range_header, sizeof(worker->range_header), "Range: bytes=%lu-%lu\r\n",
+             (unsigned long)first, (unsigned long)last);
+
+    HTTP_SessionRequest request = {
+        .method = HTTP_METHOD_GET,
+        .path = download->config.path,
+        .headers = worker->range_header,
+        .handlers = { worker_on_start, worker_on_body, worker_on_complete, worker },
+    };
+
+    worker->accepted = false;
+    worker->attempts++;
+    worker->busy = HTTP_SessionSubmit(&worker->session, &request);
+    return worker->busy;
+}
+
+static void worker_on_complete(AT_Result result, uint32_t body_length, void *ctx) {
+    HTTP_DownloadWorker *worker = (HTTP_DownloadWorker *)ctx;
+    HTTP_Download *download = worker->download;
+    (void)result;
+    (void)body_length;
+
+    worker->busy = false;
+    if (!download->running) {
+        return;
+    }
+
+    // The range is done once all its bytes are in, whatever the result. A failed
+    // connect, a rejected status (its body never reaches the sink), a dropped
+    // connection or a short body are all resumed from the first missing byte.
+    uint32_t have = range_received(download, worker);
+    if (have < range_length(download, worker->range)) {
+        if (worker->attempts >= HTTP_DOWNLOAD_MAX_ATTEMPTS) {
+            finish(download, AT_RESULT_ERROR);
+            return;
+        }
+        worker->resume_offset = have;
+        download->stats.retries++;
+        if (!submit_range(worker)) {
+            finish(download, AT_RESULT_ERROR);
+        }
+        return;
+    }
+
+    download->stats.ranges++;
+    if (worker->range == download->deliver_range) {
+        advance(download);
+    }
+    download_kick(download);
+}
+
+static void start_ranges(HTTP_Download *download) {
+    uint32_t size = download->config.range_size;
+    uint32_t slots = download->config.reorder_size / size;
+    uint32_t ahead = download->config.links - 1u;
+
+    download->range_count = (download->config.length + size - 1) / size;
+    download->slot_count = (uint8_t)((slots < ahead) ? slots : ahead);
+    if (download->range_count == 0) {
+        finish(download, AT_RESULT_OK);
+        return;
+    }
+    download_kick(download);
+}
+
+static void probe_on_start(uint16_t status, int32_t content_length, void *ctx) {
+    HTTP_Download *download = ((HTTP_DownloadWorker *)ctx)->download;
+
+    if (status == 200 && content_length >= 0) {
+        download->config.length = (uint32_t)content_length;
+        download->probing = false;
+    }
+}
+
+static void probe_on_complete(AT_Result result, uint32_t body_length, void *ctx) {
+    HTTP_Download *download = ((HTTP_DownloadWorker *)ctx)->download;
+    (void)body_length;
+
+    download->workers[0].busy = false;
+    if (!download->running) {
+        return;
+    }
+    if (result != AT_RESULT_OK || download->probing) {
+        finish(download, AT_RESULT_ERROR);
+        return;
+    }
+    start_ranges(download);
+}
+
+// Hand the next range to every idle link, as far as the reorder buffer allows
+static void download_kick(HTTP_Download *download) {
+    for (uint8_t i = 0; i < download->config.links && download->running; i++) {
+        HTTP_DownloadWorker *worker = &download->workers[i];
+
+        if (worker->busy || download->next_range >= download->range_count) {
+            continue;
+        }
+        uint32_t range = download->next_range;
+        if (range != download->deliver_range && alloc_slot(download, range) == NULL) {
+            return;
+        }
+
+        worker->range = range;
+        worker->resume_offset = 0;
+        worker->attempts = 0;
+        download->next_range++;
+        if (!submit_range(worker)) {
+            finish(download, AT_RESULT_ERROR);
+        }
+    }
+}
+
+bool HTTP_DownloadStart(HTTP_Download *download, const HTTP_DownloadConfig *config) {
+    if (config->path == NULL || config->sink == NULL || config->range_size == 0 ||
+        config->links == 0 || config->links > HTTP_DOWNLOAD_MAX_LINKS ||
+        config->first_link + config->links > TCP_MAX_LINKS ||
+        (config->reorder_size > 0 && config->reorder_buffer == NULL)) {
+        return false;
+    }
+
+    memset(download, 0, sizeof(*download));
+    download->config = *config;
+    download->running = true;
+    download->start_tick = HAL_GetTick();
+
+    for (uint8_t i = 0; i < config->links; i++) {
+        HTTP_DownloadWorker *worker = &download->workers[i];
+        worker->download = download;
+        HTTP_SessionInit(&worker->session, config->first_link + i, config->proto,
+                         config->host, config->port, false);
+    }
+
+    if (config->length > 0) {
+        start_ranges(download);
+        return true;
+    }
+
+    // Unknown size: ask for it on the first link, which is then reused for a range
+    HTTP_DownloadWorker *worker = &download->workers[0];
+    HTTP_SessionRequest request = {
+        .method = HTTP_METHOD_HEAD,
+        .path = config->path,
+        .handlers = { probe_on_start, NULL, probe_on_complete, worker },
+    };
+    download->probing = true;
+    worker->busy = HTTP_SessionSubmit(&worker->session, &request);
+    if (!worker->busy) {
+        download->running = false;
+        return false;
+    }
+    return true;
+}
+
+void HTTP_DownloadPoll(HTTP_Download *download) {
+    for (uint8_t i = 0; i < download->config.links; i++) {
+        HTTP_SessionPoll(&download->workers[i].session);
+    }
+    if (download->running && !download->probing) {
+        download_kick(download);
+    }
+}
+
+bool HTTP_DownloadIsRunning(const HTTP_Download *download) {
+    return download->running;
+}
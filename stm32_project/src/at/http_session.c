@@ -0,0 +1,451 @@
+/* stm32_project/src/at/http_session.c */
+
+#include "at/http_session.h"
+#include "stm32f0xx_hal.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// An idempotent request written on a connection that then closed is retried once
+#define HTTP_SESSION_MAX_ATTEMPTS 2
+
+enum {
+    PARSE_STATUS,
+    PARSE_HEADERS,
+    PARSE_BODY,
+    PARSE_BODY_TO_CLOSE,
+    PARSE_CHUNK_SIZE,
+    PARSE_CHUNK_DATA,
+    PARSE_CHUNK_END,
+    PARSE_TRAILER,
+};
+
+static const char *const method_names[] = {
+    [HTTP_METHOD_HEAD] = "HEAD",
+    [HTTP_METHOD_GET] = "GET",
+    [HTTP_METHOD_POST] = "POST",
+    [HTTP_METHOD_PUT] = "PUT",
+    [HTTP_METHOD_DELETE] = "DELETE",
+};
+
+static void session_kick(HTTP_Session *session);
+
+static HTTP_SessionRequest *request_at(HTTP_Session *session, uint8_t index) {
+    return &session->queue[(session->head + index) % HTTP_SESSION_QUEUE_SIZE];
+}
+
+static bool is_idempotent(HTTP_Method method) {
+    return method == HTTP_METHOD_GET || method == HTTP_METHOD_HEAD;
+}
+
+// Case-insensitive "Name:" match; returns the value with leading spaces skipped
+static const char *header_value(const char *line, const char *name) {
+    while (*name) {
+        if (tolower((unsigned char)*line++) != *name++) {
+            return NULL;
+        }
+    }
+    while (*line == ' ') {
+        line++;
+    }
+    return line;
+}
+
+static bool contains_token(const char *value, const char *token) {
+    size_t n = strlen(token);
+    for (; *value; value++) {
+        size_t i = 0;
+        while (i < n && tolower((unsigned char)value[i]) == token[i]) {
+            i++;
+        }
+        if (i == n) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void reset_parser(HTTP_Session *session) {
+    session->parse_state = PARSE_STATUS;
+    session->line_length = 0;
+    session->status = 0;
+    session->content_length = -1;
+    session->remaining = 0;
+    session->body_received = 0;
+    session->chunked = false;
+    session->server_close = false;
+}
+
+static void finish_request(HTTP_Session *session, AT_Result result) {
+    HTTP_SessionRequest done = *request_at(session, 0);
+    uint32_t latency = HAL_GetTick() - done.submit_tick;
+
+    session->head = (session->head + 1) % HTTP_SESSION_QUEUE_SIZE;
+    session->count--;
+    if (session->written > 0) {
+        session->written--;
+    }
+
+    if (result == AT_RESULT_OK) {
+        session->stats.requests++;
+        session->stats.last_latency_ms = latency;
+        session->stats.total_latency_ms += latency;
+        if (latency > session->stats.max_latency_ms) {
+            session->stats.max_latency_ms = latency;
+        }
+    }
+    if (done.handlers.on_complete) {
+        done.handlers.on_complete(result, session->body_received, done.handlers.ctx);
+    }
+}
+
+static void finish_response(HTTP_Session *session) {
+    bool close = session->server_close;
+
+    finish_request(session, AT_RESULT_OK);
+    reset_parser(session);
+
+    if (close) {
+        session->persistent = false;
+        TCP_Close(session->link);
+    } else {
+        session->persistent = true;
+        session_kick(session);
+    }
+}
+
+static void headers_complete(HTTP_Session *session) {
+    const HTTP_SessionRequest *request = request_at(session, 0);
+
+    // Interim 1xx responses are followed by the real one
+    if (session->status >= 100 && session->status < 200) {
+        reset_parser(session);
+        return;
+    }
+
+    if (request->handlers.on_start) {
+        request->handlers.on_start(session->status, session->content_length, request->handlers.ctx);
+    }
+
+    if (request->method == HTTP_METHOD_HEAD || session->status == 204 || session->status == 304) {
+        finish_response(session);
+    } else if (session->chunked) {
+        session->parse_state = PARSE_CHUNK_SIZE;
+    } else if (session->content_length >= 0) {
+        session->remaining = (uint32_t)session->content_length;
+        session->parse_state = PARSE_BODY;
+        if (session->remaining == 0) {
+            finish_response(session);
+        }
+    } else {
+        session->server_close = true;
+        session->parse_state = PARSE_BODY_TO_CLOSE;
+    }
+}
+
+static void process_line(HTTP_Session *session) {
+    const char *line = session->line;
+    const char *value;
+
+    switch (session->parse_state) {
+    case PARSE_STATUS:
+        if (strncmp(line, "HTTP/1.", 7) == 0) {
+            session->status = (uint16_t)strtoul(line + 9, NULL, 10);
+            session->server_close = (line[7] == '0');
+            session->parse_state = PARSE_HEADERS;
+        }
+        break;
+
+    case PARSE_HEADERS:
+        if (session->line_length == 0) {
+            headers_complete(session);
+        } else if ((value = header_value(line, "content-length:")) != NULL) {
+            session->content_length = (int32_t)strtol(value, NULL, 10);
+        } else if ((value = header_value(line, "transfer-encoding:")) != NULL) {
+            session->chunked = contains_token(value, "chunked");
+        } else if ((value = header_value(line, "connection:")) != NULL) {
+            if (contains_token(value, "close")) {
+                session->server_close = true;
+            } else if (contains_token(value, "keep-alive")) {
+                session->server_close = false;
+            }
+        }
+        break;
+
+    case PARSE_CHUNK_SIZE:
+        session->remaining = strtoul(line, NULL, 16);
+        session->parse_state = (session->remaining == 0) ? PARSE_TRAILER : PARSE_CHUNK_DATA;
+        break;
+
+    case PARSE_CHUNK_END:
+        session->parse_state = PARSE_CHUNK_SIZE;
+        break;
+
+    case PARSE_TRAILER:
+        if (session->line_length == 0) {
+            finish_response(session);
+        }
+        break;
+
+    default:
+        break;
+    }
+}
+
+static void deliver_body(HTTP_Session *session, const uint8_t *data, uint16_t len) {
+    const HTTP_SessionRequest *request = request_at(session, 0);
+
+    session->body_received += len;
+    if (request->handlers.on_body) {
+        request->handlers.on_body(data, len, request->handlers.ctx);
+    }
+}
+
+static void session_on_data(uint8_t link, const uint8_t *data, uint16_t len, void *ctx) {
+    (void)link;
+    HTTP_Session *session = (HTTP_Session *)ctx;
+
+    while (len > 0) {
+        // Nothing outstanding: stray bytes from a response we gave up on
+        if (session->written == 0) {
+            return;
+        }
+
+        uint8_t state = session->parse_state;
+        if (state == PARSE_BODY || state == PARSE_CHUNK_DATA || state == PARSE_BODY_TO_CLOSE) {
+            uint16_t n = len;
+            if (state != PARSE_BODY_TO_CLOSE && session->remaining < n) {
+                n = (uint16_t)session->remaining;
+            }
+            deliver_body(session, data, n);
+            data += n;
+            len -= n;
+            if (state == PARSE_BODY_TO_CLOSE) {
+                continue;
+            }
+
+            session->remaining -= n;
+            if (session->remaining == 0) {
+                if (state == PARSE_BODY) {
+                    finish_response(session);
+                } else {
+                    session->parse_state = PARSE_CHUNK_END;
+                }
+            }
+            continue;
+        }
+
+        char c = (char)*data++;
+        len--;
+        if (c == '\n') {
+            if (session->line_length > 0 && session->line[session->line_length - 1] == '\r') {
+                session->line_length--;
+            }
+            session->line[session->line_length] = '\0';
+            process_line(session);
+            session->line_length = 0;
+        } else if (session->line_length < HTTP_SESSION_LINE_SIZE - 1) {
+            session->line[session->line_length++] = c;
+        }
+    }
+}
+
+static void session_on_connect(uint8_t link, AT_Result result, void *ctx) {
+    (void)link;
+    HTTP_Session *session = (HTTP_Session *)ctx;
+
+    if (result != AT_RESULT_OK) {
+        // Every queued request targets this endpoint; fail them all
+        while (session->count > 0) {
+            finish_request(session, result);
+        }
+        return;
+    }
+
+    session->fresh_connection = true;
+    session_kick(session);
+}
+
+static void session_on_closed(uint8_t link, void *ctx) {
+    (void)link;
+    HTTP_Session *session = (HTTP_Session *)ctx;
+
+    if (session->parse_state == PARSE_BODY_TO_CLOSE && session->written > 0) {
+        finish_request(session, AT_RESULT_OK);
+    }
+
+    // Requests already written never got an answer. GET/HEAD are resent on a new
+    // connection; anything else the server may have acted on already, so it fails.
+    // Only the head can be non-idempotent: nothing else is pipelined behind it.
+    while (session->written > 0) {
+        const HTTP_SessionRequest *request = request_at(session, 0);
+        if (is_idempotent(request->method) && request->attempts < HTTP_SESSION_MAX_ATTEMPTS) {
+            break;
+        }
+        finish_request(session, AT_RESULT_ERROR);
+    }
+    session->written = 0;
+    session->persistent = false;
+    reset_parser(session);
+
+    if (session->close_requested && session->count == 0) {
+        session->close_requested = false;
+        return;
+    }
+    session_kick(session);
+}
+
+static uint16_t session_source(const uint8_t **data, uint16_t max, void *ctx) {
+    HTTP_Session *session = (HTTP_Session *)ctx;
+    const HTTP_SessionRequest *request = session->writing_request;
+
+    if (session->header_offset < session->header_length) {
+        uint16_t n = session->header_length - session->header_offset;
+        *data = (const uint8_t *)session->header + session->header_offset;
+        n = (n < max) ? n : max;
+        session->header_offset += n;
+        return n;
+    }
+    return request->body_source(data, max, request->body_ctx);
+}
+
+static void session_write_done(AT_Result result, void *ctx) {
+    HTTP_Session *session = (HTTP_Session *)ctx;
+
+    session->writing = false;
+    if (result == AT_RESULT_OK) {
+        session->written++;
+        session_kick(session);
+    } else {
+        TCP_Close(session->link);
+    }
+}
+
+static void start_write(HTTP_Session *session) {
+    HTTP_SessionRequest *request = request_at(session, session->written);
+    int n;
+
+    if (request->attempts >= HTTP_SESSION_MAX_ATTEMPTS) {
+        // finish_request() completes the head; one queued behind it waits its turn
+        if (session->written == 0) {
+            finish_request(session, AT_RESULT_ERROR);
+        }
+        return;
+    }
+
+    if (request->body_length > 0) {
+        n = snprintf(session->header, sizeof(session->header),
+                     "%s %s HTTP/1.1\r\nHost: %s\r\nContent-Length: %lu\r\n%s\r\n",
+                     method_names[request->method], request->path, session->host,
+                     (unsigned long)request->body_length, request->headers ? request->headers : "");
+    } else {
+        n = snprintf(session->header, sizeof(session->header), "%s %s HTTP/1.1\r\nHost: %s\r\n%s\r\n",
+                     method_names[request->method], request->path, session->host,
+                     request->headers ? request->headers : "");
+    }
+    if (n < 0 || n >= (int)sizeof(session->header)) {
+        // Can only be the head request: nothing is in flight when it is rejected
+        if (session->written == 0) {
+            finish_request(session, AT_RESULT_ERROR);
+        }
+        return;
+    }
+
+    session->header_length = (uint16_t)n;
+    session->header_offset = 0;
+    session->writing_request = request;
+    if (!TCP_Send(session->link, (uint32_t)n + request->body_length, session_source, session,
+                  session_write_done, session)) {
+        return;
+    }
+
+    session->writing = true;
+    request->attempts++;
+    if (session->fresh_connection) {
+        session->fresh_connection = false;
+    } else {
+        session->stats.reused++;
+    }
+    if (session->written > 0) {
+        session->stats.pipelined++;
+    }
+}
+
+static void session_kick(HTTP_Session *session) {
+    switch (TCP_GetState(session->link)) {
+    case TCP_LINK_CLOSED:
+        if (session->count > 0) {
+            TCP_Handlers handlers = {
+                .on_connect = session_on_connect,
+                .on_data = session_on_data,
+                .on_closed = session_on_closed,
+                .ctx = session,
+            };
+            if (TCP_Open(session->link, session->proto, session->host, session->port, &handlers)) {
+                session->stats.connects++;
+            }
+        }
+        break;
+
+    case TCP_LINK_CONNECTED:
+        if (session->writing || session->written >= session->count) {
+            if (session->close_requested && session->count == 0) {
+                TCP_Close(session->link);
+            }
+            break;
+        }
+        // Pipeline only idempotent requests, and only on a proven keep-alive connection
+        if (session->written > 0 &&
+            !(session->pipelining && session->persistent &&
+              is_idempotent(request_at(session, session->written)->method))) {
+            break;
+        }
+        start_write(session);
+        break;
+
+    default:
+        break;
+    }
+}
+
+void HTTP_SessionInit(HTTP_Session *session, uint8_t link, TCP_Protocol proto,
+                      const char *host, uint16_t port, bool pipelining) {
+    memset(session, 0, sizeof(*session));
+    session->link = link;
+    session->proto = proto;
+    session->host = host;
+    session->port = port;
+    session->pipelining = pipelining;
+    reset_parser(session);
+}
+
+bool HTTP_SessionSubmit(HTTP_Session *session, const HTTP_SessionRequest *request) {
+    if (session->count >= HTTP_SESSION_QUEUE_SIZE || request->path == NULL ||
+        (request->body_length > 0 && request->body_source == NULL)) {
+        return false;
+    }
+
+    HTTP_SessionRequest *slot = request_at(session, session->count);
+    *slot = *request;
+    slot->submit_tick = HAL_GetTick();
+    slot->attempts = 0;
+    session->count++;
+    session->close_requested = false;
+
+    session_kick(session);
+    return true;
+}
+
+void HTTP_SessionPoll(HTTP_Session *session) {
+    session_kick(session);
+}
+
+void HTTP_SessionClose(HTTP_Session *session) {
+    session->close_requested = true;
+    session_kick(session);
+}
+
+bool HTTP_SessionIsIdle(const HTTP_Session *session) {
+    return session->count == 0;
+}
@@ -0,0 +1,146 @@
+/* stm32_project/src/at/latency.c */
+
+#include "at/latency.h"
+#include "hal/timestamp.h"
+#include <stdio.h>
+#include <string.h>
+
+#define FIRST_OCTAVE 7          // Bucket 0 holds everything below 2^7 us
+
+static LATENCY_Class classes[LATENCY_CLASSES];
+static uint8_t class_count = 0;
+static uint32_t start_us = 0;
+
+// Bucket b >= 1 starts at 2^(7 + (b-1)/2), times 1.5 for the upper half
+static uint32_t bucket_floor(uint8_t bucket) {
+    if (bucket == 0) {
+        return 0;
+    }
+    uint32_t octave = 1u << (FIRST_OCTAVE + (bucket - 1) / 2);
+    return ((bucket - 1) % 2) ? octave + octave / 2 : octave;
+}
+
+static uint8_t bucket_of(uint32_t us) {
+    if (us < (1u << FIRST_OCTAVE)) {
+        return 0;
+    }
+
+    uint8_t octave = 31;
+    while (!(us & (1u << octave))) {
+        octave--;
+    }
+    uint8_t half = (us >> (octave - 1)) & 1;
+    uint32_t bucket = 1 + (octave - FIRST_OCTAVE) * 2 + half;
+    return (bucket < LATENCY_BUCKETS) ? (uint8_t)bucket : LATENCY_BUCKETS - 1;
+}
+
+// "AT+CIPSEND=0,5\r\n" -> "AT+CIPSEND"
+static LATENCY_Class *class_of(const char *command) {
+    char name[LATENCY_CLASS_SIZE];
+    uint8_t n = 0;
+
+    while (command[n] != '\0' && command[n] != '=' && command[n] != '?' &&
+           command[n] != '\r' && command[n] != '\n' && n < LATENCY_CLASS_SIZE - 1) {
+        name[n] = command[n];
+        n++;
+    }
+    name[n] = '\0';
+
+    for (uint8_t i = 0; i < class_count; i++) {
+        if (strcmp(classes[i].name, name) == 0) {
+            return &classes[i];
+        }
+    }
+    if (class_count < LATENCY_CLASSES - 1) {
+        LATENCY_Class *latency = &classes[class_count++];
+        memcpy(latency->name, name, n + 1);
+        return latency;
+    }
+
+    LATENCY_Class *other = &classes[LATENCY_CLASSES - 1];
+    if (class_count < LATENCY_CLASSES) {
+        class_count = LATENCY_CLASSES;
+        strcpy(other->name, "other");
+    }
+    return other;
+}
+
+static void command_event(const char *command, bool finished, AT_Result result, void *ctx) {
+    (void)ctx;
+
+    if (!finished) {
+        start_us = timestamp_us();
+        return;
+    }
+
+    LATENCY_Class *latency = class_of(command);
+    if (result == AT_RESULT_TIMEOUT) {
+        latency->timeouts++;
+        return;
+    }
+
+    uint32_t elapsed = timestamp_us() - start_us;
+    uint16_t *bucket = &latency->buckets[bucket_of(elapsed)];
+    if (*bucket < UINT16_MAX) {
+        (*bucket)++;
+    }
+    latency->count++;
+    if (result != AT_RESULT_OK) {
+        latency->errors++;
+    }
+    if (elapsed > latency->max_us) {
+        latency->max_us = elapsed;
+    }
+}
+
+void LATENCY_Init(void) {
+    LATENCY_Reset();
+    AT_SetCommandObserver(command_event, NULL);
+}
+
+void LATENCY_Reset(void) {
+    memset(classes, 0, sizeof(classes));
+    class_count = 0;
+}
+
+const LATENCY_Class *LATENCY_GetClass(uint8_t index) {
+    return (index < class_count) ? &classes[index] : NULL;
+}
+
+uint32_t LATENCY_Percentile(const LATENCY_Class *latency, uint8_t percent) {
+    uint32_t total = 0;
+    for (uint8_t i = 0; i < LATENCY_BUCKETS; i++) {
+        total += latency->buckets[i];
+    }
+    if (total == 0) {
+        return 0;
+    }
+
+    // Rank of the sample at the percentile, rounded up
+    uint32_t rank = (total * percent + 99) / 100;
+    uint32_t seen = 0;
+    for (uint8_t i = 0; i < LATENCY_BUCKETS - 1; i++) {
+        seen += latency->buckets[i];
+        if (seen >= rank) {
+            uint32_t edge = bucket_floor(i + 1);
+            return (edge < latency->max_us) ? edge : latency->max_us;
+        }
+    }
+    return latency->max_us;
+}
+
+bool LATENCY_ReportLine(uint8_t *cursor, char *line, uint16_t size) {
+    if (*cursor >= class_count) {
+        return false;
+    }
+
+    const LATENCY_Class *latency = &classes[(*cursor)++];
+    snprintf(line, size, "lat %s n %lu p50 %lu p90 %lu p99 %lu max %lu err %lu tmo %lu\r\n",
+             latency->name, (unsigned long)latency->count,
+             (unsigned long)LATENCY_Percentile(latency, 50),
+             (unsigned long)LATENCY_Percentile(latency, 90),
+             (unsigned long)LATENCY_Percentile(latency, 99),
+             (unsigned long)latency->max_us,
+             (unsigned long)latency->errors, (unsigned long)latency->timeouts);
+    return true;
+}
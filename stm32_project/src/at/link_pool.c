@@ -0,0 +1,236 @@
+/* stm32_project/src/at/link_pool.c */
+
+#include "at/link_pool.h"
+#include "stm32f0xx_hal.h"
+#include <stdio.h>
+#include <string.h>
+
+#define POOL_COMMAND_SIZE 40
+#define POOL_TIMEOUT_MS   5000
+
+typedef struct {
+    TCP_Protocol proto;
+    char host[POOL_HOST_SIZE];
+    uint16_t port;
+    bool in_use;
+    bool ssl_configured;
+    bool connect_after_close;   // Evicted: connect to the new endpoint once closed
+    uint32_t connect_tick;
+    uint32_t last_used_tick;
+    TCP_Handlers lease;
+    POOL_ReadyCallback ready;
+    void *ready_ctx;
+    char command[POOL_COMMAND_SIZE];
+} pool_link_t;
+
+static pool_link_t pool[TCP_MAX_LINKS];
+static POOL_Config pool_config;
+static POOL_Stats stats;
+
+static bool pool_connect(uint8_t link, pool_link_t *entry);
+
+static void pool_on_connect(uint8_t link, AT_Result result, void *ctx) {
+    pool_link_t *entry = (pool_link_t *)ctx;
+
+    if (result == AT_RESULT_OK && entry->proto == TCP_PROTO_SSL) {
+        stats.handshakes++;
+        stats.handshake_ms += HAL_GetTick() - entry->connect_tick;
+    }
+    if (result != AT_RESULT_OK) {
+        entry->in_use = false;
+    }
+    if (entry->ready) {
+        entry->ready((result == AT_RESULT_OK) ? (int8_t)link : -1, result, entry->ready_ctx);
+    }
+}
+
+static void pool_on_data(uint8_t link, const uint8_t *data, uint16_t len, void *ctx) {
+    pool_link_t *entry = (pool_link_t *)ctx;
+
+    if (entry->in_use && entry->lease.on_data) {
+        entry->lease.on_data(link, data, len, entry->lease.ctx);
+    }
+}
+
+static void pool_on_closed(uint8_t link, void *ctx) {
+    pool_link_t *entry = (pool_link_t *)ctx;
+
+    // The close we asked for to make room: the lease belongs to the new endpoint
+    if (entry->connect_after_close) {
+        entry->connect_after_close = false;
+        if (!pool_connect(link, entry)) {
+            pool_on_connect(link, AT_RESULT_ERROR, entry);
+        }
+        return;
+    }
+
+    if (entry->in_use && entry->lease.on_closed) {
+        entry->lease.on_closed(link, entry->lease.ctx);
+    }
+}
+
+static bool pool_open(uint8_t link, pool_link_t *entry) {
+    TCP_Handlers handlers = {
+        .on_connect = pool_on_connect,
+        .on_data = pool_on_data,
+        .on_closed = pool_on_closed,
+        .ctx = entry,
+    };
+    TCP_SetKeepAlive(link, pool_config.keep_alive_s);
+    entry->connect_tick = HAL_GetTick();
+    if (!TCP_Open(link, entry->proto, entry->host, entry->port, &handlers)) {
+        return false;
+    }
+    stats.connects++;
+    return true;
+}
+
+// A link whose SSL config the ESP rejected would connect with the wrong auth mode
+static void ssl_config_done(AT_Result result, void *ctx) {
+    pool_link_t *entry = (pool_link_t *)ctx;
+    uint8_t link = (uint8_t)(entry - pool);
+
+    entry->ssl_configured = (result == AT_RESULT_OK);
+    if (!entry->ssl_configured) {
+        pool_on_connect(link, result, entry);
+    } else if (!pool_open(link, entry)) {
+        pool_on_connect(link, AT_RESULT_ERROR, entry);
+    }
+}
+
+static bool pool_connect(uint8_t link, pool_link_t *entry) {
+    // The ESP keeps the SSL client config per link id until it restarts;
+    // the connect follows once it is accepted
+    if (entry->proto == TCP_PROTO_SSL && !entry->ssl_configured) {
+        snprintf(entry->command, sizeof(entry->command), "AT+CIPSSLCCONF=%u,%u,%u,%u\r\n",
+                 (unsigned)link, (unsigned)pool_config.ssl_auth_mode,
+                 (unsigned)pool_config.ssl_pki_number, (unsigned)pool_config.ssl_ca_number);
+        return AT_SendCommand(entry->command, POOL_TIMEOUT_MS, ssl_config_done, entry);
+    }
+    return pool_open(link, entry);
+}
+
+static void pool_lease(pool_link_t *entry, const TCP_Handlers *handlers, POOL_ReadyCallback ready, void *ctx) {
+    entry->in_use = true;
+    entry->last_used_tick = HAL_GetTick();
+    entry->ready = ready;
+    entry->ready_ctx = ctx;
+    if (handlers) {
+        entry->lease = *handlers;
+    } else {
+        memset(&entry->lease, 0, sizeof(entry->lease));
+    }
+}
+
+void POOL_Init(const POOL_Config *config) {
+    memset(pool, 0, sizeof(pool));
+    memset(&stats, 0, sizeof(stats));
+    if (config) {
+        pool_config = *config;
+    } else {
+        memset(&pool_config, 0, sizeof(pool_config));
+    }
+}
+
+static bool same_endpoint(const pool_link_t *entry, TCP_Protocol proto, const char *host, uint16_t port) {
+    return entry->host[0] != '\0' && entry->proto == proto && entry->port == port &&
+           strcmp(entry->host, host) == 0;
+}
+
+// The SSL client config stays with the link id, so it survives a new endpoint
+static void set_endpoint(pool_link_t *entry, TCP_Protocol proto, const char *host, uint16_t port) {
+    entry->proto = proto;
+    strcpy(entry->host, host);
+    entry->port = port;
+}
+
+bool POOL_Acquire(TCP_Protocol proto, const char *host, uint16_t port,
+                  const TCP_Handlers *handlers, POOL_ReadyCallback ready, void *ctx) {
+    if (host == NULL || strlen(host) >= POOL_HOST_SIZE) {
+        return false;
+    }
+
+    int8_t reconnect = -1;
+    int8_t closed = -1;
+    int8_t victim = -1;
+    // Ages rather than ticks, so the least recently used survives the tick wrap
+    uint32_t now = HAL_GetTick();
+    for (uint8_t i = 0; i < TCP_MAX_LINKS; i++) {
+        pool_link_t *entry = &pool[i];
+        if (entry->in_use) {
+            continue;
+        }
+
+        TCP_LinkState state = TCP_GetState(i);
+        bool same = same_endpoint(entry, proto, host, port);
+
+        // A warm link to the same endpoint skips the handshake entirely
+        if (state == TCP_LINK_CONNECTED && same) {
+            pool_lease(entry, handlers, ready, ctx);
+            stats.reuses++;
+            if (stats.handshakes > 0) {
+                stats.time_saved_ms += stats.handshake_ms / stats.handshakes;
+            }
+            if (ready) {
+                ready((int8_t)i, AT_RESULT_OK, ctx);
+            }
+            return true;
+        }
+
+        if (state == TCP_LINK_CLOSED) {
+            if (same) {
+                reconnect = (int8_t)i;
+            } else if (closed < 0 || now - entry->last_used_tick > now - pool[closed].last_used_tick) {
+                closed = (int8_t)i;
+            }
+        } else if (state == TCP_LINK_CONNECTED &&
+                   (victim < 0 || now - entry->last_used_tick > now - pool[victim].last_used_tick)) {
+            victim = (int8_t)i;
+        }
+    }
+
+    int8_t link = (reconnect >= 0) ? reconnect : closed;
+    if (link >= 0) {
+        pool_link_t *entry = &pool[link];
+        if (reconnect >= 0) {
+            stats.reconnects++;
+        } else {
+            set_endpoint(entry, proto, host, port);
+        }
+        pool_lease(entry, handlers, ready, ctx);
+        if (!pool_connect((uint8_t)link, entry)) {
+            entry->in_use = false;
+            return false;
+        }
+        return true;
+    }
+
+    if (victim >= 0) {
+        pool_link_t *entry = &pool[victim];
+        set_endpoint(entry, proto, host, port);
+        pool_lease(entry, handlers, ready, ctx);
+        entry->connect_after_close = true;
+        stats.evictions++;
+        TCP_Close((uint8_t)victim);
+        return true;
+    }
+    return false;
+}
+
+void POOL_Release(uint8_t link) {
+    if (link < TCP_MAX_LINKS) {
+        pool[link].in_use = false;
+        pool[link].last_used_tick = HAL_GetTick();
+    }
+}
+
+void POOL_Discard(uint8_t link) {
+    if (link < TCP_MAX_LINKS) {
+        pool[link].in_use = false;
+        TCP_Close(link);
+    }
+}
+
+const POOL_Stats *POOL_GetStats(void) {
+    return &stats;
+}
@@ -0,0 +1,633 @@
+/* stm32_project/src/at/mqtt.c */
+
+#include "at/mqtt.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MQTT_COMMAND_SIZE  128
+#define MQTT_COMMAND_SLOTS 3
+#define MQTT_TIMEOUT_MS    10000
+#define MQTT_LINK_ID       0
+
+typedef struct {
+    const char *filter;
+    uint8_t qos;
+    MQTT_MessageHandler handler;
+    uint8_t *buffer;
+    uint16_t buffer_size;
+    void *ctx;
+} mqtt_subscription_t;
+
+// Commands stay in their slot until the AT core reports the final result
+typedef struct {
+    char text[MQTT_COMMAND_SIZE];
+    bool busy;
+    bool is_publish;
+    AT_CommandCallback done;
+    void *ctx;
+    const uint8_t *payload;     // MQTT_PublishBuffer() span not yet sent
+    uint32_t payload_left;
+} mqtt_command_t;
+
+static mqtt_subscription_t subscriptions[MQTT_MAX_SUBSCRIPTIONS];
+static uint8_t subscription_count = 0;
+static mqtt_command_t commands[MQTT_COMMAND_SLOTS];
+static bool mqtt_connected = false;
+static uint8_t resubscribe_next = 0;   // Filters [0, next) are subscribed
+static MQTT_ConnectionCallback connection_callback = NULL;
+static void *connection_ctx = NULL;
+static MQTT_Stats stats;
+
+// Offline queue record, followed by the NUL-terminated topic and the payload.
+// Records are contiguous: one that does not fit before the end of the arena
+// starts over at offset 0, leaving a wrap marker (size 0) behind.
+typedef struct {
+    uint16_t size;
+    uint16_t payload_len;
+    uint8_t qos;
+    uint8_t retain;
+    uint8_t acked;
+    uint8_t inflight;           // Handed to the ESP, result not in yet
+    uint8_t attempts;
+} mqtt_record_t;
+
+static uint32_t arena_words[MQTT_QUEUE_ARENA_SIZE / 4];
+static uint8_t *const arena = (uint8_t *)arena_words;
+static uint16_t queue_head = 0;      // Next free offset
+static uint16_t queue_tail = 0;      // Oldest record
+static uint16_t queue_count = 0;
+static uint16_t queue_cursor = 0;    // Next record to hand to the ESP
+static uint16_t queue_sent = 0;      // Records from tail at or before the cursor
+static uint8_t queue_inflight = 0;
+static bool queue_rewind = false;
+
+// Message being received
+static char rx_topic[MQTT_TOPIC_SIZE];
+static const mqtt_subscription_t *rx_subscription = NULL;
+static uint32_t rx_stored = 0;
+static uint32_t rx_remaining = 0;
+
+static mqtt_command_t *command_alloc(void) {
+    for (uint8_t i = 0; i < MQTT_COMMAND_SLOTS; i++) {
+        if (!commands[i].busy) {
+            commands[i].busy = true;
+            commands[i].is_publish = false;
+            commands[i].done = NULL;
+            commands[i].ctx = NULL;
+            return &commands[i];
+        }
+    }
+    return NULL;
+}
+
+static bool send_subscribe(const mqtt_subscription_t *sub);
+static void queue_kick(void);
+
+// Subscribe pending filters as command slots free up
+static void resubscribe_pending(void) {
+    while (mqtt_connected && resubscribe_next < subscription_count &&
+           send_subscribe(&subscriptions[resubscribe_next])) {
+        resubscribe_next++;
+    }
+}
+
+static void command_done(AT_Result result, void *ctx) {
+    mqtt_command_t *cmd = (mqtt_command_t *)ctx;
+    AT_CommandCallback done = cmd->done;
+    void *done_ctx = cmd->ctx;
+
+    if (cmd->is_publish) {
+        if (result == AT_RESULT_OK) {
+            stats.published++;
+        } else {
+            stats.publish_failed++;
+        }
+    }
+    cmd->busy = false;
+    if (done) {
+        done(result, done_ctx);
+    }
+    resubscribe_pending();
+}
+
+static bool command_send_payload(mqtt_command_t *cmd, int length, uint32_t payload_len,
+                                 AT_PayloadSource source, void *source_ctx) {
+    if (length < 0 || length >= MQTT_COMMAND_SIZE ||
+        !AT_SendCommandWithPayload(cmd->text, payload_len, source, source_ctx,
+                                   MQTT_TIMEOUT_MS, command_done, cmd)) {
+        cmd->busy = false;
+        return false;
+    }
+    return true;
+}
+
+static bool command_send(mqtt_command_t *cmd, int length) {
+    return command_send_payload(cmd, length, 0, NULL, NULL);
+}
+
+static uint16_t buffer_source(const uint8_t **data, uint16_t max, void *ctx) {
+    mqtt_command_t *cmd = (mqtt_command_t *)ctx;
+    uint16_t n = (cmd->payload_left < max) ? (uint16_t)cmd->payload_left : max;
+
+    *data = cmd->payload;
+    cmd->payload += n;
+    cmd->payload_left -= n;
+    return n;
+}
+
+// AT+MQTTPUB/AT+MQTTSUB string parameters need '"', ',' and '\' escaped
+static int escape_into(char *dst, size_t size, const uint8_t *src, uint16_t len) {
+    size_t n = 0;
+    for (uint16_t i = 0; i < len; i++) {
+        char c = (char)src[i];
+        if (c == '"' || c == ',' || c == '\\') {
+            if (n + 1 >= size) {
+                return -1;
+            }
+            dst[n++] = '\\';
+        }
+        if (n + 1 >= size) {
+            return -1;
+        }
+        dst[n++] = c;
+    }
+    dst[n] = '\0';
+    return (int)n;
+}
+
+static bool send_subscribe(const mqtt_subscription_t *sub) {
+    mqtt_command_t *cmd = command_alloc();
+    if (cmd == NULL) {
+        return false;
+    }
+    int n = snprintf(cmd->text, sizeof(cmd->text), "AT+MQTTSUB=%d,\"%s\",%u\r\n",
+                     MQTT_LINK_ID, sub->filter, (unsigned)sub->qos);
+    return command_send(cmd, n);
+}
+
+static void set_connected(bool connected) {
+    mqtt_connected = connected;
+    if (connection_callback) {
+        connection_callback(connected, connection_ctx);
+    }
+}
+
+static void message_sink(const uint8_t *data, uint16_t len, void *ctx) {
+    (void)ctx;
+
+    if (rx_subscription) {
+        uint32_t room = rx_subscription->buffer_size - rx_stored;
+        uint32_t n = (len < room) ? len : room;
+        memcpy(rx_subscription->buffer + rx_stored, data, n);
+        rx_stored += n;
+        stats.dropped_bytes += len - n;
+    }
+
+    rx_remaining -= len;
+    if (rx_remaining > 0) {
+        return;
+    }
+
+    if (rx_subscription) {
+        stats.received++;
+        rx_subscription->handler(rx_topic, rx_subscription->buffer, rx_stored, rx_subscription->ctx);
+    }
+}
+
+static const mqtt_subscription_t *find_subscription(const char *topic) {
+    for (uint8_t i = 0; i < subscription_count; i++) {
+        if (MQTT_TopicMatches(subscriptions[i].filter, topic)) {
+            return &subscriptions[i];
+        }
+    }
+    return NULL;
+}
+
+static mqtt_record_t *record_at(uint16_t offset) {
+    if (offset + sizeof(mqtt_record_t) > MQTT_QUEUE_ARENA_SIZE ||
+        ((mqtt_record_t *)(arena + offset))->size == 0) {
+        offset = 0;
+    }
+    return (mqtt_record_t *)(arena + offset);
+}
+
+static uint16_t record_offset(const mqtt_record_t *record) {
+    return (uint16_t)((const uint8_t *)record - arena);
+}
+
+static const char *record_topic(const mqtt_record_t *record) {
+    return (const char *)(record + 1);
+}
+
+static const uint8_t *record_payload(const mqtt_record_t *record) {
+    const char *topic = record_topic(record);
+    return (const uint8_t *)topic + strlen(topic) + 1;
+}
+
+static void queue_pop(void) {
+    mqtt_record_t *record = record_at(queue_tail);
+
+    queue_tail = (uint16_t)((record_offset(record) + record->size) % MQTT_QUEUE_ARENA_SIZE);
+    queue_count--;
+    if (queue_sent > 0) {
+        queue_sent--;
+    }
+    if (queue_count == 0) {
+        queue_head = queue_tail = queue_cursor = 0;
+    }
+}
+
+static void queue_publish_done(AT_Result result, void *ctx);
+
+// Hand records to the ESP while the window has room
+static void queue_kick(void) {
+    if (queue_rewind && queue_inflight == 0) {
+        queue_rewind = false;
+        queue_cursor = queue_tail;
+        queue_sent = 0;
+    }
+
+    while (mqtt_connected && !queue_rewind && queue_inflight < MQTT_QUEUE_WINDOW && queue_sent < queue_count) {
+        mqtt_record_t *record = record_at(queue_cursor);
+        uint16_t next = (uint16_t)((record_offset(record) + record->size) % MQTT_QUEUE_ARENA_SIZE);
+
+        if (!record->acked) {
+            if (!MQTT_PublishBuffer(record_topic(record), record_payload(record), record->payload_len,
+                                    record->qos, record->retain, queue_publish_done, record)) {
+                return;
+            }
+            if (record->attempts++ > 0) {
+                stats.replayed++;
+            }
+            record->inflight = 1;
+            queue_inflight++;
+        }
+        queue_cursor = next;
+        queue_sent++;
+    }
+}
+
+static void queue_publish_done(AT_Result result, void *ctx) {
+    mqtt_record_t *record = (mqtt_record_t *)ctx;
+
+    record->inflight = 0;
+    queue_inflight--;
+    // QoS0 is fire-and-forget; everything else is retried until confirmed
+    if (result == AT_RESULT_OK || record->qos == 0) {
+        record->acked = 1;
+    } else {
+        queue_rewind = true;
+    }
+
+    while (queue_count > 0 && queue_sent > 0 && record_at(queue_tail)->acked) {
+        queue_pop();
+    }
+    queue_kick();
+}
+
+// "+MQTTSUBRECV:<LinkID>,"<topic>",<data_length>," runs each time a ',' arrives;
+// once the header is complete the payload goes straight to the matched buffer.
+static void subrecv_urc(const char *line, void *ctx) {
+    (void)ctx;
+    const char *p = line + strlen("+MQTTSUBRECV:");
+
+    while (*p >= '0' && *p <= '9') {
+        p++;
+    }
+    if (p[0] != ',' || p[1] != '"') {
+        return;
+    }
+
+    const char *topic = p + 2;
+    const char *quote = strchr(topic, '"');
+    if (quote == NULL || quote[1] != ',') {
+        return;
+    }
+
+    char *end;
+    unsigned long len = strtoul(quote + 2, &end, 10);
+    if (end == quote + 2 || end[0] != ',' || end[1] != '\0') {
+        return;
+    }
+
+    size_t topic_length = (size_t)(quote - topic);
+    if (topic_length >= MQTT_TOPIC_SIZE) {
+        topic_length = MQTT_TOPIC_SIZE - 1;
+    }
+    memcpy(rx_topic, topic, topic_length);
+    rx_topic[topic_length] = '\0';
+
+    rx_subscription = find_subscription(rx_topic);
+    if (rx_subscription == NULL) {
+        stats.unmatched++;
+        stats.dropped_bytes += len;
+    }
+    rx_stored = 0;
+    rx_remaining = len;
+
+    if (len == 0) {
+        message_sink(NULL, 0, NULL);
+    } else {
+        AT_BeginRawData(len, message_sink, NULL);
+    }
+}
+
+static void connected_urc(const char *line, void *ctx) {
+    (void)line;
+    (void)ctx;
+
+    resubscribe_next = 0;
+    set_connected(true);
+    resubscribe_pending();
+    queue_kick();
+}
+
+// True while one of our AT+MQTTPUBRAW commands is the one on the wire
+static bool pubraw_in_flight(void) {
+    const char *current = AT_GetCurrentCommand();
+    for (uint8_t i = 0; i < MQTT_COMMAND_SLOTS; i++) {
+        if (commands[i].busy && commands[i].is_publish && current == commands[i].text) {
+            return strncmp(current, "AT+MQTTPUBRAW=", 14) == 0;
+        }
+    }
+    return false;
+}
+
+// Final result of AT+MQTTPUBRAW, reported after the payload has been sent. One
+// arriving late (after a timeout) must not finish an unrelated command.
+static void pub_result_urc(const char *line, void *ctx) {
+    (void)ctx;
+    if (!pubraw_in_flight()) {
+        return;
+    }
+    bool ok = (strcmp(line + strlen("+MQTTPUB:"), "OK") == 0);
+    AT_CompleteCommand(ok ? AT_RESULT_OK : AT_RESULT_SEND_FAIL);
+}
+
+static void disconnected_urc(const char *line, void *ctx) {
+    (void)line;
+    (void)ctx;
+    resubscribe_next = 0;
+    queue_rewind = true;
+    set_connected(false);
+    queue_kick();
+}
+
+void MQTT_Init(void) {
+    memset(commands, 0, sizeof(commands));
+    memset(&stats, 0, sizeof(stats));
+    subscription_count = 0;
+    resubscribe_next = 0;
+    mqtt_connected = false;
+    queue_head = queue_tail = queue_cursor = 0;
+    queue_count = queue_sent = 0;
+    queue_inflight = 0;
+    queue_rewind = false;
+
+    AT_RegisterUrcHandler("+MQTTSUBRECV:", ',', subrecv_urc, NULL);
+    AT_RegisterUrcHandler("+MQTTCONNECTED:", '\0', connected_urc, NULL);
+    AT_RegisterUrcHandler("+MQTTDISCONNECTED:", '\0', disconnected_urc, NULL);
+    AT_RegisterUrcHandler("+MQTTPUB:", '\0', pub_result_urc, NULL);
+}
+
+bool MQTT_Connect(const MQTT_Config *config) {
+    mqtt_command_t *usercfg = command_alloc();
+    mqtt_command_t *conn = command_alloc();
+    if (usercfg == NULL || conn == NULL) {
+        if (usercfg) {
+            usercfg->busy = false;
+        }
+        if (conn) {
+            conn->busy = false;
+        }
+        return false;
+    }
+
+    int n = snprintf(usercfg->text, sizeof(usercfg->text),
+                     "AT+MQTTUSERCFG=%d,%u,\"%s\",\"%s\",\"%s\",0,0,\"\"\r\n",
+                     MQTT_LINK_ID, (unsigned)config->scheme, config->client_id,
+                     config->username ? config->username : "",
+                     config->password ? config->password : "");
+    int m = snprintf(conn->text, sizeof(conn->text), "AT+MQTTCONN=%d,\"%s\",%u,%d\r\n",
+                     MQTT_LINK_ID, config->host, (unsigned)config->port, config->reconnect ? 1 : 0);
+    if (m < 0 || m >= MQTT_COMMAND_SIZE) {
+        usercfg->busy = false;
+        conn->busy = false;
+        return false;
+    }
+
+    // Both go out back to back; a failed USERCFG makes MQTTCONN fail too
+    if (!command_send(usercfg, n)) {
+        conn->busy = false;
+        return false;
+    }
+    return command_send(conn, m);
+}
+
+void MQTT_SetConnectionCallback(MQTT_ConnectionCallback callback, void *ctx) {
+    connection_callback = callback;
+    connection_ctx = ctx;
+}
+
+bool MQTT_IsConnected(void) {
+    return mqtt_connected;
+}
+
+bool MQTT_Subscribe(const char *filter, uint8_t qos, MQTT_MessageHandler handler,
+                    uint8_t *buffer, uint16_t buffer_size, void *ctx) {
+    if (subscription_count >= MQTT_MAX_SUBSCRIPTIONS || handler == NULL ||
+        (buffer == NULL && buffer_size > 0)) {
+        return false;
+    }
+
+    mqtt_subscription_t *sub = &subscriptions[subscription_count++];
+    sub->filter = filter;
+    sub->qos = qos;
+    sub->handler = handler;
+    sub->buffer = buffer;
+    sub->buffer_size = buffer_size;
+    sub->ctx = ctx;
+
+    // Without a connection the filter is subscribed on +MQTTCONNECTED
+    resubscribe_pending();
+    return true;
+}
+
+bool MQTT_Publish(const char *topic, const uint8_t *payload, uint16_t len, uint8_t qos,
+                  bool retain, AT_CommandCallback done, void *ctx) {
+    mqtt_command_t *cmd = command_alloc();
+    if (cmd == NULL) {
+        return false;
+    }
+    cmd->is_publish = true;
+    cmd->done = done;
+    cmd->ctx = ctx;
+
+    int n = snprintf(cmd->text, sizeof(cmd->text), "AT+MQTTPUB=%d,\"%s\",\"", MQTT_LINK_ID, topic);
+    if (n < 0 || n >= MQTT_COMMAND_SIZE) {
+        cmd->busy = false;
+        return false;
+    }
+    int escaped = escape_into(cmd->text + n, sizeof(cmd->text) - n, payload, len);
+    if (escaped < 0) {
+        cmd->busy = false;
+        return false;
+    }
+    n += escaped;
+    n += snprintf(cmd->text + n, sizeof(cmd->text) - n, "\",%u,%d\r\n", (unsigned)qos, retain ? 1 : 0);
+    return command_send(cmd, n);
+}
+
+bool MQTT_PublishRaw(const char *topic, uint32_t len, uint8_t qos, bool retain,
+                     AT_PayloadSource source, void *source_ctx, AT_CommandCallback done, void *ctx) {
+    if (len == 0 || source == NULL) {
+        return false;
+    }
+
+    mqtt_command_t *cmd = command_alloc();
+    if (cmd == NULL) {
+        return false;
+    }
+    cmd->is_publish = true;
+    cmd->done = done;
+    cmd->ctx = ctx;
+
+    int n = snprintf(cmd->text, sizeof(cmd->text), "AT+MQTTPUBRAW=%d,\"%s\",%lu,%u,%d\r\n",
+                     MQTT_LINK_ID, topic, (unsigned long)len, (unsigned)qos, retain ? 1 : 0);
+    return command_send_payload(cmd, n, len, source, source_ctx);
+}
+
+bool MQTT_PublishBuffer(const char *topic, const uint8_t *payload, uint32_t len, uint8_t qos,
+                        bool retain, AT_CommandCallback done, void *ctx) {
+    if (payload == NULL || len == 0) {
+        return false;
+    }
+
+    mqtt_command_t *cmd = command_alloc();
+    if (cmd == NULL) {
+        return false;
+    }
+    cmd->is_publish = true;
+    cmd->done = done;
+    cmd->ctx = ctx;
+    cmd->payload = payload;
+    cmd->payload_left = len;
+
+    int n = snprintf(cmd->text, sizeof(cmd->text), "AT+MQTTPUBRAW=%d,\"%s\",%lu,%u,%d\r\n",
+                     MQTT_LINK_ID, topic, (unsigned long)len, (unsigned)qos, retain ? 1 : 0);
+    return command_send_payload(cmd, n, len, buffer_source, cmd);
+}
+
+bool MQTT_QueuePublish(const char *topic, const uint8_t *payload, uint16_t len, uint8_t qos, bool retain) {
+    size_t topic_length = strlen(topic);
+    uint32_t size = (sizeof(mqtt_record_t) + topic_length + 1 + len + 3) & ~3u;
+    if (size > MQTT_QUEUE_ARENA_SIZE / 2) {
+        return false;
+    }
+
+    // Find how many of the oldest records must go before the new one fits,
+    // without touching the queue in case one of them is still in flight
+    uint16_t tail = queue_tail;
+    uint16_t evict = 0;
+    uint16_t offset;
+    uint16_t gap;
+    for (;;) {
+        // Free room at the head, and at the start of the arena if we wrap
+        bool fits;
+        offset = queue_head;
+        gap = 0;
+        if (evict == queue_count) {
+            fits = true;
+            offset = 0;
+        } else if (queue_head > tail) {
+            if (queue_head + size <= MQTT_QUEUE_ARENA_SIZE) {
+                fits = true;
+            } else {
+                gap = MQTT_QUEUE_ARENA_SIZE - queue_head;
+                offset = 0;
+                fits = (size <= tail);
+            }
+        } else {
+            fits = (queue_head + size <= tail);
+        }
+        if (fits) {
+            break;
+        }
+
+        // The arena is in order: a record the ESP is still working on
+        // keeps everything behind it
+        mqtt_record_t *oldest = record_at(tail);
+        if (oldest->inflight) {
+            return false;
+        }
+        tail = (uint16_t)((record_offset(oldest) + oldest->size) % MQTT_QUEUE_ARENA_SIZE);
+        evict++;
+    }
+
+    while (evict-- > 0) {
+        mqtt_record_t *oldest = record_at(queue_tail);
+        bool unsent = (queue_sent == 0);
+        // Acked records only wait behind a failed one to be popped in order
+        if (!oldest->acked) {
+            stats.queue_dropped++;
+        }
+        queue_pop();
+        if (unsent) {
+            queue_cursor = queue_tail;
+        }
+    }
+
+    if (gap >= sizeof(mqtt_record_t)) {
+        ((mqtt_record_t *)(arena + queue_head))->size = 0;
+    }
+    mqtt_record_t *record = (mqtt_record_t *)(arena + offset);
+    record->size = (uint16_t)size;
+    record->payload_len = len;
+    record->qos = qos;
+    record->retain = retain ? 1 : 0;
+    record->acked = 0;
+    record->inflight = 0;
+    record->attempts = 0;
+    memcpy((char *)(record + 1), topic, topic_length + 1);
+    memcpy((uint8_t *)(record + 1) + topic_length + 1, payload, len);
+
+    if (queue_count == 0) {
+        queue_tail = queue_cursor = offset;
+    }
+    queue_head = (uint16_t)((offset + size) % MQTT_QUEUE_ARENA_SIZE);
+    queue_count++;
+    stats.queued++;
+    queue_kick();
+    return true;
+}
+
+uint16_t MQTT_QueueDepth(void) {
+    return queue_count;
+}
+
+bool MQTT_TopicMatches(const char *filter, const char *topic) {
+    while (*filter) {
+        if (*filter == '#') {
+            return true;
+        }
+        if (*filter == '+') {
+            while (*topic && *topic != '/') {
+                topic++;
+            }
+            filter++;
+            continue;
+        }
+        if (*filter != *topic) {
+            // "a/#" also matches "a" itself
+            return (*topic == '\0' && filter[0] == '/' && filter[1] == '#' && filter[2] == '\0');
+        }
+        filter++;
+        topic++;
+    }
+    return *topic == '\0';
+}
+
+const MQTT_Stats *MQTT_GetStats(void) {
+    return &stats;
+}
@@ -0,0 +1,296 @@
+/* stm32_project/src/at/tcp.c */
+
+#include "at/tcp.h"
+#include "at/dns.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TCP_COMMAND_SIZE   80
+#define TCP_SEND_BLOCK_MAX 2048
+#define TCP_CONNECT_TIMEOUT_MS 10000
+#define TCP_SEND_TIMEOUT_MS    5000
+
+typedef struct {
+    uint8_t id;
+    TCP_LinkState state;
+    TCP_Handlers handlers;
+    char command[TCP_COMMAND_SIZE];  // Owned by the AT queue while command_busy
+    bool command_busy;
+    bool close_requested;
+    uint16_t keep_alive;
+    TCP_Protocol proto;
+    uint16_t port;
+    char address[DNS_ADDRESS_SIZE];  // Cached address the connect used, if any
+    uint32_t send_remaining;
+    AT_PayloadSource source;
+    void *source_ctx;
+    AT_CommandCallback send_callback;
+    void *send_ctx;
+} tcp_link_t;
+
+static tcp_link_t links[TCP_MAX_LINKS];
+
+static const char *const proto_names[] = {
+    [TCP_PROTO_TCP] = "TCP",
+    [TCP_PROTO_UDP] = "UDP",
+    [TCP_PROTO_SSL] = "SSL",
+};
+
+static void tcp_send_block(tcp_link_t *link);
+static void tcp_issue_close(tcp_link_t *link);
+
+static tcp_link_t *link_from_line(const char *line) {
+    uint8_t id = (uint8_t)(line[0] - '0');
+    return (id < TCP_MAX_LINKS) ? &links[id] : NULL;
+}
+
+static void tcp_mark_closed(tcp_link_t *link) {
+    bool was_open = (link->state != TCP_LINK_CLOSED);
+    link->state = TCP_LINK_CLOSED;
+    link->close_requested = false;
+    if (was_open && link->handlers.on_closed) {
+        link->handlers.on_closed(link->id, link->handlers.ctx);
+    }
+}
+
+// Runs whenever a link's command slot frees up
+static void tcp_command_idle(tcp_link_t *link) {
+    link->command_busy = false;
+    if (link->close_requested) {
+        if (link->state == TCP_LINK_CONNECTED) {
+            tcp_issue_close(link);
+        } else {
+            link->close_requested = false;
+        }
+    }
+}
+
+static void tcp_connect_done(AT_Result result, void *ctx) {
+    tcp_link_t *link = (tcp_link_t *)ctx;
+
+    // The cached address may be stale; resolve again next time
+    if (result != AT_RESULT_OK && link->address[0] != '\0') {
+        DNS_Invalidate(link->address);
+    }
+    link->state = (result == AT_RESULT_OK) ? TCP_LINK_CONNECTED : TCP_LINK_CLOSED;
+    tcp_command_idle(link);
+    if (link->handlers.on_connect) {
+        link->handlers.on_connect(link->id, result, link->handlers.ctx);
+    }
+}
+
+static void tcp_send_done(AT_Result result, void *ctx) {
+    tcp_link_t *link = (tcp_link_t *)ctx;
+
+    if (result == AT_RESULT_OK && link->send_remaining > 0 && link->state == TCP_LINK_CONNECTED) {
+        tcp_send_block(link);
+        return;
+    }
+
+    link->send_remaining = 0;
+    tcp_command_idle(link);
+    if (link->send_callback) {
+        link->send_callback(result, link->send_ctx);
+    }
+}
+
+static void tcp_close_done(AT_Result result, void *ctx) {
+    (void)result;
+    tcp_link_t *link = (tcp_link_t *)ctx;
+
+    link->command_busy = false;
+    tcp_mark_closed(link);
+}
+
+static void tcp_send_block(tcp_link_t *link) {
+    uint32_t block = (link->send_remaining < TCP_SEND_BLOCK_MAX) ? link->send_remaining : TCP_SEND_BLOCK_MAX;
+
+    link->send_remaining -= block;
+    snprintf(link->command, sizeof(link->command), "AT+CIPSEND=%u,%lu\r\n",
+             (unsigned)link->id, (unsigned long)block);
+    if (!AT_SendCommandWithPayload(link->command, block, link->source, link->source_ctx,
+                                   TCP_SEND_TIMEOUT_MS, tcp_send_done, link)) {
+        link->send_remaining = 0;
+        tcp_send_done(AT_RESULT_ERROR, link);
+    }
+}
+
+static void tcp_issue_close(tcp_link_t *link) {
+    snprintf(link->command, sizeof(link->command), "AT+CIPCLOSE=%u\r\n", (unsigned)link->id);
+    if (AT_SendCommand(link->command, TCP_SEND_TIMEOUT_MS, tcp_close_done, link)) {
+        link->command_busy = true;
+        link->close_requested = false;
+        link->state = TCP_LINK_CLOSING;
+    }
+}
+
+static void tcp_data_sink(const uint8_t *data, uint16_t len, void *ctx) {
+    tcp_link_t *link = (tcp_link_t *)ctx;
+
+    if (link->handlers.on_data) {
+        link->handlers.on_data(link->id, data, len, link->handlers.ctx);
+    }
+}
+
+// "+IPD,<id>,<len>:" (remote IP/port follow <len> when AT+CIPDINFO=1)
+static void tcp_ipd_urc(const char *line, void *ctx) {
+    (void)ctx;
+    char *end;
+    unsigned long id = strtoul(line + strlen("+IPD,"), &end, 10);
+    unsigned long len = strtoul(end + 1, NULL, 10);
+
+    if (id < TCP_MAX_LINKS) {
+        AT_BeginRawData(len, tcp_data_sink, &links[id]);
+    } else {
+        AT_BeginRawData(len, NULL, NULL);
+    }
+}
+
+static void tcp_closed_urc(const char *line, void *ctx) {
+    (void)ctx;
+    tcp_link_t *link = link_from_line(line);
+
+    if (link) {
+        tcp_mark_closed(link);
+    }
+}
+
+void TCP_Init(void) {
+    memset(links, 0, sizeof(links));
+    for (uint8_t i = 0; i < TCP_MAX_LINKS; i++) {
+        links[i].id = i;
+    }
+
+    AT_RegisterUrcHandler("+IPD,", ':', tcp_ipd_urc, NULL);
+    AT_RegisterUrcHandler("#,CLOSED", '\0', tcp_closed_urc, NULL);
+    DNS_Init();
+}
+
+static bool tcp_issue_start(tcp_link_t *link, const char *host) {
+    int n;
+    if (link->keep_alive > 0 && link->proto != TCP_PROTO_UDP) {
+        n = snprintf(link->command, sizeof(link->command), "AT+CIPSTART=%u,\"%s\",\"%s\",%u,%u\r\n",
+                     (unsigned)link->id, proto_names[link->proto], host, (unsigned)link->port,
+                     (unsigned)link->keep_alive);
+    } else {
+        n = snprintf(link->command, sizeof(link->command), "AT+CIPSTART=%u,\"%s\",\"%s\",%u\r\n",
+                     (unsigned)link->id, proto_names[link->proto], host, (unsigned)link->port);
+    }
+    if (n < 0 || n >= (int)sizeof(link->command)) {
+        return false;
+    }
+    return AT_SendCommand(link->command, TCP_CONNECT_TIMEOUT_MS, tcp_connect_done, link);
+}
+
+static void tcp_resolved(const char *address, AT_Result result, void *ctx) {
+    tcp_link_t *link = (tcp_link_t *)ctx;
+
+    if (result != AT_RESULT_OK || link->close_requested) {
+        tcp_connect_done(AT_RESULT_ERROR, link);
+        return;
+    }
+    memcpy(link->address, address, sizeof(link->address));
+    if (link->state == TCP_LINK_CONNECTING && !tcp_issue_start(link, address)) {
+        tcp_connect_done(AT_RESULT_ERROR, link);
+    }
+}
+
+bool TCP_Open(uint8_t link_id, TCP_Protocol proto, const char *host, uint16_t port,
+              const TCP_Handlers *handlers) {
+    if (link_id >= TCP_MAX_LINKS || host == NULL) {
+        return false;
+    }
+
+    tcp_link_t *link = &links[link_id];
+    if (link->state != TCP_LINK_CLOSED || link->command_busy) {
+        return false;
+    }
+
+    link->proto = proto;
+    link->port = port;
+    link->address[0] = '\0';
+    if (handlers) {
+        link->handlers = *handlers;
+    } else {
+        memset(&link->handlers, 0, sizeof(link->handlers));
+    }
+
+    // Host names go through the DNS cache so CIPSTART gets an address. SSL
+    // keeps the name: the ESP needs it for SNI and certificate checks.
+    if (proto != TCP_PROTO_SSL && !DNS_IsAddress(host)) {
+        link->state = TCP_LINK_CONNECTING;
+        link->command_busy = true;
+        if (!DNS_Resolve(host, tcp_resolved, link)) {
+            link->state = TCP_LINK_CLOSED;
+            link->command_busy = false;
+            return false;
+        }
+        return true;
+    }
+
+    if (!tcp_issue_start(link, host)) {
+        return false;
+    }
+    link->command_busy = true;
+    link->state = TCP_LINK_CONNECTING;
+    return true;
+}
+
+void TCP_SetKeepAlive(uint8_t link_id, uint16_t seconds) {
+    if (link_id < TCP_MAX_LINKS) {
+        links[link_id].keep_alive = seconds;
+    }
+}
+
+bool TCP_Send(uint8_t link_id, uint32_t len, AT_PayloadSource source, void *source_ctx,
+              AT_CommandCallback callback, void *ctx) {
+    if (link_id >= TCP_MAX_LINKS || len == 0 || source == NULL) {
+        return false;
+    }
+
+    tcp_link_t *link = &links[link_id];
+    if (link->state != TCP_LINK_CONNECTED || link->command_busy || link->close_requested) {
+        return false;
+    }
+
+    link->command_busy = true;
+    link->send_remaining = len;
+    link->source = source;
+    link->source_ctx = source_ctx;
+    link->send_callback = callback;
+    link->send_ctx = ctx;
+    tcp_send_block(link);
+    return true;
+}
+
+bool TCP_Close(uint8_t link_id) {
+    if (link_id >= TCP_MAX_LINKS) {
+        return false;
+    }
+
+    tcp_link_t *link = &links[link_id];
+    if (link->state == TCP_LINK_CLOSED || link->state == TCP_LINK_CLOSING) {
+        return true;
+    }
+
+    link->close_requested = true;
+    if (!link->command_busy) {
+        tcp_issue_close(link);
+    }
+    return true;
+}
+
+void TCP_Poll(void) {
+    for (uint8_t i = 0; i < TCP_MAX_LINKS; i++) {
+        tcp_link_t *link = &links[i];
+        // TCP_Close() found the AT queue full and nothing else will retry it
+        if (link->close_requested && !link->command_busy && link->state == TCP_LINK_CONNECTED) {
+            tcp_issue_close(link);
+        }
+    }
+}
+
+TCP_LinkState TCP_GetState(uint8_t link_id) {
+    return (link_id < TCP_MAX_LINKS) ? links[link_id].state : TCP_LINK_CLOSED;
+}
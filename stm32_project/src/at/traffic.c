@@ -0,0 +1,90 @@
+/* stm32_project/src/at/traffic.c */
+
+#include "at/traffic.h"
+#include <stdio.h>
+#include <string.h>
+
+// AT+SYSMSG bits
+#define SYSMSG_QUIT_PASSTHROUGH 0x01    // +QUITT
+#define SYSMSG_LINK_DETAIL      0x02    // +LINK_CONN instead of <id>,CONNECT
+
+// AT+CWLAPOPT print mask bits
+#define CWLAP_ECN     0x001
+#define CWLAP_SSID    0x002
+#define CWLAP_RSSI    0x004
+#define CWLAP_MAC     0x008
+#define CWLAP_CHANNEL 0x010
+
+static char sysmsg_expected[4];
+static char sysmsg_set[20];
+static char cwlapopt_set[24];
+
+static AT_Stats baseline;
+static bool counting = false;
+static TRAFFIC_Report report;
+
+uint8_t TRAFFIC_BuildProfile(CONFIG_Entry *table, uint8_t max) {
+    uint8_t n = 0;
+
+    // The +IPD parser only needs link id and length
+    if (n < max && AT_HasUrcHandler("+IPD,")) {
+        table[n++] = (CONFIG_Entry){ "AT+CIPDINFO?\r\n", "+CIPDINFO:", "false", "AT+CIPDINFO=0\r\n" };
+    }
+
+    if (n < max) {
+        unsigned sysmsg = 0;
+        if (AT_HasUrcHandler("+QUITT")) {
+            sysmsg |= SYSMSG_QUIT_PASSTHROUGH;
+        }
+        if (AT_HasUrcHandler("+LINK_CONN:")) {
+            sysmsg |= SYSMSG_LINK_DETAIL;
+        }
+        snprintf(sysmsg_expected, sizeof(sysmsg_expected), "%u", sysmsg);
+        snprintf(sysmsg_set, sizeof(sysmsg_set), "AT+SYSMSG=%u\r\n", sysmsg);
+        table[n++] = (CONFIG_Entry){ "AT+SYSMSG?\r\n", "+SYSMSG:", sysmsg_expected, sysmsg_set };
+    }
+
+    // Scan results: keep what a +CWLAP handler needs to pick an AP, strongest first
+    if (n < max) {
+        unsigned mask = CWLAP_SSID;
+        if (AT_HasUrcHandler("+CWLAP:")) {
+            mask |= CWLAP_ECN | CWLAP_RSSI | CWLAP_MAC | CWLAP_CHANNEL;
+        }
+        snprintf(cwlapopt_set, sizeof(cwlapopt_set), "AT+CWLAPOPT=1,%u\r\n", mask);
+        table[n++] = (CONFIG_Entry){ NULL, NULL, NULL, cwlapopt_set };
+    }
+    return n;
+}
+
+void TRAFFIC_Start(void) {
+    baseline = *AT_GetStats();
+    counting = true;
+}
+
+const TRAFFIC_Report *TRAFFIC_GetReport(void) {
+    const AT_Stats *now = AT_GetStats();
+
+    memset(&report, 0, sizeof(report));
+    if (counting) {
+        // Echo is negotiated by the core (AT_NegotiateEcho); what still came back is not saved
+        report.echo_bytes_saved = (now->command_bytes - baseline.command_bytes) -
+                                  (now->echo_bytes - baseline.echo_bytes);
+        report.ipd_bytes_saved = (now->raw_blocks - baseline.raw_blocks) * TRAFFIC_IPD_INFO_BYTES;
+        report.unclaimed_bytes = now->unclaimed_bytes - baseline.unclaimed_bytes;
+        report.unclaimed_lines = now->unclaimed_lines - baseline.unclaimed_lines;
+    }
+    return &report;
+}
+
+bool TRAFFIC_ReportLine(uint8_t *cursor, char *line, uint16_t size) {
+    if (*cursor > 0) {
+        return false;
+    }
+
+    const TRAFFIC_Report *traffic = TRAFFIC_GetReport();
+    (*cursor)++;
+    snprintf(line, size, "traffic echo_saved %lu ipd_saved %lu unclaimed %lu bytes %lu lines\r\n",
+             (unsigned long)traffic->echo_bytes_saved, (unsigned long)traffic->ipd_bytes_saved,
+             (unsigned long)traffic->unclaimed_bytes, (unsigned long)traffic->unclaimed_lines);
+    return true;
+}
@@ -0,0 +1,350 @@
+/* stm32_project/src/at/wifi.c */
+
+#include "at/wifi.h"
+#include "stm32f0xx_hal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define WIFI_COMMAND_SIZE        192
+#define WIFI_COMMAND_TIMEOUT_MS  2000
+#define WIFI_TARGETED_JOIN_S     5       // jap_timeout of the join with a known BSSID
+#define WIFI_TARGETED_TIMEOUT_MS ((WIFI_TARGETED_JOIN_S + 3) * 1000)
+#define WIFI_SCAN_TIMEOUT_MS     20000   // Default jap_timeout is 15 s
+
+typedef enum {
+    STEP_IDLE,
+    STEP_STATIC_IP,
+    STEP_JOIN_TARGETED,
+    STEP_DHCP_ON,
+    STEP_JOIN_SCAN,
+    STEP_QUERY_AP,
+    STEP_QUERY_IP,
+    STEP_RECONNECT_CONFIG,
+} wifi_step_t;
+
+static WIFI_Config config;
+static wifi_step_t step = STEP_IDLE;
+static char command[WIFI_COMMAND_SIZE];
+static AT_CommandCallback connect_callback = NULL;
+static void *connect_ctx = NULL;
+static WIFI_EventCallback event_callback = NULL;
+static void *event_ctx = NULL;
+
+static WIFI_State state = WIFI_STATE_DISCONNECTED;
+static WIFI_Profile profile;
+static WIFI_Profile learned;     // Filled by the queries after a join
+static WIFI_Timing timing;
+static WIFI_Stats stats;
+static uint32_t start_tick = 0;
+
+static void run_step(wifi_step_t next);
+
+static void set_state(WIFI_State next) {
+    state = next;
+    if (event_callback) {
+        event_callback(next, event_ctx);
+    }
+}
+
+// AT+CWJAP string parameters need '"', ',' and '\' escaped
+static int escape_into(char *dst, size_t size, const char *src) {
+    size_t n = 0;
+    for (; *src != '\0'; src++) {
+        if (*src == '"' || *src == ',' || *src == '\\') {
+            if (n + 1 >= size) {
+                return -1;
+            }
+            dst[n++] = '\\';
+        }
+        if (n + 1 >= size) {
+            return -1;
+        }
+        dst[n++] = *src;
+    }
+    dst[n] = '\0';
+    return (int)n;
+}
+
+// AT+CWJAP="<ssid>","<pwd>" followed by extra, which starts with ',' or is empty
+static int format_join(const char *extra) {
+    int n = snprintf(command, sizeof(command), "AT+CWJAP=\"");
+    int m = escape_into(command + n, sizeof(command) - n, config.ssid);
+    if (m < 0) {
+        return -1;
+    }
+    n += m;
+    n += snprintf(command + n, sizeof(command) - n, "\",\"");
+    m = escape_into(command + n, sizeof(command) - n, config.password ? config.password : "");
+    if (m < 0) {
+        return -1;
+    }
+    n += m;
+    m = snprintf(command + n, sizeof(command) - n, "\"%s\r\n", extra);
+    if (m < 0 || n + m >= (int)sizeof(command)) {
+        return -1;
+    }
+    return n + m;
+}
+
+static void finish_connect(AT_Result result) {
+    AT_CommandCallback callback = connect_callback;
+
+    step = STEP_IDLE;
+    if (result == AT_RESULT_OK) {
+        stats.connects++;
+    } else {
+        stats.failures++;
+        if (state == WIFI_STATE_CONNECTING) {
+            set_state(WIFI_STATE_DISCONNECTED);
+        }
+    }
+    if (callback) {
+        callback(result, connect_ctx);
+    }
+}
+
+static void step_done(AT_Result result, void *ctx) {
+    (void)ctx;
+
+    switch (step) {
+    case STEP_STATIC_IP:
+        timing.static_ip = (result == AT_RESULT_OK);
+        run_step(STEP_JOIN_TARGETED);
+        break;
+
+    case STEP_JOIN_TARGETED:
+        if (result == AT_RESULT_OK) {
+            timing.targeted = true;
+            stats.targeted_joins++;
+            timing.total_ms = HAL_GetTick() - start_tick;
+            run_step(STEP_QUERY_AP);
+        } else {
+            // The AP may have moved channel or been replaced; scan for it
+            stats.full_scans++;
+            run_step(timing.static_ip ? STEP_DHCP_ON : STEP_JOIN_SCAN);
+        }
+        break;
+
+    case STEP_DHCP_ON:
+        timing.static_ip = false;
+        run_step(STEP_JOIN_SCAN);
+        break;
+
+    case STEP_JOIN_SCAN:
+        if (result == AT_RESULT_OK) {
+            timing.total_ms = HAL_GetTick() - start_tick;
+            run_step(STEP_QUERY_AP);
+        } else {
+            finish_connect(result);
+        }
+        break;
+
+    case STEP_QUERY_AP:
+        run_step(STEP_QUERY_IP);
+        break;
+
+    case STEP_QUERY_IP:
+        if (result == AT_RESULT_OK && learned.bssid[0] != '\0' && learned.ip[0] != '\0') {
+            learned.valid = true;
+            profile = learned;
+        }
+        if (config.reconnect_interval_s > 0) {
+            run_step(STEP_RECONNECT_CONFIG);
+        } else {
+            finish_connect(AT_RESULT_OK);
+        }
+        break;
+
+    case STEP_RECONNECT_CONFIG:
+        // The join itself succeeded; background reconnects are best effort
+        finish_connect(AT_RESULT_OK);
+        break;
+
+    default:
+        break;
+    }
+}
+
+static void run_step(wifi_step_t next) {
+    uint32_t timeout_ms = WIFI_COMMAND_TIMEOUT_MS;
+    int n = 0;
+    char extra[48];
+
+    step = next;
+    switch (next) {
+    case STEP_STATIC_IP:
+        n = snprintf(command, sizeof(command), "AT+CIPSTA=\"%s\",\"%s\",\"%s\"\r\n",
+                     profile.ip, profile.gateway, profile.netmask);
+        break;
+    case STEP_JOIN_TARGETED:
+        // pci_en 0, reconn_interval 1, listen_interval 3, scan_mode 0 (stop at first match)
+        snprintf(extra, sizeof(extra), ",\"%s\",0,1,3,0,%u", profile.bssid, (unsigned)WIFI_TARGETED_JOIN_S);
+        n = format_join(extra);
+        timeout_ms = WIFI_TARGETED_TIMEOUT_MS;
+        break;
+    case STEP_DHCP_ON:
+        n = snprintf(command, sizeof(command), "AT+CWDHCP=1,1\r\n");
+        break;
+    case STEP_JOIN_SCAN:
+        n = format_join("");
+        timeout_ms = WIFI_SCAN_TIMEOUT_MS;
+        break;
+    case STEP_QUERY_AP:
+        memset(&learned, 0, sizeof(learned));
+        n = snprintf(command, sizeof(command), "AT+CWJAP?\r\n");
+        break;
+    case STEP_QUERY_IP:
+        n = snprintf(command, sizeof(command), "AT+CIPSTA?\r\n");
+        break;
+    case STEP_RECONNECT_CONFIG:
+        n = snprintf(command, sizeof(command), "AT+CWRECONNCFG=%u,%u\r\n",
+                     (unsigned)config.reconnect_interval_s, (unsigned)config.reconnect_attempts);
+        break;
+    default:
+        return;
+    }
+
+    if (n < 0 || n >= (int)sizeof(command) ||
+        !AT_SendCommand(command, timeout_ms, step_done, NULL)) {
+        finish_connect(AT_RESULT_ERROR);
+    }
+}
+
+static void copy_quoted(char *dst, size_t size, const char *src) {
+    size_t n = 0;
+
+    if (*src == '"') {
+        src++;
+    }
+    while (src[n] != '\0' && src[n] != '"' && n < size - 1) {
+        dst[n] = src[n];
+        n++;
+    }
+    dst[n] = '\0';
+}
+
+// "+CWJAP:<error code>" after a failed join, or
+// "+CWJAP:<ssid>,<bssid>,<channel>,<rssi>,..." answering AT+CWJAP?
+static void cwjap_urc(const char *line, void *ctx) {
+    (void)ctx;
+    const char *value = line + strlen("+CWJAP:");
+
+    if (*value != '"') {
+        stats.last_error = (uint8_t)strtoul(value, NULL, 10);
+        return;
+    }
+
+    // The SSID may contain anything; find the BSSID by its shape
+    for (const char *p = strchr(value + 1, ','); p != NULL; p = strchr(p + 1, ',')) {
+        if (p[1] == '"' && strlen(p + 2) > WIFI_BSSID_SIZE && p[2 + 2] == ':' &&
+            p[2 + 14] == ':' && p[2 + WIFI_BSSID_SIZE - 1] == '"') {
+            copy_quoted(learned.bssid, sizeof(learned.bssid), p + 1);
+            learned.channel = (uint8_t)strtoul(p + 2 + WIFI_BSSID_SIZE + 1, NULL, 10);
+            return;
+        }
+    }
+}
+
+// "+CIPSTA:ip:"<ip>"", "+CIPSTA:gateway:"<gw>"", "+CIPSTA:netmask:"<mask>""
+static void cipsta_urc(const char *line, void *ctx) {
+    (void)ctx;
+    const char *value = line + strlen("+CIPSTA:");
+
+    if (strncmp(value, "ip:", 3) == 0) {
+        copy_quoted(learned.ip, sizeof(learned.ip), value + 3);
+    } else if (strncmp(value, "gateway:", 8) == 0) {
+        copy_quoted(learned.gateway, sizeof(learned.gateway), value + 8);
+    } else if (strncmp(value, "netmask:", 8) == 0) {
+        copy_quoted(learned.netmask, sizeof(learned.netmask), value + 8);
+    }
+}
+
+static void connected_urc(const char *line, void *ctx) {
+    (void)line;
+    (void)ctx;
+    timing.associate_ms = HAL_GetTick() - start_tick;
+    set_state(WIFI_STATE_CONNECTED);
+}
+
+static void got_ip_urc(const char *line, void *ctx) {
+    (void)line;
+    (void)ctx;
+    timing.got_ip_ms = HAL_GetTick() - start_tick;
+    set_state(WIFI_STATE_GOT_IP);
+}
+
+static void disconnect_urc(const char *line, void *ctx) {
+    (void)line;
+    (void)ctx;
+    stats.disconnects++;
+
+    // Outside WIFI_Connect() the ESP reconnects on its own (AT+CWRECONNCFG);
+    // time that reconnect from here
+    if (step == STEP_IDLE) {
+        start_tick = HAL_GetTick();
+        memset(&timing, 0, sizeof(timing));
+    }
+    set_state(WIFI_STATE_DISCONNECTED);
+}
+
+void WIFI_Init(void) {
+    step = STEP_IDLE;
+    state = WIFI_STATE_DISCONNECTED;
+    memset(&profile, 0, sizeof(profile));
+    memset(&timing, 0, sizeof(timing));
+    memset(&stats, 0, sizeof(stats));
+
+    AT_RegisterUrcHandler("WIFI CONNECTED", '\0', connected_urc, NULL);
+    AT_RegisterUrcHandler("WIFI GOT IP", '\0', got_ip_urc, NULL);
+    AT_RegisterUrcHandler("WIFI DISCONNECT", '\0', disconnect_urc, NULL);
+    AT_RegisterUrcHandler("+CWJAP:", '\0', cwjap_urc, NULL);
+    AT_RegisterUrcHandler("+CIPSTA:", '\0', cipsta_urc, NULL);
+}
+
+bool WIFI_Connect(const WIFI_Config *wifi_config, AT_CommandCallback callback, void *ctx) {
+    if (step != STEP_IDLE || wifi_config->ssid == NULL) {
+        return false;
+    }
+
+    config = *wifi_config;
+    connect_callback = callback;
+    connect_ctx = ctx;
+    start_tick = HAL_GetTick();
+    memset(&timing, 0, sizeof(timing));
+    set_state(WIFI_STATE_CONNECTING);
+
+    if (!profile.valid) {
+        run_step(STEP_JOIN_SCAN);
+    } else if (config.static_ip) {
+        run_step(STEP_STATIC_IP);
+    } else {
+        run_step(STEP_JOIN_TARGETED);
+    }
+    return true;
+}
+
+void WIFI_SetEventCallback(WIFI_EventCallback callback, void *ctx) {
+    event_callback = callback;
+    event_ctx = ctx;
+}
+
+WIFI_State WIFI_GetState(void) {
+    return state;
+}
+
+const WIFI_Profile *WIFI_GetProfile(void) {
+    return &profile;
+}
+
+void WIFI_SetProfile(const WIFI_Profile *new_profile) {
+    profile = *new_profile;
+}
+
+const WIFI_Timing *WIFI_GetTiming(void) {
+    return &timing;
+}
+
+const WIFI_Stats *WIFI_GetStats(void) {
+    return &stats;
+}
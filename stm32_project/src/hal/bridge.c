@@ -0,0 +1,311 @@
+/* stm32_project/src/hal/bridge.c */
+
+#include "hal/bridge.h"
+#include "hal/debug_link.h"
+#include "hal/timestamp.h"
+#include <string.h>
+
+/* Spans handed to a tap per bridge_poll(); one lap of the buffer at most */
+#define BRIDGE_TAP_SPANS 2
+
+typedef struct {
+    uart_instance_t from;
+    uart_instance_t to;
+    uint8_t *buffer;
+    uint16_t size;
+    uint32_t rate_from;         // Line rates in baud
+    uint32_t rate_to;
+    uint32_t tx_cursor;         // First byte not yet sent
+    volatile uint16_t tx_len;   // Span on the wire, 0 when idle
+    uint32_t tx_start;          // Bytes received when it started
+    bool kicking;               // pipe_kick() is copying spans out
+    bool forward;               // Send spans on to the other UART
+    bool capture;               // Otherwise record them for the PC
+    uint32_t tap_cursor;
+    bridge_tap_t tap;
+    void *tap_ctx;
+    bridge_stats_t stats;
+} bridge_pipe_t;
+
+static uint8_t esp_buffer[BRIDGE_ESP_BUFFER_SIZE];
+static uint8_t pc_buffer[BRIDGE_PC_BUFFER_SIZE];
+
+static bridge_pipe_t pipes[BRIDGE_DIRECTIONS] = {
+    [BRIDGE_ESP_TO_PC] = { .from = UART1_INSTANCE, .to = UART2_INSTANCE,
+                           .buffer = esp_buffer, .size = sizeof(esp_buffer),
+                           .rate_from = UART1_BAUDRATE, .rate_to = UART2_BAUDRATE, .forward = true },
+    [BRIDGE_PC_TO_ESP] = { .from = UART2_INSTANCE, .to = UART1_INSTANCE,
+                           .buffer = pc_buffer, .size = sizeof(pc_buffer),
+                           .rate_from = UART2_BAUDRATE, .rate_to = UART1_BAUDRATE, .forward = true },
+};
+
+static uint32_t capture_lost;       // Not yet reported by a LOST record
+static bridge_capture_stats_t capture_stats;
+
+static void pipe_sent(void *ctx);
+
+static bool capture_send(bridge_record_t type, uint32_t now, const uint8_t *data, uint16_t len)
+{
+    uint8_t header[BRIDGE_RECORD_HEADER] = {
+        BRIDGE_RECORD_SYNC, (uint8_t)type,
+        (uint8_t)now, (uint8_t)(now >> 8), (uint8_t)(now >> 16), (uint8_t)(now >> 24),
+        (uint8_t)len, (uint8_t)(len >> 8),
+    };
+    return debug_link_send_with_header(DEBUG_LINK_CAPTURE, header, sizeof(header), data, len);
+}
+
+/* Queue one record, or count its bytes as lost when the channel is full.
+   The records are framed with interrupts on; only the counts are locked. */
+static void capture_record(bridge_record_t type, const uint8_t *data, uint16_t len)
+{
+    uint32_t now = timestamp_us();
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    uint32_t lost = capture_lost;
+    capture_lost = 0;
+    __set_PRIMASK(primask);
+
+    bool room = true;
+    if (lost > 0) {
+        uint8_t count[4] = {
+            (uint8_t)lost, (uint8_t)(lost >> 8), (uint8_t)(lost >> 16), (uint8_t)(lost >> 24),
+        };
+        room = capture_send(BRIDGE_RECORD_LOST, now, count, sizeof(count));
+    }
+    bool sent = room && capture_send(type, now, data, len);
+
+    primask = __get_PRIMASK();
+    __disable_irq();
+    if (!room) {
+        capture_lost += lost;
+    }
+    if (sent) {
+        capture_stats.records++;
+        capture_stats.bytes += len;
+    } else {
+        capture_lost += len;
+        capture_stats.lost_bytes += len;
+    }
+    __set_PRIMASK(primask);
+}
+
+/* Everything that starts on USART1 TX, whoever queued it */
+static void capture_tx(const uint8_t *data, uint16_t len, void *ctx)
+{
+    (void)ctx;
+    capture_record(BRIDGE_RECORD_TX, data, len);
+}
+
+/* Longest span that leaves before reception laps it: while it goes out at
+   rate_to, the bytes arriving at rate_from fill the free part of the buffer
+   and then overwrite the span from its start. At least one byte. */
+static uint16_t span_limit(const bridge_pipe_t *pipe, uint32_t backlog)
+{
+    if (pipe->rate_from <= pipe->rate_to) {
+        return UINT16_MAX;
+    }
+
+    /* In units of 100 baud, so buffer size times rate stays in 32 bits */
+    uint32_t free = (backlog < pipe->size) ? pipe->size - backlog : 0;
+    uint32_t faster = (pipe->rate_from - pipe->rate_to) / 100;
+    uint32_t limit = (faster == 0) ? UINT16_MAX : free * (pipe->rate_to / 100) / faster;
+    if (limit > UINT16_MAX) {
+        limit = UINT16_MAX;
+    }
+    return (limit > 0) ? (uint16_t)limit : 1;
+}
+
+/* Bytes of the span at tx_cursor that reception overwrote before they were
+   read, sent or copied, from the count when it started. Taking the bytes
+   received meanwhile to arrive evenly, byte k is overwritten first once
+   k * (received - len) / len exceeds the free part of the buffer. */
+static uint16_t span_lapped(const bridge_pipe_t *pipe, uint32_t start, uint16_t len)
+{
+    int32_t free = (int32_t)(pipe->tx_cursor + pipe->size - start);
+    int32_t excess = (int32_t)(uart_rx_stream_count(pipe->from) - start - len);
+
+    if (free < 0) {
+        return len;
+    }
+    if (excess <= free) {
+        return 0;
+    }
+    uint32_t first = ((uint32_t)free * len + (uint32_t)excess - 1) / (uint32_t)excess;
+    return (first < len) ? (uint16_t)(len - first) : 0;
+}
+
+/* Send everything received so far as one span, unless a span is on the wire.
+   Runs from the RX event, the TX completion and the main loop. Spans that
+   are copied (captured or framed) are copied with interrupts on; a kick
+   that comes meanwhile leaves the new bytes to the loop already running. */
+static void pipe_kick(bridge_pipe_t *pipe)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    if (pipe->kicking) {
+        __set_PRIMASK(primask);
+        return;
+    }
+    pipe->kicking = true;
+
+    while (pipe->tx_len == 0) {
+        const uint8_t *data;
+        uint32_t lost = 0;
+        uint16_t len = uart_rx_stream_peek(pipe->from, &pipe->tx_cursor, &data, &lost);
+
+        pipe->stats.overrun_bytes += lost;
+        if (len == 0) {
+            break;
+        }
+        if (!pipe->forward) {
+            // Recorded (copied) or left to the tap; take the wrapped rest too
+            if (pipe->capture) {
+                uint32_t start = uart_rx_stream_count(pipe->from);
+                __set_PRIMASK(primask);
+                capture_record(BRIDGE_RECORD_RX, data, len);
+                __disable_irq();
+                pipe->stats.overrun_bytes += span_lapped(pipe, start, len);
+            }
+            pipe->tx_cursor += len;
+            continue;
+        }
+        if (pipe->to == UART2_INSTANCE && debug_link_get_format() != DEBUG_LINK_RAW) {
+            // The PC link is framed: the bytes go out copied, as a bridge frame
+            uint32_t start = uart_rx_stream_count(pipe->from);
+            __set_PRIMASK(primask);
+            bool queued = debug_link_send(DEBUG_LINK_BRIDGE, data, len);
+            __disable_irq();
+            if (queued) {
+                pipe->stats.tx_bytes += len;
+                pipe->stats.spans++;
+                pipe->stats.overrun_bytes += span_lapped(pipe, start, len);
+            } else {
+                pipe->stats.overrun_bytes += len;
+            }
+            pipe->tx_cursor += len;
+            continue;
+        }
+        uint32_t start = uart_rx_stream_count(pipe->from);
+        uint16_t limit = span_limit(pipe, start - pipe->tx_cursor);
+        if (len > limit) {
+            len = limit;
+        }
+        if (uart_send_queued(pipe->to, data, len, pipe_sent, pipe) == HAL_OK) {
+            pipe->tx_start = start;
+            pipe->tx_len = len;
+        } else {
+            // The other side is behind; the bytes wait in the buffer
+            pipe->stats.stalls++;
+        }
+        break;
+    }
+
+    uint32_t backlog = uart_rx_stream_count(pipe->from) - pipe->tx_cursor;
+    if (backlog > pipe->stats.peak_backlog) {
+        pipe->stats.peak_backlog = (uint16_t)(backlog > UINT16_MAX ? UINT16_MAX : backlog);
+    }
+
+    pipe->kicking = false;
+    __set_PRIMASK(primask);
+}
+
+static void pipe_received(void *ctx)
+{
+    pipe_kick((bridge_pipe_t *)ctx);
+}
+
+/* Called from the DMA interrupt once the span has left */
+static void pipe_sent(void *ctx)
+{
+    bridge_pipe_t *pipe = (bridge_pipe_t *)ctx;
+
+    pipe->stats.overrun_bytes += span_lapped(pipe, pipe->tx_start, pipe->tx_len);
+    pipe->tx_cursor += pipe->tx_len;
+    pipe->stats.tx_bytes += pipe->tx_len;
+    pipe->stats.spans++;
+    pipe->tx_len = 0;
+    pipe_kick(pipe);
+}
+
+void bridge_set_tap(bridge_direction_t direction, bridge_tap_t tap, void *ctx)
+{
+    pipes[direction].tap = tap;
+    pipes[direction].tap_ctx = ctx;
+}
+
+void bridge_set_mode(bridge_mode_t mode)
+{
+    bool capture = (mode == BRIDGE_MODE_CAPTURE);
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    pipes[BRIDGE_ESP_TO_PC].forward = (mode == BRIDGE_MODE_TRANSPARENT);
+    pipes[BRIDGE_ESP_TO_PC].capture = capture;
+    pipes[BRIDGE_PC_TO_ESP].forward = (mode != BRIDGE_MODE_ARBITRATED);
+    uart_set_tx_observer(UART1_INSTANCE, capture ? capture_tx : NULL, NULL);
+
+    __set_PRIMASK(primask);
+}
+
+bool bridge_write(const uint8_t *data, uint16_t len)
+{
+    return debug_link_send(DEBUG_LINK_BRIDGE, data, len);
+}
+
+HAL_StatusTypeDef bridge_init(void)
+{
+    for (uint8_t i = 0; i < BRIDGE_DIRECTIONS; i++) {
+        bridge_pipe_t *pipe = &pipes[i];
+
+        pipe->tx_cursor = 0;
+        pipe->tx_len = 0;
+        pipe->kicking = false;
+        pipe->tap_cursor = 0;
+        memset(&pipe->stats, 0, sizeof(pipe->stats));
+        if (uart_start_rx_stream(pipe->from, pipe->buffer, pipe->size,
+                                 pipe_received, pipe) != HAL_OK) {
+            return HAL_ERROR;
+        }
+    }
+    return HAL_OK;
+}
+
+void bridge_poll(void)
+{
+    for (uint8_t i = 0; i < BRIDGE_DIRECTIONS; i++) {
+        bridge_pipe_t *pipe = &pipes[i];
+
+        pipe_kick(pipe);
+        if (pipe->tap == NULL) {
+            continue;
+        }
+
+        for (uint8_t n = 0; n < BRIDGE_TAP_SPANS; n++) {
+            const uint8_t *data;
+            uint32_t lost = 0;
+            uint16_t len = uart_rx_stream_peek(pipe->from, &pipe->tap_cursor, &data, &lost);
+
+            pipe->stats.tap_lost_bytes += lost;
+            if (len == 0) {
+                break;
+            }
+            pipe->tap(data, len, pipe->tap_ctx);
+            pipe->tap_cursor += len;
+        }
+    }
+}
+
+const bridge_stats_t *bridge_get_stats(bridge_direction_t direction)
+{
+    bridge_pipe_t *pipe = &pipes[direction];
+
+    pipe->stats.rx_bytes = uart_rx_stream_count(pipe->from);
+    return &pipe->stats;
+}
+
+const bridge_capture_stats_t *bridge_get_capture_stats(void)
+{
+    return &capture_stats;
+}
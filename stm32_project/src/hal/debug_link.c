@@ -0,0 +1,358 @@
+/* stm32_project/src/hal/debug_link.c */
+
+#include "hal/debug_link.h"
+#include "hal/uart.h"
+#include <string.h>
+
+/* Each queued frame is stored as its slot length and wire length (2 bytes
+   each) and its wire bytes. The slot is reserved for the worst case with
+   interrupts off and filled with them on; until then the wire length is
+   FRAME_PENDING and the frames behind it wait. */
+#define FRAME_PREFIX  4
+#define FRAME_PENDING 0xFFFF
+#define COBS_BLOCK    0xFF
+
+/* The queue indices run free and wrap with % size */
+#define POWER_OF_TWO(n) (((n) & ((n) - 1)) == 0)
+#if !POWER_OF_TWO(DEBUG_LINK_BRIDGE_SIZE) || !POWER_OF_TWO(DEBUG_LINK_CAPTURE_SIZE) || \
+    !POWER_OF_TWO(DEBUG_LINK_METRICS_SIZE) || !POWER_OF_TWO(DEBUG_LINK_LOG_SIZE) || \
+    !POWER_OF_TWO(DEBUG_LINK_TRACE_SIZE)
+#error "DEBUG_LINK_*_SIZE must be powers of two"
+#endif
+
+typedef struct {
+    uint8_t *buffer;
+    uint16_t size;
+    uint8_t priority;
+    uint32_t head;              // Bytes written
+    uint32_t tail;              // Bytes sent
+    debug_link_stats_t stats;
+} link_queue_t;
+
+/* Frame being written into its slot, COBS encoded unless the link is raw */
+typedef struct {
+    link_queue_t *queue;
+    uint32_t pos;               // Next byte
+    uint32_t code_at;           // Where the current block's code byte goes
+    uint8_t code;
+} cobs_t;
+
+/* The queues one after the other in a single array; a 0-byte queue takes none */
+#define BRIDGE_AT  0
+#define CAPTURE_AT (BRIDGE_AT + DEBUG_LINK_BRIDGE_SIZE)
+#define METRICS_AT (CAPTURE_AT + DEBUG_LINK_CAPTURE_SIZE)
+#define LOG_AT     (METRICS_AT + DEBUG_LINK_METRICS_SIZE)
+#define TRACE_AT   (LOG_AT + DEBUG_LINK_LOG_SIZE)
+
+static uint8_t storage[TRACE_AT + DEBUG_LINK_TRACE_SIZE];
+
+static link_queue_t queues[DEBUG_LINK_CHANNELS] = {
+    [DEBUG_LINK_BRIDGE]  = { &storage[BRIDGE_AT], DEBUG_LINK_BRIDGE_SIZE, DEBUG_LINK_BRIDGE },
+    [DEBUG_LINK_CAPTURE] = { &storage[CAPTURE_AT], DEBUG_LINK_CAPTURE_SIZE, DEBUG_LINK_CAPTURE },
+    [DEBUG_LINK_METRICS] = { &storage[METRICS_AT], DEBUG_LINK_METRICS_SIZE, DEBUG_LINK_METRICS },
+    [DEBUG_LINK_LOG]     = { &storage[LOG_AT], DEBUG_LINK_LOG_SIZE, DEBUG_LINK_LOG },
+    [DEBUG_LINK_TRACE]   = { &storage[TRACE_AT], DEBUG_LINK_TRACE_SIZE, DEBUG_LINK_TRACE },
+};
+
+static debug_link_format_t format = DEBUG_LINK_RAW;
+static link_queue_t *current = NULL;    // Queue whose frame is going out
+static uint16_t current_left = 0;       // Wire bytes of that frame not yet sent
+static uint16_t current_slack = 0;      // Slot bytes after that frame
+static volatile uint16_t tx_len = 0;    // Span on the wire
+static uint32_t crc_generation = 0;     // Counts resets of the CRC unit
+
+static void link_sent(void *ctx);
+
+static void queue_set16(link_queue_t *queue, uint32_t pos, uint16_t value)
+{
+    queue->buffer[pos % queue->size] = (uint8_t)value;
+    queue->buffer[(pos + 1) % queue->size] = (uint8_t)(value >> 8);
+}
+
+static uint16_t queue_get16(const link_queue_t *queue, uint32_t pos)
+{
+    return (uint16_t)(queue->buffer[pos % queue->size] | (queue->buffer[(pos + 1) % queue->size] << 8));
+}
+
+static void frame_put(cobs_t *cobs, uint8_t byte)
+{
+    cobs->queue->buffer[cobs->pos++ % cobs->queue->size] = byte;
+}
+
+static void cobs_begin(cobs_t *cobs, link_queue_t *queue, uint32_t pos)
+{
+    cobs->queue = queue;
+    cobs->code_at = pos;
+    cobs->pos = pos + 1;
+    cobs->code = 1;
+}
+
+static void cobs_close_block(cobs_t *cobs)
+{
+    cobs->queue->buffer[cobs->code_at % cobs->queue->size] = cobs->code;
+    cobs->code_at = cobs->pos++;
+    cobs->code = 1;
+}
+
+static void cobs_byte(cobs_t *cobs, uint8_t byte)
+{
+    if (byte == 0) {
+        cobs_close_block(cobs);
+        return;
+    }
+    frame_put(cobs, byte);
+    if (++cobs->code == COBS_BLOCK) {
+        cobs_close_block(cobs);
+    }
+}
+
+static void cobs_end(cobs_t *cobs)
+{
+    cobs->queue->buffer[cobs->code_at % cobs->queue->size] = cobs->code;
+    frame_put(cobs, 0);
+}
+
+/* The CRC unit runs with its reset configuration: CRC-32/MPEG-2, byte input.
+   Frames are encoded with interrupts on, so a handler may reset the unit
+   under a frame it preempted; that frame sees the generation change and
+   computes its CRC again. */
+static uint32_t crc_start(void)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    uint32_t generation = ++crc_generation;
+    CRC->CR = CRC_CR_RESET;
+    __set_PRIMASK(primask);
+    return generation;
+}
+
+static void crc_byte(uint8_t byte)
+{
+    *(__IO uint8_t *)&CRC->DR = byte;
+}
+
+static void crc_bytes(const uint8_t *data, uint16_t len)
+{
+    for (uint16_t i = 0; i < len; i++) {
+        crc_byte(data[i]);
+    }
+}
+
+/* False when another frame used the unit since crc_start() */
+static bool crc_finish(uint32_t generation, uint32_t *value)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    bool valid = (generation == crc_generation);
+    *value = CRC->DR;
+    __set_PRIMASK(primask);
+    return valid;
+}
+
+/* Queue bytes a frame of this payload takes at most, 0 when it cannot be sent:
+   channel byte, CRC, one code byte per block, delimiter */
+static uint32_t frame_size(uint32_t payload)
+{
+    uint32_t wire = payload;
+    if (format != DEBUG_LINK_RAW) {
+        wire += 1 + (format == DEBUG_LINK_COBS_CRC ? 4 : 0);
+        wire += wire / (COBS_BLOCK - 1) + 2;
+    }
+    return (payload == 0 || wire > UINT16_MAX) ? 0 : FRAME_PREFIX + wire;
+}
+
+/* Start the next span: the rest of the current frame, or the first frame of
+   the most urgent queue. Interrupts off. */
+static void link_kick(void)
+{
+    if (tx_len != 0) {
+        return;
+    }
+
+    if (current == NULL) {
+        for (uint8_t i = 0; i < DEBUG_LINK_CHANNELS; i++) {
+            link_queue_t *queue = &queues[i];
+            if (queue->head != queue->tail && queue_get16(queue, queue->tail + 2) != FRAME_PENDING &&
+                (current == NULL || queue->priority < current->priority)) {
+                current = queue;
+            }
+        }
+        if (current == NULL) {
+            return;
+        }
+        current_left = queue_get16(current, current->tail + 2);
+        current_slack = queue_get16(current, current->tail) - current_left;
+        current->tail += FRAME_PREFIX;
+    }
+
+    uint16_t index = current->tail % current->size;
+    uint16_t span = current->size - index;
+    if (span > current_left) {
+        span = current_left;
+    }
+    if (uart_send_queued(UART2_INSTANCE, &current->buffer[index], span, link_sent, NULL) == HAL_OK) {
+        tx_len = span;
+    }
+}
+
+static void link_sent(void *ctx)
+{
+    (void)ctx;
+    current->tail += tx_len;
+    current_left -= tx_len;
+    tx_len = 0;
+    if (current_left == 0) {
+        current->tail += current_slack;
+        current = NULL;
+    }
+    link_kick();
+}
+
+/* Take needed bytes of the queue for a frame starting at *start */
+static bool frame_reserve(link_queue_t *queue, uint32_t needed, uint32_t *start)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    if (needed > queue->size - (queue->head - queue->tail)) {
+        queue->stats.dropped++;
+        __set_PRIMASK(primask);
+        return false;
+    }
+
+    *start = queue->head;
+    queue->head += needed;
+    queue_set16(queue, *start, (uint16_t)(needed - FRAME_PREFIX));
+    queue_set16(queue, *start + 2, FRAME_PENDING);
+    if (queue->head - queue->tail > queue->stats.peak_used) {
+        queue->stats.peak_used = (uint16_t)(queue->head - queue->tail);
+    }
+
+    __set_PRIMASK(primask);
+    return true;
+}
+
+/* The frame at start is written up to end; let it go out */
+static void frame_commit(link_queue_t *queue, uint32_t start, uint32_t end, uint32_t payload)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    queue_set16(queue, start + 2, (uint16_t)(end - start - FRAME_PREFIX));
+    queue->stats.frames++;
+    queue->stats.bytes += payload;
+    link_kick();
+
+    __set_PRIMASK(primask);
+}
+
+void debug_link_init(debug_link_format_t new_format)
+{
+    format = new_format;
+    if (format == DEBUG_LINK_COBS_CRC) {
+        __HAL_RCC_CRC_CLK_ENABLE();
+    }
+}
+
+debug_link_format_t debug_link_get_format(void)
+{
+    return format;
+}
+
+void debug_link_set_priority(debug_link_channel_t channel, uint8_t priority)
+{
+    queues[channel].priority = priority;
+}
+
+bool debug_link_send(debug_link_channel_t channel, const uint8_t *data, uint16_t len)
+{
+    return debug_link_send_with_header(channel, NULL, 0, data, len);
+}
+
+bool debug_link_send_with_header(debug_link_channel_t channel, const uint8_t *header, uint16_t header_len,
+                                 const uint8_t *data, uint16_t len)
+{
+    link_queue_t *queue = &queues[channel];
+    uint32_t payload = (uint32_t)header_len + len;
+    uint32_t needed = frame_size(payload);
+    if (needed == 0) {
+        return false;
+    }
+
+    uint32_t start;
+    if (!frame_reserve(queue, needed, &start)) {
+        return false;
+    }
+
+    /* Interrupts stay on while the frame is written */
+    cobs_t cobs;
+    if (format == DEBUG_LINK_RAW) {
+        cobs.queue = queue;
+        cobs.pos = start + FRAME_PREFIX;
+        for (uint16_t i = 0; i < header_len; i++) {
+            frame_put(&cobs, header[i]);
+        }
+        for (uint16_t i = 0; i < len; i++) {
+            frame_put(&cobs, data[i]);
+        }
+    } else {
+        bool crc = (format == DEBUG_LINK_COBS_CRC);
+        uint8_t id = (uint8_t)channel | (crc ? DEBUG_LINK_CRC_FLAG : 0);
+        uint32_t generation = 0;
+
+        cobs_begin(&cobs, queue, start + FRAME_PREFIX);
+        if (crc) {
+            generation = crc_start();
+            crc_byte(id);
+        }
+        cobs_byte(&cobs, id);
+        for (uint16_t i = 0; i < header_len; i++) {
+            if (crc) {
+                crc_byte(header[i]);
+            }
+            cobs_byte(&cobs, header[i]);
+        }
+        for (uint16_t i = 0; i < len; i++) {
+            if (crc) {
+                crc_byte(data[i]);
+            }
+            cobs_byte(&cobs, data[i]);
+        }
+        if (crc) {
+            uint32_t value;
+            while (!crc_finish(generation, &value)) {
+                generation = crc_start();
+                crc_byte(id);
+                crc_bytes(header, header_len);
+                crc_bytes(data, len);
+            }
+            for (uint8_t i = 0; i < 4; i++) {
+                cobs_byte(&cobs, (uint8_t)(value >> (8 * i)));
+            }
+        }
+        cobs_end(&cobs);
+    }
+
+    frame_commit(queue, start, cobs.pos, payload);
+    return true;
+}
+
+bool debug_link_fits(debug_link_channel_t channel, uint16_t len)
+{
+    const link_queue_t *queue = &queues[channel];
+    uint32_t needed = frame_size(len);
+    return needed != 0 && needed <= queue->size - (queue->head - queue->tail);
+}
+
+void debug_link_poll(void)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    link_kick();
+    __set_PRIMASK(primask);
+}
+
+const debug_link_stats_t *debug_link_get_stats(debug_link_channel_t channel)
+{
+    return &queues[channel].stats;
+}
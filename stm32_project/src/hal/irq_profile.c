@@ -0,0 +1,125 @@
+/* stm32_project/src/hal/irq_profile.c */
+
+#include "hal/irq_profile.h"
+#include "hal/timestamp.h"
+#include "stm32f0xx_hal.h"
+#include <stdio.h>
+#include <string.h>
+
+static const char *const names[IRQ_PROFILE_VECTORS] = {
+    [IRQ_PROFILE_USART1]     = "usart1",
+    [IRQ_PROFILE_USART2]     = "usart2",
+    [IRQ_PROFILE_DMA1_CH2_3] = "dma1_ch2_3",
+    [IRQ_PROFILE_DMA1_CH4_5] = "dma1_ch4_5",
+    [IRQ_PROFILE_SYSTICK]    = "systick",
+};
+
+static irq_profile_stats_t stats[IRQ_PROFILE_VECTORS];
+static irq_profile_loop_t loop;
+
+/* Handler time so far, preempted handlers counted once by the outermost */
+static volatile uint32_t handler_us = 0;
+static uint32_t poll_us = 0;
+static uint32_t poll_handler_us = 0;
+
+irq_profile_entry_t irq_profile_enter(void)
+{
+    irq_profile_entry_t entry = { timestamp_us(), handler_us };
+    return entry;
+}
+
+void irq_profile_exit(irq_profile_vector_t vector, irq_profile_entry_t entry)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    uint32_t elapsed = timestamp_us() - entry.start_us;
+    uint32_t own = elapsed - (handler_us - entry.nested_us);
+    handler_us = entry.nested_us + elapsed;
+
+    irq_profile_stats_t *vector_stats = &stats[vector];
+    if (vector_stats->count == 0 || own < vector_stats->min_us) {
+        vector_stats->min_us = own;
+    }
+    if (own > vector_stats->max_us) {
+        vector_stats->max_us = own;
+    }
+    vector_stats->count++;
+    vector_stats->total_us += own;
+
+    __set_PRIMASK(primask);
+}
+
+/* SysTick reloads and pends at the same moment, so the count it has run
+   down since is the time its handler was held off */
+void irq_profile_systick(void)
+{
+    uint32_t late = SysTick->LOAD - SysTick->VAL;
+    if (late > loop.irq_latency_cycles) {
+        loop.irq_latency_cycles = late;
+    }
+}
+
+void irq_profile_poll(void)
+{
+    uint32_t now = timestamp_us();
+    uint32_t handlers = handler_us;
+
+    if (poll_us != 0) {
+        if (now - poll_us > loop.loop_max_us) {
+            loop.loop_max_us = now - poll_us;
+        }
+        if (handlers - poll_handler_us > loop.irq_per_loop_max_us) {
+            loop.irq_per_loop_max_us = handlers - poll_handler_us;
+        }
+    }
+    poll_us = now;
+    poll_handler_us = handlers;
+}
+
+void irq_profile_reset(void)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    memset(stats, 0, sizeof(stats));
+    memset(&loop, 0, sizeof(loop));
+    poll_us = 0;
+    __set_PRIMASK(primask);
+}
+
+const irq_profile_stats_t *irq_profile_get_stats(irq_profile_vector_t vector)
+{
+    return &stats[vector];
+}
+
+const irq_profile_loop_t *irq_profile_get_loop(void)
+{
+    return &loop;
+}
+
+bool irq_profile_report_line(uint8_t *cursor, char *line, uint16_t size)
+{
+    while (*cursor < IRQ_PROFILE_VECTORS) {
+        irq_profile_stats_t copy;
+        uint32_t primask = __get_PRIMASK();
+        __disable_irq();
+        copy = stats[(*cursor)++];
+        __set_PRIMASK(primask);
+
+        if (copy.count != 0) {
+            snprintf(line, size, "irq %s n %lu total %lu max %lu jitter %lu\r\n",
+                     names[*cursor - 1], (unsigned long)copy.count, (unsigned long)copy.total_us,
+                     (unsigned long)copy.max_us, (unsigned long)(copy.max_us - copy.min_us));
+            return true;
+        }
+    }
+    if (*cursor > IRQ_PROFILE_VECTORS) {
+        return false;
+    }
+
+    (*cursor)++;
+    snprintf(line, size, "irq latency %lu cycles, loop max %lu us, irq per loop max %lu us\r\n",
+             (unsigned long)loop.irq_latency_cycles, (unsigned long)loop.loop_max_us,
+             (unsigned long)loop.irq_per_loop_max_us);
+    return true;
+}
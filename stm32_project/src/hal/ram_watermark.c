@@ -0,0 +1,86 @@
+/* stm32_project/src/hal/ram_watermark.c */
+
+#include "hal/ram_watermark.h"
+#include "sysmem.h"
+#include "stm32f0xx_hal.h"
+#include <stddef.h>
+#include <stdio.h>
+
+/* Linker script symbols */
+extern uint8_t _sdata;
+extern uint8_t _edata;
+extern uint8_t _sbss;
+extern uint8_t _ebss;
+extern uint8_t _end;
+extern uint8_t _estack;
+extern uint32_t _Min_Heap_Size;
+extern uint32_t _Min_Stack_Size;
+
+static uint32_t *paint_low = NULL;  // First painted word, NULL before the paint
+
+/* First word above the heap as far as it ever grew */
+static uint32_t *heap_top(void)
+{
+    return (uint32_t *)(((uintptr_t)&_end + _sbrk_usage(1) + 3) & ~(uintptr_t)3);
+}
+
+void ram_watermark_paint(void)
+{
+    volatile uint32_t *word = heap_top();
+    uint32_t *top = (uint32_t *)(uintptr_t)(__get_MSP() & ~3u);
+
+    /* Nothing lives below the stack pointer; a handler that runs meanwhile
+       only leaves a frame the paint goes over again. The stores stay a loop
+       (volatile): a memset() call would have its own frame painted over. */
+    paint_low = (uint32_t *)word;
+    while (word < top) {
+        *word++ = RAM_WATERMARK_PATTERN;
+    }
+}
+
+void ram_watermark_snapshot(ram_watermark_snapshot_t *snapshot)
+{
+    snapshot->data = (uint32_t)(&_edata - &_sdata);
+    snapshot->bss = (uint32_t)(&_ebss - &_sbss);
+    snapshot->heap_used = (uint32_t)_sbrk_usage(0);
+    snapshot->heap_peak = (uint32_t)_sbrk_usage(1);
+    snapshot->heap_reserved = (uint32_t)(uintptr_t)&_Min_Heap_Size;
+    snapshot->stack_reserved = (uint32_t)(uintptr_t)&_Min_Stack_Size;
+    snapshot->stack_peak = 0;
+    snapshot->untouched = 0;
+    if (paint_low == NULL) {
+        return;
+    }
+
+    /* The heap may have grown into the paint since */
+    uint32_t *low = heap_top();
+    if (low < paint_low) {
+        low = paint_low;
+    }
+    uint32_t *word = low;
+    while (word < (uint32_t *)&_estack && *word == RAM_WATERMARK_PATTERN) {
+        word++;
+    }
+
+    snapshot->stack_peak = (uint32_t)(&_estack - (uint8_t *)word);
+    snapshot->untouched = (uint32_t)((uint8_t *)word - (uint8_t *)low);
+}
+
+bool ram_watermark_report_line(uint8_t *cursor, char *line, uint16_t size)
+{
+    if (*cursor != 0) {
+        return false;
+    }
+
+    ram_watermark_snapshot_t snapshot;
+    ram_watermark_snapshot(&snapshot);
+    (*cursor)++;
+
+    snprintf(line, size,
+             "ram data %lu bss %lu heap %lu/%lu peak %lu stack %lu/%lu untouched %lu\r\n",
+             (unsigned long)snapshot.data, (unsigned long)snapshot.bss,
+             (unsigned long)snapshot.heap_used, (unsigned long)snapshot.heap_reserved,
+             (unsigned long)snapshot.heap_peak, (unsigned long)snapshot.stack_peak,
+             (unsigned long)snapshot.stack_reserved, (unsigned long)snapshot.untouched);
+    return true;
+}
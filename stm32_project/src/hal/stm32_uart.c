@@ -1,231 +1,450 @@
-#include "stm32f0xx_hal.h"
+/* stm32_project/src/hal/stm32_uart.c */
+
+#include "hal/uart.h"
+#include "hal/irq_profile.h"
+#include "hal/trace.h"
 #include <string.h>
 
-/* Define the fixed RX size */
-#define FIXED_RX_SIZE 4
+/* Depth of the per-UART DMA transmit queue: a bridge span, a debug link
+   span or an AT command and its payload span at a time */
+#define UART_TX_QUEUE_SIZE 4
+
+/* Bytes buffered for uart_receive() when no RX callback is set; the
+   bridge receives both UARTs as streams instead */
+#define UART_RX_RING_SIZE 16
+
+typedef struct {
+    const uint8_t *data;
+    uint16_t len;
+    uart_tx_done_callback_t done;
+    void *ctx;
+} uart_tx_entry_t;
+
+typedef struct {
+    UART_HandleTypeDef *huart;
+    uart_tx_entry_t tx_queue[UART_TX_QUEUE_SIZE];
+    volatile uint8_t tx_head;
+    volatile uint8_t tx_count;
+    volatile bool tx_active;
+    uart_tx_observer_t tx_observer;
+    void *tx_observer_ctx;
+    uart_rx_callback_t rx_callback;
+    uint8_t rx_byte;
+    uint8_t rx_ring[UART_RX_RING_SIZE];
+    volatile uint16_t rx_head;
+    volatile uint16_t rx_tail;
+    uint8_t *rx_stream_buffer;      // Circular DMA reception, NULL when off
+    uint16_t rx_stream_size;
+    uint16_t rx_stream_pos;         // DMA write index at the last sync
+    uint32_t rx_stream_count;       // Bytes received since uart_start_rx_stream()
+    uint32_t rx_stream_base;        // Count at which the DMA last started at index 0
+    uart_rx_stream_callback_t rx_stream_callback;
+    void *rx_stream_ctx;
+} uart_port_t;
 
 /* Peripheral handles */
 UART_HandleTypeDef huart1;
+UART_HandleTypeDef huart2;
 DMA_HandleTypeDef hdma_usart1_tx;
+DMA_HandleTypeDef hdma_usart2_tx;
 DMA_HandleTypeDef hdma_usart1_rx;
+DMA_HandleTypeDef hdma_usart2_rx;
 
-/* Data buffers */
-uint8_t txData[] = "Hello via DMA USART1\r\n";  // Initial message
-uint8_t fixedRxBuffer[FIXED_RX_SIZE];            // Buffer to receive fixed number of bytes
+static uart_port_t ports[2] = {
+    [UART1_INSTANCE] = { .huart = &huart1 },
+    [UART2_INSTANCE] = { .huart = &huart2 },
+};
 
-/* Function prototypes */
-void SystemClock_Config(void);
-static void MX_GPIO_Init(void);
-static void MX_DMA_Init(void);
-static void MX_USART1_UART_Init(void);
-void Error_Handler(void);
+static uart_port_t *port_from_handle(UART_HandleTypeDef *huart)
+{
+    return (huart->Instance == USART1) ? &ports[UART1_INSTANCE] : &ports[UART2_INSTANCE];
+}
 
-int main(void)
+/* Start the next queued transfer; caller holds interrupts off or runs in the DMA ISR */
+static void uart_tx_kick(uart_port_t *port)
 {
-    /* Initialize the HAL Library */
-    HAL_Init();
+    if (port->tx_active || port->tx_count == 0) {
+        return;
+    }
 
-    /* Configure the system clock */
-    SystemClock_Config();
+    uart_tx_entry_t *entry = &port->tx_queue[port->tx_head];
+    if (HAL_UART_Transmit_DMA(port->huart, (uint8_t *)entry->data, entry->len) == HAL_OK) {
+        port->tx_active = true;
+        if (port->tx_observer) {
+            port->tx_observer(entry->data, entry->len, port->tx_observer_ctx);
+        }
+    }
+}
 
-    /* Initialize GPIO, DMA and USART1 */
-    MX_GPIO_Init();
-    MX_DMA_Init();
-    MX_USART1_UART_Init();
+static void uart_dma_tx_init(DMA_HandleTypeDef *hdma, DMA_Channel_TypeDef *channel)
+{
+    hdma->Instance = channel;
+    hdma->Init.Direction = DMA_MEMORY_TO_PERIPH;
+    hdma->Init.PeriphInc = DMA_PINC_DISABLE;
+    hdma->Init.MemInc = DMA_MINC_ENABLE;
+    hdma->Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+    hdma->Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+    hdma->Init.Mode = DMA_NORMAL;
+    hdma->Init.Priority = DMA_PRIORITY_LOW;
+    HAL_DMA_Init(hdma);
+}
 
-    /* Start DMA-based UART reception for a fixed number of bytes */
-    HAL_StatusTypeDef status = HAL_UART_Receive_DMA(&huart1, fixedRxBuffer, FIXED_RX_SIZE);
-    if (status != HAL_OK) {
-        // Check 'status' here to determine if it's HAL_BUSY or HAL_ERROR
-        Error_Handler();
-    }
+/* Reception runs ahead of transmission: a late RX request loses bytes */
+static void uart_dma_rx_init(DMA_HandleTypeDef *hdma, DMA_Channel_TypeDef *channel)
+{
+    hdma->Instance = channel;
+    hdma->Init.Direction = DMA_PERIPH_TO_MEMORY;
+    hdma->Init.PeriphInc = DMA_PINC_DISABLE;
+    hdma->Init.MemInc = DMA_MINC_ENABLE;
+    hdma->Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+    hdma->Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+    hdma->Init.Mode = DMA_CIRCULAR;
+    hdma->Init.Priority = DMA_PRIORITY_HIGH;
+    HAL_DMA_Init(hdma);
+}
 
-    /* Send the initial message over DMA TX */
-    if (HAL_UART_Transmit_DMA(&huart1, txData, sizeof(txData) - 1) != HAL_OK)
-    {
-        Error_Handler();
+/* Fold the DMA write index into the running byte count; interrupts off */
+static void rx_stream_sync(uart_port_t *port)
+{
+    if (port->rx_stream_buffer == NULL) {
+        return;
     }
 
-    /* Main loop */
-    while (1)
-    {
-        /* Nothing to do here; processing is handled via DMA callbacks */
+    uint16_t pos = port->rx_stream_size - __HAL_DMA_GET_COUNTER(port->huart->hdmarx);
+
+    if (pos >= port->rx_stream_size) {
+        pos = 0;
     }
+    port->rx_stream_count += (uint16_t)(pos + port->rx_stream_size - port->rx_stream_pos) % port->rx_stream_size;
+    port->rx_stream_pos = pos;
 }
 
-/* USART1 initialization function */
-static void MX_USART1_UART_Init(void)
+static HAL_StatusTypeDef rx_stream_restart(uart_port_t *port)
 {
-    huart1.Instance = USART1;
-    huart1.Init.BaudRate = 115200;
-    huart1.Init.WordLength = UART_WORDLENGTH_8B;
-    huart1.Init.StopBits = UART_STOPBITS_1;
-    huart1.Init.Parity = UART_PARITY_NONE;
-    huart1.Init.Mode = UART_MODE_TX_RX;
-    huart1.Init.HwFlowCtl = UART_HWCONTROL_NONE;
-    huart1.Init.OverSampling = UART_OVERSAMPLING_16;
-    if (HAL_UART_Init(&huart1) != HAL_OK)
-    {
-        Error_Handler();
-    }
+    port->rx_stream_base = port->rx_stream_count;
+    port->rx_stream_pos = 0;
+    return HAL_UARTEx_ReceiveToIdle_DMA(port->huart, port->rx_stream_buffer, port->rx_stream_size);
 }
 
-/* DMA initialization function */
-static void MX_DMA_Init(void)
+HAL_StatusTypeDef uart_init(uart_instance_t instance)
 {
-    /* Enable DMA1 clock */
+    uart_port_t *port = &ports[instance];
+    UART_HandleTypeDef *huart = port->huart;
+
     __HAL_RCC_DMA1_CLK_ENABLE();
 
-    /* Configure DMA for USART1_TX on DMA1_Channel2 */
-    hdma_usart1_tx.Instance = DMA1_Channel2;
-    hdma_usart1_tx.Init.Direction = DMA_MEMORY_TO_PERIPH;
-    hdma_usart1_tx.Init.PeriphInc = DMA_PINC_DISABLE;
-    hdma_usart1_tx.Init.MemInc = DMA_MINC_ENABLE;
-    hdma_usart1_tx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
-    hdma_usart1_tx.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
-    hdma_usart1_tx.Init.Mode = DMA_NORMAL;
-    hdma_usart1_tx.Init.Priority = DMA_PRIORITY_LOW;
-    if (HAL_DMA_Init(&hdma_usart1_tx) != HAL_OK)
-    {
-        Error_Handler();
-    }
-    __HAL_LINKDMA(&huart1, hdmatx, hdma_usart1_tx);
-
-    /* Configure DMA for USART1_RX on DMA1_Channel3 in NORMAL mode for fixed reception */
-    hdma_usart1_rx.Instance = DMA1_Channel3;
-    hdma_usart1_rx.Init.Direction = DMA_PERIPH_TO_MEMORY;
-    hdma_usart1_rx.Init.PeriphInc = DMA_PINC_DISABLE;
-    hdma_usart1_rx.Init.MemInc = DMA_MINC_ENABLE;
-    hdma_usart1_rx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
-    hdma_usart1_rx.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
-    hdma_usart1_rx.Init.Mode = DMA_NORMAL; // Normal mode is used so that we get an Rx complete callback after FIXED_RX_SIZE bytes
-    hdma_usart1_rx.Init.Priority = DMA_PRIORITY_LOW;
-    if (HAL_DMA_Init(&hdma_usart1_rx) != HAL_OK)
-    {
-        Error_Handler();
-    }
-    __HAL_LINKDMA(&huart1, hdmarx, hdma_usart1_rx);
-
-    /* Configure and enable DMA interrupt for Channels 2 & 3 if needed */
-    HAL_NVIC_SetPriority(DMA1_Channel2_3_IRQn, 0, 0);
-    HAL_NVIC_EnableIRQ(DMA1_Channel2_3_IRQn);
-}
-
-/* GPIO initialization function */
-static void MX_GPIO_Init(void)
+    huart->Instance = (instance == UART1_INSTANCE) ? USART1 : USART2;
+    huart->Init.BaudRate = (instance == UART1_INSTANCE) ? UART1_BAUDRATE : UART2_BAUDRATE;
+    huart->Init.WordLength = UART_WORDLENGTH_8B;
+    huart->Init.StopBits = UART_STOPBITS_1;
+    huart->Init.Parity = UART_PARITY_NONE;
+    huart->Init.Mode = UART_MODE_TX_RX;
+    huart->Init.HwFlowCtl = UART_HWCONTROL_NONE;
+    huart->Init.OverSampling = UART_OVERSAMPLING_16;
+    if (HAL_UART_Init(huart) != HAL_OK) {
+        return HAL_ERROR;
+    }
+
+    port->tx_head = 0;
+    port->tx_count = 0;
+    port->tx_active = false;
+    port->rx_head = 0;
+    port->rx_tail = 0;
+    port->rx_stream_buffer = NULL;
+
+    return HAL_UART_Receive_IT(huart, &port->rx_byte, 1);
+}
+
+HAL_StatusTypeDef uart_send_dma(uart_instance_t instance, const uint8_t *data, uint16_t len)
 {
-    GPIO_InitTypeDef GPIO_InitStruct = {0};
+    return uart_send_queued(instance, data, len, NULL, NULL);
+}
 
-    /* Enable GPIOA clock (for PA9 and PA10) */
-    __HAL_RCC_GPIOA_CLK_ENABLE();
+HAL_StatusTypeDef uart_send_queued(uart_instance_t instance, const uint8_t *data, uint16_t len,
+                                   uart_tx_done_callback_t done, void *ctx)
+{
+    uart_port_t *port = &ports[instance];
 
-    /* Configure USART1 TX (PA9) and RX (PA10) pins */
-    GPIO_InitStruct.Pin = GPIO_PIN_9 | GPIO_PIN_10;
-    GPIO_InitStruct.Mode = GPIO_MODE_AF_PP;
-    GPIO_InitStruct.Pull = GPIO_PULLUP;
-    GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_HIGH;
-    GPIO_InitStruct.Alternate = GPIO_AF1_USART1;
-    HAL_GPIO_Init(GPIOA, &GPIO_InitStruct);
+    if (len == 0) {
+        return HAL_ERROR;
+    }
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    if (port->tx_count >= UART_TX_QUEUE_SIZE) {
+        __set_PRIMASK(primask);
+        return HAL_BUSY;
+    }
+
+    uart_tx_entry_t *entry = &port->tx_queue[(port->tx_head + port->tx_count) % UART_TX_QUEUE_SIZE];
+    entry->data = data;
+    entry->len = len;
+    entry->done = done;
+    entry->ctx = ctx;
+    port->tx_count++;
+    uart_tx_kick(port);
+
+    __set_PRIMASK(primask);
+    return HAL_OK;
 }
 
-/* System Clock Configuration */
-void SystemClock_Config(void)
+uint8_t uart_tx_free_slots(uart_instance_t instance)
 {
-    RCC_OscInitTypeDef RCC_OscInitStruct = {0};
-    RCC_ClkInitTypeDef RCC_ClkInitStruct = {0};
+    return UART_TX_QUEUE_SIZE - ports[instance].tx_count;
+}
 
-    __HAL_RCC_PWR_CLK_ENABLE();
+void uart_set_tx_observer(uart_instance_t instance, uart_tx_observer_t observer, void *ctx)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    ports[instance].tx_observer = observer;
+    ports[instance].tx_observer_ctx = ctx;
+    __set_PRIMASK(primask);
+}
 
-    RCC_OscInitStruct.OscillatorType = RCC_OSCILLATORTYPE_HSI;
-    RCC_OscInitStruct.HSIState       = RCC_HSI_ON;
-    RCC_OscInitStruct.HSICalibrationValue = RCC_HSICALIBRATION_DEFAULT;
-    RCC_OscInitStruct.PLL.PLLState   = RCC_PLL_NONE;
-    if (HAL_RCC_OscConfig(&RCC_OscInitStruct) != HAL_OK)
-    {
-        Error_Handler();
+void uart_set_rx_callback(uart_instance_t instance, uart_rx_callback_t callback)
+{
+    ports[instance].rx_callback = callback;
+}
+
+bool uart_receive(uart_instance_t instance, uint8_t *data)
+{
+    uart_port_t *port = &ports[instance];
+
+    if (port->rx_tail == port->rx_head) {
+        return false;
     }
 
-    RCC_ClkInitStruct.ClockType = RCC_CLOCKTYPE_HCLK | RCC_CLOCKTYPE_SYSCLK | RCC_CLOCKTYPE_PCLK1;
-    RCC_ClkInitStruct.SYSCLKSource = RCC_SYSCLKSOURCE_HSI;
-    RCC_ClkInitStruct.AHBCLKDivider = RCC_SYSCLK_DIV1;
-    RCC_ClkInitStruct.APB1CLKDivider = RCC_HCLK_DIV1;
-    if (HAL_RCC_ClockConfig(&RCC_ClkInitStruct, FLASH_LATENCY_0) != HAL_OK)
-    {
-        Error_Handler();
+    *data = port->rx_ring[port->rx_tail];
+    port->rx_tail = (port->rx_tail + 1) % UART_RX_RING_SIZE;
+    return true;
+}
+
+HAL_StatusTypeDef uart_start_receive_dma(uart_instance_t instance, uint8_t *buffer, uint16_t len)
+{
+    UART_HandleTypeDef *huart = ports[instance].huart;
+
+    /* The caller takes over reception; stop the byte-wise interrupt path */
+    HAL_UART_AbortReceive(huart);
+    return HAL_UART_Receive_DMA(huart, buffer, len);
+}
+
+HAL_StatusTypeDef uart_start_rx_stream(uart_instance_t instance, uint8_t *buffer, uint16_t size,
+                                      uart_rx_stream_callback_t callback, void *ctx)
+{
+    uart_port_t *port = &ports[instance];
+
+    if (size == 0) {
+        return HAL_ERROR;
     }
+
+    /* The stream takes over reception; stop the byte-wise interrupt path */
+    HAL_UART_AbortReceive(port->huart);
+    port->rx_stream_buffer = buffer;
+    port->rx_stream_size = size;
+    port->rx_stream_count = 0;
+    port->rx_stream_callback = callback;
+    port->rx_stream_ctx = ctx;
+    return rx_stream_restart(port);
 }
-void USART1_IRQHandler(void)
+
+uint32_t uart_rx_stream_count(uart_instance_t instance)
 {
-    HAL_UART_IRQHandler(&huart1);
+    uart_port_t *port = &ports[instance];
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    rx_stream_sync(port);
+    uint32_t count = port->rx_stream_count;
+
+    __set_PRIMASK(primask);
+    return count;
 }
 
-/* DMA interrupt handler for Channels 2 and 3 */
-void DMA1_Channel2_3_IRQHandler(void)
+uint16_t uart_rx_stream_peek(uart_instance_t instance, uint32_t *cursor, const uint8_t **data, uint32_t *lost)
 {
-    HAL_DMA_IRQHandler(&hdma_usart1_tx);
-    HAL_DMA_IRQHandler(&hdma_usart1_rx);
+    uart_port_t *port = &ports[instance];
+
+    if (port->rx_stream_buffer == NULL) {
+        return 0;
+    }
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    rx_stream_sync(port);
+    uint32_t count = port->rx_stream_count;
+    uint32_t base = port->rx_stream_base;
+
+    __set_PRIMASK(primask);
+
+    /* Oldest byte still in the buffer: a full lap back, or the last restart */
+    uint32_t oldest = (count - base > port->rx_stream_size) ? count - port->rx_stream_size : base;
+    if ((int32_t)(*cursor - oldest) < 0) {
+        *lost += oldest - *cursor;
+        *cursor = oldest;
+    }
+
+    uint16_t index = (uint16_t)((*cursor - base) % port->rx_stream_size);
+    uint32_t len = count - *cursor;
+    if (len > (uint32_t)(port->rx_stream_size - index)) {
+        len = port->rx_stream_size - index;
+    }
+    *data = port->rx_stream_buffer + index;
+    return (uint16_t)len;
 }
 
 /* Override the UART MSP Initialization function */
-void HAL_UART_MspInit(UART_HandleTypeDef* uartHandle)
+void HAL_UART_MspInit(UART_HandleTypeDef *uartHandle)
 {
     GPIO_InitTypeDef GPIO_InitStruct = {0};
-    if(uartHandle->Instance == USART1)
-    {
+
+    __HAL_RCC_GPIOA_CLK_ENABLE();
+    GPIO_InitStruct.Mode = GPIO_MODE_AF_PP;
+    GPIO_InitStruct.Pull = GPIO_PULLUP;
+    GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_HIGH;
+
+    if (uartHandle->Instance == USART1) {
+        /* USART1 <-> ESP32: PA9 TX, PA10 RX, TX on DMA1 channel 2, RX on channel 3 */
         __HAL_RCC_USART1_CLK_ENABLE();
-        __HAL_RCC_GPIOA_CLK_ENABLE();
         GPIO_InitStruct.Pin = GPIO_PIN_9 | GPIO_PIN_10;
-        GPIO_InitStruct.Mode = GPIO_MODE_AF_PP;
-        GPIO_InitStruct.Pull = GPIO_PULLUP;
-        GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_HIGH;
         GPIO_InitStruct.Alternate = GPIO_AF1_USART1;
         HAL_GPIO_Init(GPIOA, &GPIO_InitStruct);
+
+        uart_dma_tx_init(&hdma_usart1_tx, DMA1_Channel2);
+        __HAL_LINKDMA(uartHandle, hdmatx, hdma_usart1_tx);
+        uart_dma_rx_init(&hdma_usart1_rx, DMA1_Channel3);
+        __HAL_LINKDMA(uartHandle, hdmarx, hdma_usart1_rx);
+
+        HAL_NVIC_SetPriority(DMA1_Channel2_3_IRQn, 0, 0);
+        HAL_NVIC_EnableIRQ(DMA1_Channel2_3_IRQn);
+        HAL_NVIC_SetPriority(USART1_IRQn, 1, 0);
+        HAL_NVIC_EnableIRQ(USART1_IRQn);
+    } else if (uartHandle->Instance == USART2) {
+        /* USART2 <-> PC: PA2 TX, PA3 RX, TX on DMA1 channel 4, RX on channel 5 */
+        __HAL_RCC_USART2_CLK_ENABLE();
+        GPIO_InitStruct.Pin = GPIO_PIN_2 | GPIO_PIN_3;
+        GPIO_InitStruct.Alternate = GPIO_AF1_USART2;
+        HAL_GPIO_Init(GPIOA, &GPIO_InitStruct);
+
+        uart_dma_tx_init(&hdma_usart2_tx, DMA1_Channel4);
+        __HAL_LINKDMA(uartHandle, hdmatx, hdma_usart2_tx);
+        uart_dma_rx_init(&hdma_usart2_rx, DMA1_Channel5);
+        __HAL_LINKDMA(uartHandle, hdmarx, hdma_usart2_rx);
+
+        HAL_NVIC_SetPriority(DMA1_Channel4_5_IRQn, 0, 0);
+        HAL_NVIC_EnableIRQ(DMA1_Channel4_5_IRQn);
+        HAL_NVIC_SetPriority(USART2_IRQn, 1, 0);
+        HAL_NVIC_EnableIRQ(USART2_IRQn);
     }
 }
 
-/* Callback function executed when fixed RX transfer is complete */
+void USART1_IRQHandler(void)
+{
+    irq_profile_entry_t entry = irq_profile_enter();
+    HAL_UART_IRQHandler(&huart1);
+    irq_profile_exit(IRQ_PROFILE_USART1, entry);
+}
+
+void USART2_IRQHandler(void)
+{
+    irq_profile_entry_t entry = irq_profile_enter();
+    HAL_UART_IRQHandler(&huart2);
+    irq_profile_exit(IRQ_PROFILE_USART2, entry);
+}
+
+/* DMA interrupt handler for Channels 2 and 3 (USART1) */
+void DMA1_Channel2_3_IRQHandler(void)
+{
+    irq_profile_entry_t entry = irq_profile_enter();
+    HAL_DMA_IRQHandler(&hdma_usart1_tx);
+    HAL_DMA_IRQHandler(&hdma_usart1_rx);
+    irq_profile_exit(IRQ_PROFILE_DMA1_CH2_3, entry);
+}
+
+/* DMA interrupt handler for Channels 4 and 5 (USART2) */
+void DMA1_Channel4_5_IRQHandler(void)
+{
+    irq_profile_entry_t entry = irq_profile_enter();
+    HAL_DMA_IRQHandler(&hdma_usart2_tx);
+    HAL_DMA_IRQHandler(&hdma_usart2_rx);
+    irq_profile_exit(IRQ_PROFILE_DMA1_CH4_5, entry);
+}
+
+/* Callback function executed when a byte has been received */
 void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart)
 {
-    if (huart->Instance == USART1)
-    {
-        /* Echo back the received fixed number of bytes */
-        if (HAL_UART_Transmit_DMA(&huart1, fixedRxBuffer, FIXED_RX_SIZE) != HAL_OK)
-        {
-            Error_Handler();
-        }
+    uart_port_t *port = port_from_handle(huart);
 
-        /* Restart the DMA reception for the next fixed RX_SIZE bytes */
-        if (HAL_UART_Receive_DMA(&huart1, fixedRxBuffer, FIXED_RX_SIZE) != HAL_OK)
-        {
-            Error_Handler();
+    if (port->rx_callback) {
+        port->rx_callback(port->rx_byte);
+    } else {
+        uint16_t next = (port->rx_head + 1) % UART_RX_RING_SIZE;
+        if (next != port->rx_tail) {
+            port->rx_ring[port->rx_head] = port->rx_byte;
+            port->rx_head = next;
         }
     }
+
+    HAL_UART_Receive_IT(huart, &port->rx_byte, 1);
 }
 
-/* Callback function executed when TX transfer is complete */
-void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart)
+/* Half/full buffer or line idle during circular DMA reception */
+void HAL_UARTEx_RxEventCallback(UART_HandleTypeDef *huart, uint16_t Size)
 {
-    /* Optionally, you can add code here if you need to do something when TX completes */
+    uart_port_t *port = port_from_handle(huart);
+    (void)Size;
+
+    if (port->rx_stream_buffer == NULL) {
+        return;
+    }
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    rx_stream_sync(port);
+    __set_PRIMASK(primask);
+
+    if (port->rx_stream_callback) {
+        port->rx_stream_callback(port->rx_stream_ctx);
+    }
 }
 
-/* Simple error handler */
-void Error_Handler(void)
+/* Callback function executed when a queued DMA transfer is complete */
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart)
 {
-    while (1)
-    {
-        /* Stay here in case of error */
+    uart_port_t *port = port_from_handle(huart);
+    uart_tx_entry_t done = port->tx_queue[port->tx_head];
+
+    port->tx_head = (port->tx_head + 1) % UART_TX_QUEUE_SIZE;
+    port->tx_count--;
+    port->tx_active = false;
+    if (huart->Instance == USART1) {
+        /* USART2 carries the trace itself */
+        TRACE("uart1 tx done, %u bytes", done.len);
+    }
+
+    if (done.done) {
+        done.done(done.ctx);
     }
+    uart_tx_kick(port);
 }
-/* Optional SysTick_Handler if needed for HAL_Delay() usage
-   (Here, we don't call HAL_Delay, so we might not need it.)
-   Uncomment if needed:
 
-void SysTick_Handler(void)
+/* Re-arm reception after overrun/framing errors */
+void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart)
 {
-    HAL_IncTick();
+    uart_port_t *port = port_from_handle(huart);
+    TRACE("uart%u error 0x%x", (unsigned)(port - ports) + 1, huart->ErrorCode);
+
+    if (port->rx_stream_buffer == NULL) {
+        HAL_UART_Receive_IT(huart, &port->rx_byte, 1);
+        return;
+    }
+
+    /* The HAL stopped the DMA; keep the bytes it wrote and restart at index 0 */
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    rx_stream_sync(port);
+    rx_stream_restart(port);
+    __set_PRIMASK(primask);
 }
-*/
-void SysTick_Handler(void)
-{
-    HAL_IncTick();
-}
\ No newline at end of file
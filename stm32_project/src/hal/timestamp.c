@@ -0,0 +1,92 @@
+/* stm32_project/src/hal/timestamp.c */
+
+#include "hal/timestamp.h"
+#include "stm32f0xx_hal.h"
+#include <stdbool.h>
+
+static bool running = false;
+
+#ifndef TIMESTAMP_SYSTICK
+
+void timestamp_init(void)
+{
+    /* Timer kernel clock is PCLK, doubled when the APB is divided */
+    uint32_t clock = HAL_RCC_GetPCLK1Freq();
+    if ((RCC->CFGR & RCC_CFGR_PPRE) != RCC_CFGR_PPRE_DIV1) {
+        clock *= 2;
+    }
+
+    __HAL_RCC_TIM3_CLK_ENABLE();
+    __HAL_RCC_TIM15_CLK_ENABLE();
+
+    /* TIM3: microseconds, TRGO on its update event. The forced update loads the
+       prescaler while TIM15 is still stopped, so it is not counted. */
+    TIM3->CR1 = 0;
+    TIM3->PSC = clock / 1000000 - 1;
+    TIM3->ARR = 0xFFFF;
+    TIM3->CR2 = TIM_CR2_MMS_1;
+    TIM3->EGR = TIM_EGR_UG;
+    TIM3->SR = 0;
+    TIM3->CNT = 0;
+
+    /* TIM15: external clock mode 1 from ITR1, which is TIM3's TRGO */
+    TIM15->CR1 = 0;
+    TIM15->PSC = 0;
+    TIM15->ARR = 0xFFFF;
+    TIM15->SMCR = TIM_SMCR_TS_0 | TIM_SMCR_SMS_2 | TIM_SMCR_SMS_1 | TIM_SMCR_SMS_0;
+    TIM15->CNT = 0;
+    TIM15->CR1 = TIM_CR1_CEN;
+
+    TIM3->CR1 = TIM_CR1_CEN;
+    running = true;
+}
+
+uint32_t timestamp_us(void)
+{
+    uint32_t high;
+    uint32_t low;
+
+    if (!running) {
+        return 0;
+    }
+
+    /* TIM15 steps a few timer clocks after TIM3 wraps to 0, and TIM3 stays
+       at 0 for a whole microsecond: past 0 the high half is settled */
+    do {
+        high = TIM15->CNT;
+        low = TIM3->CNT;
+    } while (low == 0 || high != TIM15->CNT);
+
+    return (high << 16) | low;
+}
+
+#else
+
+void timestamp_init(void)
+{
+    running = true;
+}
+
+uint32_t timestamp_us(void)
+{
+    if (!running) {
+        return 0;
+    }
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    uint32_t ms = HAL_GetTick();
+    uint32_t val = SysTick->VAL;
+
+    /* With interrupts off a wrap shows as a pending SysTick */
+    if (SCB->ICSR & SCB_ICSR_PENDSTSET_Msk) {
+        ms++;
+        val = SysTick->VAL;
+    }
+
+    __set_PRIMASK(primask);
+    return ms * 1000 + ((SysTick->LOAD - val) * 1000) / (SysTick->LOAD + 1);
+}
+
+#endif
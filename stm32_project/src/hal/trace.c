@@ -0,0 +1,111 @@
+/* stm32_project/src/hal/trace.c */
+
+#include "hal/trace.h"
+#include "hal/debug_link.h"
+#include "hal/timestamp.h"
+#include "stm32f0xx_hal.h"
+
+#if TRACE_ENABLED
+
+#define RING_MASK   (TRACE_RING_WORDS - 1)
+#define RECORD_HEAD 2               // Id word and time word
+
+/* Record words per trace frame, leaving room for a second frame in the queue */
+#define FRAME_WORDS ((DEBUG_LINK_TRACE_SIZE / 2 - sizeof(trace_frame_header_t) - 16) / 4)
+
+#if (TRACE_RING_WORDS & RING_MASK) != 0
+#error "TRACE_RING_WORDS must be a power of two"
+#endif
+
+static uint32_t ring[TRACE_RING_WORDS];
+static volatile uint32_t head = 0;  // Words written
+static volatile uint32_t tail = 0;  // Words sent
+static bool enabled = false;
+static trace_stats_t stats;
+static uint32_t frame[FRAME_WORDS];
+
+void trace_init(void)
+{
+    head = 0;
+    tail = 0;
+    enabled = true;
+}
+
+/* Kept short for interrupt context */
+void trace_write(uint32_t id, uint32_t argc, uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3)
+{
+    if (!enabled) {
+        return;
+    }
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    uint32_t now = timestamp_us();
+    uint32_t at = head;
+    uint32_t used = at - tail;
+    if (used + RECORD_HEAD + argc > TRACE_RING_WORDS) {
+        stats.dropped++;
+        __set_PRIMASK(primask);
+        return;
+    }
+
+    ring[at++ & RING_MASK] = (id & TRACE_ID_MASK) | (argc << TRACE_ARGS_SHIFT);
+    ring[at++ & RING_MASK] = now;
+    switch (argc) {
+    case 4: ring[(at + 3) & RING_MASK] = a3; /* fall through */
+    case 3: ring[(at + 2) & RING_MASK] = a2; /* fall through */
+    case 2: ring[(at + 1) & RING_MASK] = a1; /* fall through */
+    case 1: ring[at & RING_MASK] = a0; /* fall through */
+    default: break;
+    }
+    head = at + argc;
+
+    stats.records++;
+    used += RECORD_HEAD + argc;
+    if (used > stats.peak_words) {
+        stats.peak_words = (uint16_t)used;
+    }
+    __set_PRIMASK(primask);
+}
+
+void trace_poll(void)
+{
+    if (!enabled || debug_link_get_format() == DEBUG_LINK_RAW) {
+        return;
+    }
+
+    while (tail != head) {
+        /* Whole records only; head only moves past complete ones */
+        uint32_t from = tail;
+        uint32_t end = head;
+        uint16_t words = 0;
+        while (from != end) {
+            uint32_t size = RECORD_HEAD + (ring[from & RING_MASK] >> TRACE_ARGS_SHIFT);
+            if (words + size > FRAME_WORDS) {
+                break;
+            }
+            for (uint32_t i = 0; i < size; i++) {
+                frame[words++] = ring[(from + i) & RING_MASK];
+            }
+            from += size;
+        }
+
+        trace_frame_header_t header = {
+            .now_us = timestamp_us(),
+            .dropped = stats.dropped,
+        };
+        if (!debug_link_send_with_header(DEBUG_LINK_TRACE, (const uint8_t *)&header, sizeof(header),
+                                         (const uint8_t *)frame, words * 4)) {
+            return;     /* Queue full; the records stay in the ring */
+        }
+        tail = from;
+    }
+}
+
+const trace_stats_t *trace_get_stats(void)
+{
+    return &stats;
+}
+
+#endif // TRACE_ENABLED
@@ -1,28 +1,89 @@
 /* main.c */
 
 #include "hal/uart.h"
+#include "hal/bridge.h"
+#include "hal/debug_link.h"
+#include "hal/irq_profile.h"
+#include "hal/ram_watermark.h"
+#include "hal/timestamp.h"
+#include "hal/trace.h"
+#include "at/core.h"
+#include "at/boot.h"
+#include "at/config.h"
+#include "at/latency.h"
+#include "at/traffic.h"
+#include "at/tcp.h"
+#include "at/wifi.h"
 #include "stm32f0xx_hal.h"
 #include <string.h>
 #include <stdio.h> // For snprintf
 
+/* Optional ESP EN line, e.g. -D ESP_EN_PORT=GPIOA -D ESP_EN_PIN=GPIO_PIN_8.
+   Without it the ESP is not reset and boot relies on "ready" or the AT probe. */
+#if defined(ESP_EN_PORT) && defined(ESP_EN_PIN)
+#define ESP_HAS_EN_LINE 1
+#endif
+
+/* By default the PC is a client of the AT core, sharing the ESP with the
+   firmware. -D BRIDGE_TRANSPARENT bridges raw bytes instead, -D BRIDGE_CAPTURE
+   sends timestamped records of the ESP link (scripts/bridge_capture.py). */
+#if !defined(BRIDGE_TRANSPARENT) && !defined(BRIDGE_CAPTURE)
+#define PC_IS_AT_CLIENT 1
+#endif
+
+/* -D DEBUG_LINK_FRAMED: everything on USART2 goes out as COBS frames with a
+   channel id and CRC, split again by scripts/debug_link.py */
+#ifdef DEBUG_LINK_FRAMED
+#define DEBUG_LINK_FORMAT DEBUG_LINK_COBS_CRC
+#else
+#define DEBUG_LINK_FORMAT DEBUG_LINK_RAW
+#endif
+
+/* "115200,8,1,0,0" for the ESP link rate */
+#define STR(x) #x
+#define ESP_UART_CONFIG(baud) STR(baud) ",8,1,0,0"
+
+/* ESP settings checked at every boot; only the ones that differ are sent.
+   AT+SYSSTORE=1 comes first so the changes persist and later boots send nothing. */
+static const CONFIG_Entry esp_config[] = {
+    { "AT+SYSSTORE?\r\n", "+SYSSTORE:", "1", "AT+SYSSTORE=1\r\n" },
+    { "AT+CWMODE?\r\n", "+CWMODE:", "1", "AT+CWMODE=1\r\n" },
+    TCP_CONFIG_MUX,
+    { "AT+CIPRECVMODE?\r\n", "+CIPRECVMODE:", "0", "AT+CIPRECVMODE=0\r\n" },
+    { "AT+UART_DEF?\r\n", "+UART_DEF:", ESP_UART_CONFIG(UART1_BAUDRATE),
+      "AT+UART_DEF=" ESP_UART_CONFIG(UART1_BAUDRATE) "\r\n" },
+};
+
+/* esp_config followed by the traffic profile for the registered handlers */
+#define ESP_CONFIG_COUNT (sizeof(esp_config) / sizeof(esp_config[0]))
+static CONFIG_Entry boot_config[ESP_CONFIG_COUNT + TRAFFIC_PROFILE_ENTRIES];
+
 /* Function prototypes */
 void SystemClock_Config(void);
 static void MX_GPIO_Init(void);
-
-/* Callback function prototypes */
-void uart1_rx_handler(uint8_t received_byte);
-void uart2_rx_handler(uint8_t received_byte);
-
-/* Function to send AT commands */
-void send_at_command(const char *command);
+static void esp_ready(AT_Result result, void *ctx);
+static void esp_configured(AT_Result result, void *ctx);
+static void report_boot(void);
+static void esp_received(const uint8_t *data, uint16_t len, void *ctx);
+#ifdef PC_IS_AT_CLIENT
+static void pc_received(const uint8_t *data, uint16_t len, void *ctx);
+static void pc_output(const uint8_t *data, uint16_t len, void *ctx);
+static void report_poll(void);
+static bool pc_local_command(const char *line, void *ctx);
+#endif
 
 int main(void)
 {
+    /* Mark the free RAM before anything runs deep, for the "#ram" high-water marks */
+    ram_watermark_paint();
+
     /* Initialize the HAL library */
     HAL_Init();
 
     /* Configure the system clock */
     SystemClock_Config();
+    timestamp_init();
+    BOOT_Mark(BOOT_PHASE_CLOCK);
 
     /* Initialize GPIO (for LED on PA5) */
     MX_GPIO_Init();
@@ -44,25 +105,139 @@ int main(void)
         }
     }
 
-    /* Set the UART receive callbacks */
-    uart_set_rx_callback(UART1_INSTANCE, uart1_rx_handler);
-    uart_set_rx_callback(UART2_INSTANCE, uart2_rx_handler);
+    debug_link_init(DEBUG_LINK_FORMAT);
+    trace_init();
 
-    /* Send an initial AT command to ESP32 via USART1 */
-    send_at_command("AT\r\n");
+    /* Bridge PC <-> ESP by DMA; the AT core reads along on the ESP side */
+    bridge_set_tap(BRIDGE_ESP_TO_PC, esp_received, NULL);
+    if (bridge_init() != HAL_OK) {
+        while (1) {
+            HAL_GPIO_TogglePin(GPIOA, GPIO_PIN_5);
+            HAL_Delay(100);
+        }
+    }
+#if defined(PC_IS_AT_CLIENT)
+    bridge_set_tap(BRIDGE_PC_TO_ESP, pc_received, NULL);
+    bridge_set_mode(BRIDGE_MODE_ARBITRATED);
+#elif defined(BRIDGE_CAPTURE)
+    bridge_set_mode(BRIDGE_MODE_CAPTURE);
+#endif
+    BOOT_Mark(BOOT_PHASE_UART);
+
+    /* Wait for the ESP by event rather than a fixed delay */
+    AT_Init();
+#ifdef PC_IS_AT_CLIENT
+    LATENCY_Init();
+    AT_AttachClient(pc_output, NULL);
+    AT_SetLocalCommandHandler(pc_local_command, NULL);
+#endif
+    BOOT_Init();
+    CONFIG_Init();
+    WIFI_Init();
+#ifdef ESP_HAS_EN_LINE
+    BOOT_Config esp_en_config = { ESP_EN_PORT, ESP_EN_PIN };
+    BOOT_Start(&esp_en_config, esp_ready, NULL);
+#else
+    BOOT_Start(NULL, esp_ready, NULL);
+#endif
 
     /* Main loop */
+    uint32_t led_tick = HAL_GetTick();
     while (1)
     {
-        /* You can toggle LED or periodically send AT commands here */
+        irq_profile_poll();
+        bridge_poll();
+        trace_poll();
+        debug_link_poll();
+#ifdef PC_IS_AT_CLIENT
+        report_poll();
+#endif
+        BOOT_Poll();
+        AT_Poll();
+        TCP_Poll();
+
+        /* Heartbeat LED */
+        if (HAL_GetTick() - led_tick >= 1000) {
+            led_tick = HAL_GetTick();
             HAL_GPIO_TogglePin(GPIOA, GPIO_PIN_5);
-            HAL_Delay(1000);
+        }
+    }
+}
+
+static void esp_ready(AT_Result result, void *ctx)
+{
+    (void)ctx;
+    if (result != AT_RESULT_OK) {
+        report_boot();
+        return;
+    }
+
+    TCP_Init();
+    AT_NegotiateEcho();
+
+    memcpy(boot_config, esp_config, sizeof(esp_config));
+    uint8_t count = ESP_CONFIG_COUNT + TRAFFIC_BuildProfile(&boot_config[ESP_CONFIG_COUNT], TRAFFIC_PROFILE_ENTRIES);
+    CONFIG_Apply(boot_config, count, esp_configured, NULL);
+}
+
+#if defined(WIFI_SSID) && defined(WIFI_PASSWORD)
+static void wifi_joined(AT_Result result, void *ctx)
+{
+    (void)ctx;
+    if (result == AT_RESULT_OK) {
+        BOOT_Mark(BOOT_PHASE_WIFI_UP);
+    }
+    report_boot();
+}
+#endif
+
+static void esp_configured(AT_Result result, void *ctx)
+{
+    (void)ctx;
+    if (result == AT_RESULT_OK) {
+        BOOT_Mark(BOOT_PHASE_CONFIGURED);
+    }
+    TRAFFIC_Start();
+
+#if defined(WIFI_SSID) && defined(WIFI_PASSWORD)
+    static const WIFI_Config wifi_config = {
+        .ssid = WIFI_SSID,
+        .password = WIFI_PASSWORD,
+        .static_ip = true,
+        .reconnect_interval_s = 1,
+    };
+    if (WIFI_Connect(&wifi_config, wifi_joined, NULL)) {
+        return;
+    }
+#endif
+    report_boot();
+}
+
+/* Send the boot timeline to the PC, e.g. "boot ms: clock 1 uart 2 ready 312 config 318 wifi 1490" */
+static void report_boot(void)
+{
+    static const char *const names[BOOT_PHASE_COUNT] = { "clock", "uart", "ready", "config", "wifi" };
+    const BOOT_Timeline *timeline = BOOT_GetTimeline();
+    char boot_report[96];
+    int n = snprintf(boot_report, sizeof(boot_report), "boot ms:");
+
+    for (uint8_t i = 0; i < BOOT_PHASE_COUNT && n < (int)sizeof(boot_report); i++) {
+        if (timeline->reached & (1u << i)) {
+            n += snprintf(boot_report + n, sizeof(boot_report) - n, " %s %lu", names[i],
+                          (unsigned long)timeline->ms[i]);
+        } else {
+            n += snprintf(boot_report + n, sizeof(boot_report) - n, " %s -", names[i]);
+        }
+    }
+    if (n < (int)sizeof(boot_report) - 2) {
+        n += snprintf(boot_report + n, sizeof(boot_report) - n, "\r\n");
+        bridge_write((const uint8_t *)boot_report, (uint16_t)n);
     }
 }
 
 /**
   * @brief  System Clock Configuration
-  *         HSI = 8 MHz, no PLL, SysClk = 8 MHz.
+  *         HSI/2 * 12 = 48 MHz SysClk, so the UARTs reach 921600 baud.
   */
 void SystemClock_Config(void)
 {
@@ -76,17 +251,20 @@ void SystemClock_Config(void)
     RCC_OscInitStruct.OscillatorType       = RCC_OSCILLATORTYPE_HSI;
     RCC_OscInitStruct.HSIState            = RCC_HSI_ON;
     RCC_OscInitStruct.HSICalibrationValue = RCC_HSICALIBRATION_DEFAULT;
-    RCC_OscInitStruct.PLL.PLLState        = RCC_PLL_NONE; // No PLL
+    RCC_OscInitStruct.PLL.PLLState        = RCC_PLL_ON;
+    RCC_OscInitStruct.PLL.PLLSource       = RCC_PLLSOURCE_HSI;
+    RCC_OscInitStruct.PLL.PLLMUL          = RCC_PLL_MUL12;
+    RCC_OscInitStruct.PLL.PREDIV          = RCC_PREDIV_DIV1;
     if (HAL_RCC_OscConfig(&RCC_OscInitStruct) != HAL_OK) {
         while (1);
     }
 
-    /* Initialize CPU, AHB, and APB clocks to 8MHz */
+    /* Initialize CPU, AHB, and APB clocks to 48MHz */
     RCC_ClkInitStruct.ClockType       = RCC_CLOCKTYPE_SYSCLK | RCC_CLOCKTYPE_HCLK | RCC_CLOCKTYPE_PCLK1;
-    RCC_ClkInitStruct.SYSCLKSource    = RCC_SYSCLKSOURCE_HSI;
+    RCC_ClkInitStruct.SYSCLKSource    = RCC_SYSCLKSOURCE_PLLCLK;
     RCC_ClkInitStruct.AHBCLKDivider   = RCC_SYSCLK_DIV1;
     RCC_ClkInitStruct.APB1CLKDivider  = RCC_HCLK_DIV1;
-    if (HAL_RCC_ClockConfig(&RCC_ClkInitStruct, FLASH_LATENCY_0) != HAL_OK) {
+    if (HAL_RCC_ClockConfig(&RCC_ClkInitStruct, FLASH_LATENCY_1) != HAL_OK) {
         while (1);
     }
 }
@@ -110,30 +288,114 @@ static void MX_GPIO_Init(void)
 
     /* Start with LED off */
     HAL_GPIO_WritePin(GPIOA, GPIO_PIN_5, GPIO_PIN_RESET);
+
+#ifdef ESP_HAS_EN_LINE
+    /* ESP EN, released (high) until boot pulses it */
+    HAL_GPIO_WritePin(ESP_EN_PORT, ESP_EN_PIN, GPIO_PIN_SET);
+    GPIO_InitStruct.Pin   = ESP_EN_PIN;
+    GPIO_InitStruct.Mode  = GPIO_MODE_OUTPUT_PP;
+    GPIO_InitStruct.Pull  = GPIO_NOPULL;
+    GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_LOW;
+    HAL_GPIO_Init(ESP_EN_PORT, &GPIO_InitStruct);
+#endif
+}
+
+/* Bytes from the ESP32, from the bridge in the main loop */
+static void esp_received(const uint8_t *data, uint16_t len, void *ctx)
+{
+    (void)ctx;
+    AT_ProcessReceivedData(data, len);
 }
 
-/* Callback function for received UART1 data (from ESP32) */
-void uart1_rx_handler(uint8_t received_byte) {
-    // Forward the received byte to USART2 using DMA
-    uart_send_dma(UART2_INSTANCE, &received_byte, 1);
+#ifdef PC_IS_AT_CLIENT
+/* Command lines typed on the PC */
+static void pc_received(const uint8_t *data, uint16_t len, void *ctx)
+{
+    (void)ctx;
+    AT_ClientInput(data, len);
 }
 
-/* Callback function for received UART2 data (from PC) */
-void uart2_rx_handler(uint8_t received_byte) {
-    // Forward the received byte to USART1 using DMA
-    uart_send_dma(UART1_INSTANCE, &received_byte, 1);
+/* Lines the AT core routes to the PC */
+static void pc_output(const uint8_t *data, uint16_t len, void *ctx)
+{
+    (void)ctx;
+    bridge_write(data, len);
 }
 
-/* Function to send AT command using DMA */
-void send_at_command(const char *command) {
-    // Directly send the command using DMA (length check removed per Option 1)
-    if (uart_send_dma(UART1_INSTANCE, (uint8_t *)command, strlen(command)) != HAL_OK) {
-        // Handle transmission error if needed
+/* A report runs to several times what the metrics queue holds, so it goes
+   out a line per main loop pass that has room for it, the bridge running
+   in between. A new report command replaces the one in progress. */
+typedef bool (*report_line_t)(uint8_t *cursor, char *line, uint16_t size);
+
+static report_line_t report_source = NULL;
+static uint8_t report_cursor;
+static uint16_t report_len;         // Line formatted and waiting for room, 0 for none
+static char report_line[128];
+
+static void report_start(report_line_t source)
+{
+    report_source = source;
+    report_cursor = 0;
+    report_len = 0;
+}
+
+static void report_poll(void)
+{
+    if (report_source == NULL) {
+        return;
+    }
+    if (report_len == 0) {
+        if (!report_source(&report_cursor, report_line, sizeof(report_line))) {
+            report_source = NULL;
+            return;
+        }
+        report_len = (uint16_t)strlen(report_line);
+    }
+    if (debug_link_fits(DEBUG_LINK_METRICS, report_len)) {
+        debug_link_send(DEBUG_LINK_METRICS, (const uint8_t *)report_line, report_len);
+        report_len = 0;
+    }
+}
+
+/* "#latency" reports command latencies on the metrics channel, "#irq" interrupt
+   handler times, "#ram" memory high-water marks, "#traffic" the bytes the
+   ESP profile saves; "#latency reset" and "#irq reset" clear the first two */
+static bool pc_local_command(const char *line, void *ctx)
+{
+    (void)ctx;
+    if (strcmp(line, "#latency") == 0) {
+        report_start(LATENCY_ReportLine);
+        return true;
+    }
+    if (strcmp(line, "#latency reset") == 0) {
+        LATENCY_Reset();
+        return true;
+    }
+    if (strcmp(line, "#irq") == 0) {
+        report_start(irq_profile_report_line);
+        return true;
+    }
+    if (strcmp(line, "#irq reset") == 0) {
+        irq_profile_reset();
+        return true;
+    }
+    if (strcmp(line, "#ram") == 0) {
+        report_start(ram_watermark_report_line);
+        return true;
+    }
+    if (strcmp(line, "#traffic") == 0) {
+        report_start(TRAFFIC_ReportLine);
+        return true;
     }
+    return false;
 }
+#endif
 
 /* SysTick Handler */
 void SysTick_Handler(void)
 {
+    irq_profile_systick();
+    irq_profile_entry_t entry = irq_profile_enter();
     HAL_IncTick();
+    irq_profile_exit(IRQ_PROFILE_SYSTICK, entry);
 }
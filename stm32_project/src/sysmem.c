@@ -0,0 +1,46 @@
+/* stm32_project/src/sysmem.c */
+
+/* newlib heap for the PlatformIO build. Defining _sbrk() here overrides the
+   libnosys one, which cannot report how far the heap has grown; the logic
+   follows the CubeIDE project's Core/Src/sysmem.c so both builds agree. */
+
+#include "sysmem.h"
+#include <errno.h>
+#include <stdint.h>
+
+/* Linker script symbols */
+extern uint8_t _end;
+extern uint8_t _estack;
+extern uint32_t _Min_Stack_Size;
+
+static uint8_t *heap_end = NULL;
+static uint8_t *heap_peak = NULL;   // Kept when a negative increment lowers heap_end
+
+/* Grow the heap from _end up to the _Min_Stack_Size reserved below _estack:
+   .data | .bss | heap -> ... <- MSP stack */
+void *_sbrk(ptrdiff_t incr)
+{
+    const uint8_t *max_heap = &_estack - (uintptr_t)&_Min_Stack_Size;
+
+    if (heap_end == NULL) {
+        heap_end = &_end;
+    }
+    if (heap_end + incr > max_heap) {
+        errno = ENOMEM;
+        return (void *)-1;
+    }
+
+    uint8_t *prev_heap_end = heap_end;
+    heap_end += incr;
+    if (heap_end > heap_peak) {
+        heap_peak = heap_end;
+    }
+    return prev_heap_end;
+}
+
+size_t _sbrk_usage(int peak)
+{
+    uint8_t *end = peak ? heap_peak : heap_end;
+
+    return (end == NULL) ? 0 : (size_t)(end - &_end);
+}
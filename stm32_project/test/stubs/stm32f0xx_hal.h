@@ -0,0 +1,39 @@
+/* stm32_project/test/stubs/stm32f0xx_hal.h */
+
+/* Just enough of the STM32Cube HAL for the modules the native tests build.
+   Interrupt masking does nothing; the CRC unit only stores what is written. */
+
+#ifndef STM32F0XX_HAL_H
+#define STM32F0XX_HAL_H
+
+#include <stdint.h>
+
+#define __IO volatile
+
+typedef enum {
+    HAL_OK,
+    HAL_ERROR,
+    HAL_BUSY,
+    HAL_TIMEOUT,
+} HAL_StatusTypeDef;
+
+typedef struct {
+    __IO uint32_t DR;
+    __IO uint32_t IDR;
+    __IO uint32_t CR;
+} CRC_TypeDef;
+
+extern CRC_TypeDef stub_crc;
+#define CRC (&stub_crc)
+#define CRC_CR_RESET 1u
+#define __HAL_RCC_CRC_CLK_ENABLE() do {} while (0)
+
+static inline uint32_t __get_PRIMASK(void) { return 0; }
+static inline void __set_PRIMASK(uint32_t primask) { (void)primask; }
+static inline void __disable_irq(void) {}
+static inline void __enable_irq(void) {}
+
+// Defined by each test
+uint32_t HAL_GetTick(void);
+
+#endif // STM32F0XX_HAL_H
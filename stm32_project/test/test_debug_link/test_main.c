@@ -0,0 +1,305 @@
+/* stm32_project/test/test_debug_link/test_main.c */
+
+/* debug_link framing and queueing against a stand-in for the USART2 DMA
+   queue: the test decides when each span has gone out. */
+
+#include <unity.h>
+#include <string.h>
+
+/* Every channel gets a queue, whatever the build mode */
+#define DEBUG_LINK_CAPTURE_SIZE 1024
+#define DEBUG_LINK_LOG_SIZE     256
+#define DEBUG_LINK_TRACE_SIZE   256
+#include "../../src/hal/debug_link.c"
+
+CRC_TypeDef stub_crc;
+
+static const uint8_t *tx_data;      // Span the link has on the wire, NULL when idle
+static uint16_t tx_span;
+static uart_tx_done_callback_t tx_done;
+static void *tx_ctx;
+static bool uart_busy;              // Refuse the next span, as a full UART queue
+static uint8_t wire[4096];
+static uint32_t wire_length;
+
+uint32_t HAL_GetTick(void)
+{
+    return 0;
+}
+
+HAL_StatusTypeDef uart_send_queued(uart_instance_t instance, const uint8_t *data, uint16_t len,
+                                   uart_tx_done_callback_t done, void *ctx)
+{
+    TEST_ASSERT_EQUAL(UART2_INSTANCE, instance);
+    TEST_ASSERT_NULL(tx_data);
+    if (uart_busy) {
+        return HAL_BUSY;
+    }
+    tx_data = data;
+    tx_span = len;
+    tx_done = done;
+    tx_ctx = ctx;
+    return HAL_OK;
+}
+
+/* Finish the span on the wire; the link may start the next one from the callback */
+static bool complete_span(void)
+{
+    if (tx_data == NULL) {
+        return false;
+    }
+    TEST_ASSERT_TRUE(wire_length + tx_span <= sizeof(wire));
+    memcpy(wire + wire_length, tx_data, tx_span);
+    wire_length += tx_span;
+    tx_data = NULL;
+    tx_done(tx_ctx);
+    return true;
+}
+
+static void drain(void)
+{
+    while (complete_span()) {
+    }
+}
+
+/* Decode the frame starting at *pos of the wire into out; returns its length */
+static uint32_t next_frame(uint32_t *pos, uint8_t *out)
+{
+    uint32_t length = 0;
+    while (*pos < wire_length) {
+        uint8_t code = wire[(*pos)++];
+        if (code == 0) {
+            return length;
+        }
+        TEST_ASSERT_TRUE(*pos + code - 1 <= wire_length);
+        for (uint8_t i = 1; i < code; i++) {
+            TEST_ASSERT_NOT_EQUAL(0, wire[*pos]);
+            out[length++] = wire[(*pos)++];
+        }
+        if (code < COBS_BLOCK && wire[*pos] != 0) {
+            out[length++] = 0;
+        }
+    }
+    TEST_FAIL_MESSAGE("frame without delimiter");
+    return 0;
+}
+
+/* Send one frame, drain it and check what came out */
+static void assert_round_trip(debug_link_channel_t channel, const uint8_t *data, uint16_t len)
+{
+    static uint8_t frame[1024];
+    uint32_t pos = 0;
+
+    TEST_ASSERT_TRUE(debug_link_send(channel, data, len));
+    drain();
+    uint32_t length = next_frame(&pos, frame);
+    TEST_ASSERT_EQUAL_UINT32(wire_length, pos);
+    TEST_ASSERT_EQUAL_UINT32(len + 1u, length);
+    TEST_ASSERT_EQUAL(channel, frame[0]);
+    TEST_ASSERT_EQUAL_MEMORY(data, frame + 1, len);
+}
+
+void setUp(void)
+{
+    drain();
+    for (uint8_t i = 0; i < DEBUG_LINK_CHANNELS; i++) {
+        debug_link_set_priority((debug_link_channel_t)i, i);
+    }
+    uart_busy = false;
+    wire_length = 0;
+    debug_link_init(DEBUG_LINK_COBS);
+}
+
+void tearDown(void)
+{
+}
+
+static void test_raw_payload_goes_out_as_is(void)
+{
+    debug_link_init(DEBUG_LINK_RAW);
+    TEST_ASSERT_TRUE(debug_link_send(DEBUG_LINK_LOG, (const uint8_t *)"a\0b", 3));
+    drain();
+    TEST_ASSERT_EQUAL_UINT32(3, wire_length);
+    TEST_ASSERT_EQUAL_MEMORY("a\0b", wire, 3);
+}
+
+static void test_zeros_are_encoded_away(void)
+{
+    static const uint8_t payloads[][5] = {
+        { 0, 0, 0, 0, 0 },
+        { 1, 0, 2, 0, 3 },
+        { 0, 1, 2, 3, 0 },
+        { 1, 2, 3, 4, 5 },
+    };
+    for (uint8_t i = 0; i < 4; i++) {
+        wire_length = 0;
+        assert_round_trip(DEBUG_LINK_LOG, payloads[i], sizeof(payloads[i]));
+    }
+}
+
+static void test_block_boundaries(void)
+{
+    static const uint16_t lengths[] = { 252, 253, 254, 255, 508, 509 };
+    uint8_t data[509];
+    for (uint16_t i = 0; i < sizeof(data); i++) {
+        data[i] = (uint8_t)(i % 255 + 1);
+    }
+
+    // Channel byte plus payload of one byte under, at and over a block
+    for (uint8_t i = 0; i < 6; i++) {
+        wire_length = 0;
+        assert_round_trip(DEBUG_LINK_CAPTURE, data, lengths[i]);
+        TEST_ASSERT_TRUE(wire_length <= lengths[i] + 1u + (lengths[i] + 1u) / 254 + 2);
+    }
+}
+
+static void test_header_and_data_make_one_frame(void)
+{
+    uint8_t frame[16];
+    uint32_t pos = 0;
+
+    TEST_ASSERT_TRUE(debug_link_send_with_header(DEBUG_LINK_CAPTURE, (const uint8_t *)"\x01\x00", 2,
+                                                 (const uint8_t *)"xyz", 3));
+    drain();
+    TEST_ASSERT_EQUAL_UINT32(6, next_frame(&pos, frame));
+    TEST_ASSERT_EQUAL_MEMORY("\x01\x01\x00xyz", frame, 6);
+    TEST_ASSERT_EQUAL_UINT32(wire_length, pos);
+}
+
+static void test_full_queue_drops_and_wrapped_frames_survive(void)
+{
+    uint8_t line[60];
+    uint8_t frame[64];
+    memset(line, 'm', sizeof(line));
+    uint32_t dropped = debug_link_get_stats(DEBUG_LINK_METRICS)->dropped;
+
+    // Fill the metrics queue while the wire is busy with the first frame
+    uint8_t queued = 0;
+    while (debug_link_send(DEBUG_LINK_METRICS, line, sizeof(line))) {
+        line[0]++;
+        queued++;
+    }
+    TEST_ASSERT_TRUE(queued >= 2);
+    TEST_ASSERT_EQUAL_UINT32(dropped + 1, debug_link_get_stats(DEBUG_LINK_METRICS)->dropped);
+
+    // Asking first is not a drop
+    TEST_ASSERT_FALSE(debug_link_fits(DEBUG_LINK_METRICS, sizeof(line)));
+    TEST_ASSERT_TRUE(debug_link_fits(DEBUG_LINK_METRICS, 1));
+    TEST_ASSERT_EQUAL_UINT32(dropped + 1, debug_link_get_stats(DEBUG_LINK_METRICS)->dropped);
+
+    // Each frame that goes out makes room for one more; the later ones wrap
+    for (uint8_t round = 0; round < 10; round++) {
+        complete_span();
+        if (debug_link_send(DEBUG_LINK_METRICS, line, sizeof(line))) {
+            line[0]++;
+            queued++;
+        }
+    }
+    TEST_ASSERT_TRUE(queues[DEBUG_LINK_METRICS].head > 2 * DEBUG_LINK_METRICS_SIZE);
+    drain();
+
+    uint32_t pos = 0;
+    uint8_t first = 'm';
+    for (uint8_t i = 0; i < queued; i++) {
+        TEST_ASSERT_EQUAL_UINT32(sizeof(line) + 1, next_frame(&pos, frame));
+        TEST_ASSERT_EQUAL(DEBUG_LINK_METRICS, frame[0]);
+        TEST_ASSERT_EQUAL((uint8_t)(first + i), frame[1]);
+        TEST_ASSERT_EQUAL('m', frame[sizeof(line)]);
+    }
+    TEST_ASSERT_EQUAL_UINT32(wire_length, pos);
+}
+
+static void test_frame_being_written_holds_back_its_queue_only(void)
+{
+    // A frame reserved by a sender that an interrupt preempted mid-write
+    link_queue_t *log = &queues[DEBUG_LINK_LOG];
+    uint32_t start;
+    debug_link_init(DEBUG_LINK_RAW);
+    TEST_ASSERT_TRUE(frame_reserve(log, frame_size(1), &start));
+
+    TEST_ASSERT_TRUE(debug_link_send(DEBUG_LINK_LOG, (const uint8_t *)"b", 1));
+    TEST_ASSERT_TRUE(debug_link_send(DEBUG_LINK_METRICS, (const uint8_t *)"m", 1));
+    drain();
+    TEST_ASSERT_EQUAL_UINT32(1, wire_length);
+
+    log->buffer[(start + FRAME_PREFIX) % log->size] = 'a';
+    frame_commit(log, start, start + FRAME_PREFIX + 1, 1);
+    drain();
+    TEST_ASSERT_EQUAL_UINT32(3, wire_length);
+    TEST_ASSERT_EQUAL_MEMORY("mab", wire, 3);
+}
+
+static void test_crc_restarts_after_a_preempting_frame(void)
+{
+    uint32_t value;
+    uint32_t generation = crc_start();
+    uint32_t preempting = crc_start();
+    TEST_ASSERT_FALSE(crc_finish(generation, &value));
+    TEST_ASSERT_TRUE(crc_finish(preempting, &value));
+}
+
+static void test_busy_uart_is_retried_by_poll(void)
+{
+    uart_busy = true;
+    TEST_ASSERT_TRUE(debug_link_send(DEBUG_LINK_LOG, (const uint8_t *)"hi", 2));
+    TEST_ASSERT_NULL(tx_data);
+
+    uart_busy = false;
+    debug_link_poll();
+    drain();
+    TEST_ASSERT_EQUAL_UINT32(5, wire_length);
+}
+
+static void test_urgent_channel_goes_first(void)
+{
+    uint8_t frame[8];
+    uint32_t pos = 0;
+
+    // The log frame takes the idle wire; of the two queued behind it, trace wins
+    debug_link_set_priority(DEBUG_LINK_TRACE, 0);
+    debug_link_set_priority(DEBUG_LINK_BRIDGE, 5);
+    TEST_ASSERT_TRUE(debug_link_send(DEBUG_LINK_LOG, (const uint8_t *)"l", 1));
+    TEST_ASSERT_TRUE(debug_link_send(DEBUG_LINK_BRIDGE, (const uint8_t *)"b", 1));
+    TEST_ASSERT_TRUE(debug_link_send(DEBUG_LINK_TRACE, (const uint8_t *)"t", 1));
+    drain();
+
+    next_frame(&pos, frame);
+    TEST_ASSERT_EQUAL(DEBUG_LINK_LOG, frame[0]);
+    next_frame(&pos, frame);
+    TEST_ASSERT_EQUAL(DEBUG_LINK_TRACE, frame[0]);
+    next_frame(&pos, frame);
+    TEST_ASSERT_EQUAL(DEBUG_LINK_BRIDGE, frame[0]);
+}
+
+static void test_crc_frame_carries_flag_and_trailer(void)
+{
+    uint8_t frame[16];
+    uint32_t pos = 0;
+
+    // The stub CRC unit holds the last byte fed to it; the trailer is DR, little endian
+    debug_link_init(DEBUG_LINK_COBS_CRC);
+    stub_crc.DR = 0x12345600u;
+    TEST_ASSERT_TRUE(debug_link_send(DEBUG_LINK_LOG, (const uint8_t *)"ok", 2));
+    drain();
+
+    TEST_ASSERT_EQUAL_UINT32(7, next_frame(&pos, frame));
+    TEST_ASSERT_EQUAL(DEBUG_LINK_LOG | DEBUG_LINK_CRC_FLAG, frame[0]);
+    TEST_ASSERT_EQUAL_MEMORY("ok", frame + 1, 2);
+    TEST_ASSERT_EQUAL_MEMORY("k\x56\x34\x12", frame + 3, 4);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_raw_payload_goes_out_as_is);
+    RUN_TEST(test_zeros_are_encoded_away);
+    RUN_TEST(test_block_boundaries);
+    RUN_TEST(test_header_and_data_make_one_frame);
+    RUN_TEST(test_full_queue_drops_and_wrapped_frames_survive);
+    RUN_TEST(test_frame_being_written_holds_back_its_queue_only);
+    RUN_TEST(test_crc_restarts_after_a_preempting_frame);
+    RUN_TEST(test_busy_uart_is_retried_by_poll);
+    RUN_TEST(test_urgent_channel_goes_first);
+    RUN_TEST(test_crc_frame_carries_flag_and_trailer);
+    return UNITY_END();
+}
@@ -0,0 +1,259 @@
+/* stm32_project/test/test_http_download/test_main.c */
+
+/* HTTP_Download against a stand-in for HTTP_Session: the test plays the
+   server on each link and decides when and how every request is answered. */
+
+#include <unity.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../../src/at/http_download.c"
+
+#define RESOURCE_SIZE 1000
+#define BODY_CHUNK    100
+
+typedef struct {
+    bool pending;
+    HTTP_SessionRequest request;
+} stand_in_link_t;
+
+static uint32_t tick;
+static stand_in_link_t stand_in[TCP_MAX_LINKS];
+static uint8_t resource[RESOURCE_SIZE];
+static uint8_t received[RESOURCE_SIZE];
+static uint32_t received_length;
+static uint8_t reorder[512];
+static HTTP_Download download;
+static bool done;
+static AT_Result done_result;
+static uint32_t done_length;
+
+uint32_t HAL_GetTick(void)
+{
+    return tick;
+}
+
+void HTTP_SessionInit(HTTP_Session *session, uint8_t link, TCP_Protocol proto,
+                      const char *host, uint16_t port, bool pipelining)
+{
+    (void)proto;
+    (void)host;
+    (void)port;
+    (void)pipelining;
+    memset(session, 0, sizeof(*session));
+    session->link = link;
+}
+
+bool HTTP_SessionSubmit(HTTP_Session *session, const HTTP_SessionRequest *request)
+{
+    stand_in_link_t *link = &stand_in[session->link];
+    if (link->pending) {
+        return false;
+    }
+    link->pending = true;
+    link->request = *request;
+    return true;
+}
+
+void HTTP_SessionPoll(HTTP_Session *session)
+{
+    (void)session;
+}
+
+void HTTP_SessionClose(HTTP_Session *session)
+{
+    (void)session;
+}
+
+static void sink(const uint8_t *data, uint16_t len, void *ctx)
+{
+    (void)ctx;
+    TEST_ASSERT_TRUE(received_length + len <= RESOURCE_SIZE);
+    memcpy(received + received_length, data, len);
+    received_length += len;
+}
+
+static void download_done(AT_Result result, uint32_t length, void *ctx)
+{
+    (void)ctx;
+    done = true;
+    done_result = result;
+    done_length = length;
+}
+
+/* Answer the request pending on link with status and at most max_body bytes
+   of what it asked for, then complete it with result */
+static void respond(uint8_t link, uint16_t status, uint32_t max_body, AT_Result result)
+{
+    stand_in_link_t *standin = &stand_in[link];
+    TEST_ASSERT_TRUE(standin->pending);
+    HTTP_SessionRequest request = standin->request;
+    standin->pending = false;
+
+    unsigned long first = 0;
+    unsigned long last = RESOURCE_SIZE - 1;
+    if (request.headers != NULL) {
+        TEST_ASSERT_EQUAL(2, sscanf(request.headers, "Range: bytes=%lu-%lu", &first, &last));
+    }
+    uint32_t length = (uint32_t)(last + 1 - first);
+    uint32_t sent = 0;
+
+    request.handlers.on_start(status, (int32_t)length, request.handlers.ctx);
+    if (request.method != HTTP_METHOD_HEAD) {
+        while (sent < length && sent < max_body) {
+            uint32_t n = length - sent;
+            n = (n < BODY_CHUNK) ? n : BODY_CHUNK;
+            n = (n < max_body - sent) ? n : max_body - sent;
+            request.handlers.on_body(resource + first + sent, (uint16_t)n, request.handlers.ctx);
+            sent += n;
+        }
+    }
+    request.handlers.on_complete(result, sent, request.handlers.ctx);
+}
+
+static void fail_connect(uint8_t link)
+{
+    stand_in_link_t *standin = &stand_in[link];
+    TEST_ASSERT_TRUE(standin->pending);
+    standin->pending = false;
+    standin->request.handlers.on_complete(AT_RESULT_ERROR, 0, standin->request.handlers.ctx);
+}
+
+/* Answer everything still pending, highest link first */
+static void serve_rest(void)
+{
+    for (int guard = 0; guard < 100 && download.running; guard++) {
+        for (int link = TCP_MAX_LINKS - 1; link >= 0; link--) {
+            if (stand_in[link].pending) {
+                respond((uint8_t)link, 206, RESOURCE_SIZE, AT_RESULT_OK);
+            }
+        }
+    }
+}
+
+static void start(uint32_t length)
+{
+    HTTP_DownloadConfig config = {
+        .proto = TCP_PROTO_TCP,
+        .host = "192.168.1.10",
+        .port = 80,
+        .path = "/firmware.bin",
+        .length = length,
+        .range_size = 256,
+        .first_link = 0,
+        .links = 3,
+        .reorder_buffer = reorder,
+        .reorder_size = sizeof(reorder),
+        .sink = sink,
+        .done = download_done,
+    };
+    TEST_ASSERT_TRUE(HTTP_DownloadStart(&download, &config));
+}
+
+static void assert_complete(void)
+{
+    TEST_ASSERT_TRUE(done);
+    TEST_ASSERT_EQUAL(AT_RESULT_OK, done_result);
+    TEST_ASSERT_EQUAL_UINT32(RESOURCE_SIZE, done_length);
+    TEST_ASSERT_EQUAL_UINT32(RESOURCE_SIZE, received_length);
+    TEST_ASSERT_EQUAL_MEMORY(resource, received, RESOURCE_SIZE);
+}
+
+void setUp(void)
+{
+    for (uint32_t i = 0; i < RESOURCE_SIZE; i++) {
+        resource[i] = (uint8_t)(i * 7 + i / 251);
+    }
+    memset(stand_in, 0, sizeof(stand_in));
+    memset(received, 0, sizeof(received));
+    received_length = 0;
+    done = false;
+    tick = 0;
+}
+
+void tearDown(void)
+{
+}
+
+static void test_out_of_order_ranges_are_delivered_in_order(void)
+{
+    start(RESOURCE_SIZE);
+
+    // Ranges 0-2 are out at once; the later ones answer first
+    respond(2, 206, RESOURCE_SIZE, AT_RESULT_OK);
+    respond(1, 206, RESOURCE_SIZE, AT_RESULT_OK);
+    TEST_ASSERT_EQUAL_UINT32(0, received_length);
+    respond(0, 206, RESOURCE_SIZE, AT_RESULT_OK);
+    TEST_ASSERT_EQUAL_UINT32(768, received_length);
+    serve_rest();
+
+    assert_complete();
+    TEST_ASSERT_EQUAL_UINT32(4, download.stats.ranges);
+    TEST_ASSERT_EQUAL_UINT32(512, download.stats.buffered_bytes);
+    TEST_ASSERT_EQUAL_UINT32(0, download.stats.retries);
+}
+
+static void test_dropped_range_resumes_from_first_missing_byte(void)
+{
+    start(RESOURCE_SIZE);
+
+    respond(0, 206, 100, AT_RESULT_ERROR);
+    TEST_ASSERT_TRUE(stand_in[0].pending);
+    TEST_ASSERT_EQUAL_STRING("Range: bytes=100-255\r\n", stand_in[0].request.headers);
+    serve_rest();
+
+    assert_complete();
+    TEST_ASSERT_EQUAL_UINT32(1, download.stats.retries);
+}
+
+static void test_failed_connect_and_status_are_retried(void)
+{
+    start(RESOURCE_SIZE);
+
+    fail_connect(1);
+    TEST_ASSERT_TRUE(download.running);
+    respond(1, 503, RESOURCE_SIZE, AT_RESULT_OK);
+    TEST_ASSERT_TRUE(download.running);
+    TEST_ASSERT_EQUAL_STRING("Range: bytes=256-511\r\n", stand_in[1].request.headers);
+    serve_rest();
+
+    assert_complete();
+    TEST_ASSERT_EQUAL_UINT32(2, download.stats.retries);
+}
+
+static void test_range_is_abandoned_after_max_attempts(void)
+{
+    start(RESOURCE_SIZE);
+
+    for (uint8_t i = 0; i < HTTP_DOWNLOAD_MAX_ATTEMPTS; i++) {
+        TEST_ASSERT_FALSE(done);
+        fail_connect(0);
+    }
+
+    TEST_ASSERT_TRUE(done);
+    TEST_ASSERT_EQUAL(AT_RESULT_ERROR, done_result);
+    TEST_ASSERT_FALSE(download.running);
+}
+
+static void test_unknown_length_is_probed_with_head(void)
+{
+    start(0);
+
+    TEST_ASSERT_EQUAL(HTTP_METHOD_HEAD, stand_in[0].request.method);
+    respond(0, 200, 0, AT_RESULT_OK);
+    TEST_ASSERT_EQUAL_UINT32(RESOURCE_SIZE, download.config.length);
+    serve_rest();
+
+    assert_complete();
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_out_of_order_ranges_are_delivered_in_order);
+    RUN_TEST(test_dropped_range_resumes_from_first_missing_byte);
+    RUN_TEST(test_failed_connect_and_status_are_retried);
+    RUN_TEST(test_range_is_abandoned_after_max_attempts);
+    RUN_TEST(test_unknown_length_is_probed_with_head);
+    return UNITY_END();
+}
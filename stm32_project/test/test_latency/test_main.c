@@ -0,0 +1,176 @@
+/* stm32_project/test/test_latency/test_main.c */
+
+/* Latency histograms fed through the command observer, with the test
+   playing the AT core and the microsecond clock. */
+
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include "../../src/at/latency.c"
+
+static uint32_t now_us;
+static AT_CommandObserver observer;
+static void *observer_ctx;
+static char report[LATENCY_CLASSES][128];
+static uint8_t report_lines;
+
+uint32_t timestamp_us(void)
+{
+    return now_us;
+}
+
+void AT_SetCommandObserver(AT_CommandObserver new_observer, void *ctx)
+{
+    observer = new_observer;
+    observer_ctx = ctx;
+}
+
+/* One command sent now and finished elapsed us later */
+static void command(const char *text, uint32_t elapsed, AT_Result result)
+{
+    observer(text, false, AT_RESULT_OK, observer_ctx);
+    now_us += elapsed;
+    observer(text, true, result, observer_ctx);
+}
+
+/* The whole report, a line at a time as the main loop takes it */
+static void collect(void)
+{
+    uint8_t cursor = 0;
+    report_lines = 0;
+    while (report_lines < LATENCY_CLASSES &&
+           LATENCY_ReportLine(&cursor, report[report_lines], sizeof(report[0]))) {
+        report_lines++;
+    }
+    TEST_ASSERT_FALSE(LATENCY_ReportLine(&cursor, report[0], sizeof(report[0])));
+}
+
+void setUp(void)
+{
+    now_us = 0xFFFFF000u;       // Samples straddle the clock wrap
+    LATENCY_Init();
+}
+
+void tearDown(void)
+{
+}
+
+static void test_bucket_edges(void)
+{
+    TEST_ASSERT_EQUAL(0, bucket_of(0));
+    TEST_ASSERT_EQUAL(0, bucket_of(127));
+    TEST_ASSERT_EQUAL(1, bucket_of(128));
+    TEST_ASSERT_EQUAL(1, bucket_of(191));
+    TEST_ASSERT_EQUAL(2, bucket_of(192));
+    TEST_ASSERT_EQUAL(3, bucket_of(256));
+    TEST_ASSERT_EQUAL(LATENCY_BUCKETS - 1, bucket_of(UINT32_MAX));
+
+    // Every bucket starts where the one below it ends
+    for (uint8_t bucket = 1; bucket < LATENCY_BUCKETS; bucket++) {
+        TEST_ASSERT_EQUAL(bucket, bucket_of(bucket_floor(bucket)));
+        TEST_ASSERT_EQUAL(bucket - 1, bucket_of(bucket_floor(bucket) - 1));
+    }
+}
+
+static void test_percentiles_of_a_known_distribution(void)
+{
+    for (uint8_t i = 0; i < 50; i++) {
+        command("AT+CIPSEND=0,5\r\n", 1000, AT_RESULT_OK);
+    }
+    for (uint8_t i = 0; i < 40; i++) {
+        command("AT+CIPSEND=1,12\r\n", 3000, AT_RESULT_OK);
+    }
+    for (uint8_t i = 0; i < 10; i++) {
+        command("AT+CIPSEND=2,40\r\n", 100000, AT_RESULT_OK);
+    }
+
+    const LATENCY_Class *latency = LATENCY_GetClass(0);
+    TEST_ASSERT_EQUAL_STRING("AT+CIPSEND", latency->name);
+    TEST_ASSERT_NULL(LATENCY_GetClass(1));
+    TEST_ASSERT_EQUAL_UINT32(100, latency->count);
+    TEST_ASSERT_EQUAL_UINT32(100000, latency->max_us);
+
+    // Upper bucket edges: 1000 us is in [768, 1024), 3000 us in [2048, 3072)
+    TEST_ASSERT_EQUAL_UINT32(1024, LATENCY_Percentile(latency, 50));
+    TEST_ASSERT_EQUAL_UINT32(3072, LATENCY_Percentile(latency, 90));
+    TEST_ASSERT_EQUAL_UINT32(100000, LATENCY_Percentile(latency, 99));
+}
+
+static void test_errors_are_timed_and_timeouts_are_not(void)
+{
+    command("AT+CWJAP=\"ap\",\"key\"\r\n", 2000000, AT_RESULT_OK);
+    command("AT+CWJAP=\"ap\",\"key\"\r\n", 500000, AT_RESULT_ERROR);
+    command("AT+CWJAP=\"ap\",\"key\"\r\n", 20000000, AT_RESULT_TIMEOUT);
+
+    const LATENCY_Class *latency = LATENCY_GetClass(0);
+    TEST_ASSERT_EQUAL_UINT32(2, latency->count);
+    TEST_ASSERT_EQUAL_UINT32(1, latency->errors);
+    TEST_ASSERT_EQUAL_UINT32(1, latency->timeouts);
+    TEST_ASSERT_EQUAL_UINT32(2000000, latency->max_us);
+}
+
+static void test_commands_past_the_last_class_share_other(void)
+{
+    char text[24];
+    for (uint8_t i = 0; i < LATENCY_CLASSES + 2; i++) {
+        snprintf(text, sizeof(text), "AT+CMD%u?\r\n", (unsigned)i);
+        command(text, 500, AT_RESULT_OK);
+    }
+
+    TEST_ASSERT_EQUAL_STRING("AT+CMD0", LATENCY_GetClass(0)->name);
+    snprintf(text, sizeof(text), "AT+CMD%u", (unsigned)(LATENCY_CLASSES - 2));
+    TEST_ASSERT_EQUAL_STRING(text, LATENCY_GetClass(LATENCY_CLASSES - 2)->name);
+    const LATENCY_Class *other = LATENCY_GetClass(LATENCY_CLASSES - 1);
+    TEST_ASSERT_EQUAL_STRING("other", other->name);
+    TEST_ASSERT_EQUAL_UINT32(3, other->count);
+    TEST_ASSERT_NULL(LATENCY_GetClass(LATENCY_CLASSES));
+}
+
+static void test_report_has_a_line_per_class(void)
+{
+    collect();
+    TEST_ASSERT_EQUAL(0, report_lines);
+
+    command("AT\r\n", 300, AT_RESULT_OK);
+    command("AT+GMR\r\n", 5000, AT_RESULT_OK);
+    collect();
+
+    TEST_ASSERT_EQUAL(2, report_lines);
+    TEST_ASSERT_EQUAL_STRING("lat AT n 1 p50 300 p90 300 p99 300 max 300 err 0 tmo 0\r\n", report[0]);
+    TEST_ASSERT_EQUAL_STRING("lat AT+GMR n 1 p50 5000 p90 5000 p99 5000 max 5000 err 0 tmo 0\r\n", report[1]);
+}
+
+static void test_percentiles_stop_at_the_maximum(void)
+{
+    // The example in latency.h: p50 is a bucket edge, p90 and p99 are capped at max
+    command("AT+CWJAP=\"ap\",\"key\"\r\n", 1200000, AT_RESULT_OK);
+    command("AT+CWJAP=\"ap\",\"key\"\r\n", 1300000, AT_RESULT_OK);
+    command("AT+CWJAP=\"ap\",\"key\"\r\n", 1873012, AT_RESULT_OK);
+    collect();
+
+    TEST_ASSERT_EQUAL_STRING("lat AT+CWJAP n 3 p50 1572864 p90 1873012 p99 1873012 max 1873012 err 0 tmo 0\r\n",
+                             report[0]);
+}
+
+static void test_reset_clears_every_class(void)
+{
+    command("AT\r\n", 300, AT_RESULT_OK);
+    LATENCY_Reset();
+    TEST_ASSERT_NULL(LATENCY_GetClass(0));
+
+    command("AT\r\n", 300, AT_RESULT_OK);
+    TEST_ASSERT_EQUAL_UINT32(1, LATENCY_GetClass(0)->count);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_bucket_edges);
+    RUN_TEST(test_percentiles_of_a_known_distribution);
+    RUN_TEST(test_errors_are_timed_and_timeouts_are_not);
+    RUN_TEST(test_commands_past_the_last_class_share_other);
+    RUN_TEST(test_report_has_a_line_per_class);
+    RUN_TEST(test_percentiles_stop_at_the_maximum);
+    RUN_TEST(test_reset_clears_every_class);
+    return UNITY_END();
+}
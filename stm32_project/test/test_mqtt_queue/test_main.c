@@ -0,0 +1,190 @@
+/* stm32_project/test/test_mqtt_queue/test_main.c */
+
+/* The offline publish queue in a small arena, with the test playing the AT
+   core and deciding when the ESP finishes each publish. */
+
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+
+#define MQTT_QUEUE_ARENA_SIZE 256
+#include "../../src/at/mqtt.c"
+
+// Record header, "t\0" and the payload fill a 96 byte record; two fit the
+// arena and a third starts over at offset 0
+#define PAYLOAD_SIZE (96 - sizeof(mqtt_record_t) - 2)
+
+typedef struct {
+    uint8_t first_byte;         // Identifies the queued payload
+    AT_CommandCallback callback;
+    void *ctx;
+} sent_command_t;
+
+static sent_command_t sent[8];
+static uint8_t sent_count;
+static uint8_t finished;
+
+bool AT_SendCommandWithPayload(const char *command, uint32_t payload_len,
+                               AT_PayloadSource source, void *source_ctx,
+                               uint32_t timeout_ms, AT_CommandCallback callback, void *ctx)
+{
+    (void)command;
+    (void)payload_len;
+    (void)timeout_ms;
+    const uint8_t *data = NULL;
+    TEST_ASSERT_TRUE(sent_count < sizeof(sent) / sizeof(sent[0]));
+    TEST_ASSERT_NOT_NULL(source);
+    source(&data, 1, source_ctx);
+    sent[sent_count].first_byte = data[0];
+    sent[sent_count].callback = callback;
+    sent[sent_count].ctx = ctx;
+    sent_count++;
+    return true;
+}
+
+bool AT_RegisterUrcHandler(const char *prefix, char delimiter, AT_UrcHandler handler, void *ctx)
+{
+    (void)prefix;
+    (void)delimiter;
+    (void)handler;
+    (void)ctx;
+    return true;
+}
+
+const char *AT_GetCurrentCommand(void)
+{
+    return NULL;
+}
+
+void AT_CompleteCommand(AT_Result result)
+{
+    (void)result;
+}
+
+void AT_BeginRawData(uint32_t len, AT_RawDataHandler handler, void *ctx)
+{
+    (void)len;
+    (void)handler;
+    (void)ctx;
+}
+
+static bool queue(uint8_t id, uint16_t len)
+{
+    uint8_t payload[128];
+    memset(payload, id, sizeof(payload));
+    return MQTT_QueuePublish("t", payload, len, 1, false);
+}
+
+/* The ESP finishes the oldest publish it has not answered yet */
+static uint8_t finish(AT_Result result)
+{
+    TEST_ASSERT_TRUE(finished < sent_count);
+    sent_command_t *cmd = &sent[finished++];
+    cmd->callback(result, cmd->ctx);
+    return cmd->first_byte;
+}
+
+void setUp(void)
+{
+    sent_count = 0;
+    finished = 0;
+    MQTT_Init();
+}
+
+void tearDown(void)
+{
+}
+
+static void test_offline_records_wrap_and_evict_the_oldest(void)
+{
+    TEST_ASSERT_TRUE(queue(1, PAYLOAD_SIZE));
+    TEST_ASSERT_TRUE(queue(2, PAYLOAD_SIZE));
+    TEST_ASSERT_TRUE(queue(3, PAYLOAD_SIZE));
+
+    // The third record wrapped to offset 0 in place of the first
+    TEST_ASSERT_EQUAL(2, MQTT_QueueDepth());
+    TEST_ASSERT_EQUAL_UINT32(1, MQTT_GetStats()->queue_dropped);
+    TEST_ASSERT_EQUAL(96, queue_tail);
+    TEST_ASSERT_EQUAL(96, queue_head);
+
+    connected_urc("+MQTTCONNECTED:0", NULL);
+    TEST_ASSERT_EQUAL(2, sent_count);
+    TEST_ASSERT_EQUAL(2, finish(AT_RESULT_OK));
+    TEST_ASSERT_EQUAL(3, finish(AT_RESULT_OK));
+    TEST_ASSERT_EQUAL(0, MQTT_QueueDepth());
+}
+
+static void test_records_in_flight_are_not_evicted(void)
+{
+    connected_urc("+MQTTCONNECTED:0", NULL);
+    TEST_ASSERT_TRUE(queue(1, PAYLOAD_SIZE));
+    TEST_ASSERT_TRUE(queue(2, PAYLOAD_SIZE));
+    TEST_ASSERT_EQUAL(MQTT_QUEUE_WINDOW, sent_count);
+
+    TEST_ASSERT_FALSE(queue(3, PAYLOAD_SIZE));
+    TEST_ASSERT_EQUAL(2, MQTT_QueueDepth());
+    TEST_ASSERT_EQUAL_UINT32(0, MQTT_GetStats()->queue_dropped);
+
+    // Once the oldest is confirmed there is room again
+    TEST_ASSERT_EQUAL(1, finish(AT_RESULT_OK));
+    TEST_ASSERT_TRUE(queue(3, PAYLOAD_SIZE));
+    TEST_ASSERT_EQUAL(2, finish(AT_RESULT_OK));
+    TEST_ASSERT_EQUAL(3, finish(AT_RESULT_OK));
+    TEST_ASSERT_EQUAL_UINT32(0, MQTT_GetStats()->queue_dropped);
+}
+
+static void test_failed_record_is_evicted_without_the_one_in_flight_behind_it(void)
+{
+    connected_urc("+MQTTCONNECTED:0", NULL);
+    TEST_ASSERT_TRUE(queue(1, PAYLOAD_SIZE));
+    TEST_ASSERT_TRUE(queue(2, PAYLOAD_SIZE));
+    TEST_ASSERT_EQUAL(1, finish(AT_RESULT_SEND_FAIL));
+
+    // Dropping the failed record alone would not make room, so it stays
+    TEST_ASSERT_FALSE(queue(3, MQTT_QUEUE_ARENA_SIZE / 2 - sizeof(mqtt_record_t) - 2));
+    TEST_ASSERT_EQUAL(2, MQTT_QueueDepth());
+    TEST_ASSERT_EQUAL_UINT32(0, MQTT_GetStats()->queue_dropped);
+
+    // Freeing the first slot is enough for a record of the same size
+    TEST_ASSERT_TRUE(queue(3, PAYLOAD_SIZE));
+    TEST_ASSERT_EQUAL(2, MQTT_QueueDepth());
+    TEST_ASSERT_EQUAL_UINT32(1, MQTT_GetStats()->queue_dropped);
+
+    TEST_ASSERT_EQUAL(2, finish(AT_RESULT_OK));
+    TEST_ASSERT_EQUAL(3, sent_count);
+    TEST_ASSERT_EQUAL(3, finish(AT_RESULT_OK));
+    TEST_ASSERT_EQUAL(0, MQTT_QueueDepth());
+}
+
+static void test_only_unconfirmed_evictions_are_counted(void)
+{
+    connected_urc("+MQTTCONNECTED:0", NULL);
+    TEST_ASSERT_TRUE(queue(1, PAYLOAD_SIZE));
+    TEST_ASSERT_TRUE(queue(2, PAYLOAD_SIZE));
+    disconnected_urc("+MQTTDISCONNECTED:0", NULL);
+
+    // The first is cut off, the second confirmed and kept behind it in order
+    TEST_ASSERT_EQUAL(1, finish(AT_RESULT_TIMEOUT));
+    TEST_ASSERT_EQUAL(2, finish(AT_RESULT_OK));
+    TEST_ASSERT_EQUAL(2, MQTT_QueueDepth());
+
+    // Half the arena needs both gone, but only the first was lost
+    TEST_ASSERT_TRUE(queue(3, MQTT_QUEUE_ARENA_SIZE / 2 - sizeof(mqtt_record_t) - 2));
+    TEST_ASSERT_EQUAL(1, MQTT_QueueDepth());
+    TEST_ASSERT_EQUAL_UINT32(1, MQTT_GetStats()->queue_dropped);
+
+    connected_urc("+MQTTCONNECTED:0", NULL);
+    TEST_ASSERT_EQUAL(3, sent_count);
+    TEST_ASSERT_EQUAL(3, finish(AT_RESULT_OK));
+    TEST_ASSERT_EQUAL(0, MQTT_QueueDepth());
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_offline_records_wrap_and_evict_the_oldest);
+    RUN_TEST(test_records_in_flight_are_not_evicted);
+    RUN_TEST(test_failed_record_is_evicted_without_the_one_in_flight_behind_it);
+    RUN_TEST(test_only_unconfirmed_evictions_are_counted);
+    return UNITY_END();
+}